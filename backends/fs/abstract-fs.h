@@ -169,6 +169,15 @@ public:
 	 */
 	virtual Common::SeekableReadStream *createReadStream() = 0;
 
+	/**
+	 * Creates a MemoryReadStream over the file referred by this node, mapped
+	 * in memory. The backends that cannot map files keep this default,
+	 * which returns 0.
+	 *
+	 * @return pointer to the stream object, 0 in case of a failure
+	 */
+	virtual Common::MemoryReadStream *createMappedReadStream() { return 0; }
+
 	/**
 	 * Creates a WriteStream instance corresponding to the file
 	 * referred by this node. This assumes that the node actually refers
@@ -32,6 +32,9 @@
 
 #include "backends/fs/posix/posix-fs.h"
 #include "backends/fs/stdiostream.h"
+#if defined(POSIX)
+#include "backends/fs/posix/posix-mapped-stream.h"
+#endif
 #include "common/algorithm.h"
 
 #include <sys/param.h>
@@ -247,6 +250,14 @@ Common::SeekableReadStream *POSIXFilesystemNode::createReadStream() {
 	return StdioStream::makeFromPath(getPath(), false);
 }
 
+Common::MemoryReadStream *POSIXFilesystemNode::createMappedReadStream() {
+#if defined(POSIX)
+	return POSIXMappedReadStream::makeFromPath(getPath());
+#else
+	return 0;
+#endif
+}
+
 Common::WriteStream *POSIXFilesystemNode::createWriteStream() {
 	return StdioStream::makeFromPath(getPath(), true);
 }
@@ -72,6 +72,7 @@ public:
 	virtual AbstractFSNode *getParent() const;
 
 	virtual Common::SeekableReadStream *createReadStream();
+	virtual Common::MemoryReadStream *createMappedReadStream();
 	virtual Common::WriteStream *createWriteStream();
 
 private:
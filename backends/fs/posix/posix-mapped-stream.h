@@ -0,0 +1,52 @@
+/* ScummVM - Graphic Adventure Engine
+ *
+ * ScummVM is the legal property of its developers, whose names
+ * are too numerous to list here. Please refer to the COPYRIGHT
+ * file distributed with this source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef BACKENDS_FS_POSIX_MAPPED_STREAM_H
+#define BACKENDS_FS_POSIX_MAPPED_STREAM_H
+
+#include "common/memstream.h"
+#include "common/str.h"
+
+/**
+ * A read stream over a file mapped in memory with mmap(). The pages of the
+ * file are only read when they are accessed, and they are shared with the
+ * other processes which map or read the same file.
+ */
+class POSIXMappedReadStream : public Common::MemoryReadStream {
+public:
+	/**
+	 * Map the file at the given path.
+	 *
+	 * @return the stream, or 0 if the file cannot be mapped
+	 */
+	static POSIXMappedReadStream *makeFromPath(const Common::String &path);
+
+	~POSIXMappedReadStream();
+
+private:
+	POSIXMappedReadStream(void *data, uint32 size);
+
+	void *_mapping;
+	uint32 _mappingSize;
+};
+
+#endif
@@ -70,6 +70,7 @@ public:
 	virtual void unlockScreen() = 0;
 	virtual void fillScreen(uint32 col) = 0;
 	virtual void updateScreen() = 0;
+	virtual void updateScreenRects(const Common::List<Common::Rect> &dirtyRects) { updateScreen(); }
 	virtual void setShakePos(int shakeOffset) = 0;
 	virtual void setFocusRectangle(const Common::Rect& rect) = 0;
 	virtual void clearFocusRectangle() = 0;
@@ -27,6 +27,7 @@
 #include "backends/graphics/surfacesdl/surfacesdl-graphics.h"
 #include "backends/events/sdl/sdl-events.h"
 #include "backends/platform/sdl/sdl.h"
+#include "common/array.h"
 #include "common/config-manager.h"
 #include "common/mutex.h"
 #include "common/textconsole.h"
@@ -34,6 +35,7 @@
 #include "common/util.h"
 #ifdef USE_RGB_COLOR
 #include "common/list.h"
+#include "common/rect.h"
 #endif
 #include "graphics/font.h"
 #include "graphics/fontman.h"
@@ -54,6 +56,7 @@ SurfaceSdlGraphicsManager::SurfaceSdlGraphicsManager(SdlEventSource *sdlEventSou
 	_overlayscreen(0),
 	_overlayWidth(0), _overlayHeight(0),
 	_overlayDirty(true),
+	_forceFull(true),
 	_screenChangeCount(0)
 #ifdef USE_OPENGL
 	, _opengl(false), _overlayNumTex(0), _overlayTexIds(0)
@@ -229,6 +232,9 @@ Graphics::PixelBuffer SurfaceSdlGraphicsManager::setupScreen(int screenW, int sc
 	if (!_screen)
 		error("Could not initialize video: %s", SDL_GetError());
 
+	// Nothing of the new screen has been presented yet
+	_forceFull = true;
+
 #ifdef USE_OPENGL
 	if (_opengl) {
 		int glflag;
@@ -513,6 +519,38 @@ void SurfaceSdlGraphicsManager::updateScreen() {
 	}
 }
 
+void SurfaceSdlGraphicsManager::updateScreenRects(const Common::List<Common::Rect> &dirtyRects) {
+	// OpenGL swaps whole buffers
+#ifdef USE_OPENGL
+	if (_opengl) {
+		updateScreen();
+		return;
+	}
+#endif
+	// The overlay is drawn into the screen surface, so the first frame
+	// after it is hidden has to be presented in full
+	if (_overlayVisible || _forceFull) {
+		_forceFull = _overlayVisible;
+		updateScreen();
+		return;
+	}
+
+	if (dirtyRects.empty())
+		return;
+
+	Common::Array<SDL_Rect> rects;
+	rects.reserve(dirtyRects.size());
+	for (Common::List<Common::Rect>::const_iterator it = dirtyRects.begin(); it != dirtyRects.end(); ++it) {
+		SDL_Rect rect;
+		rect.x = it->left;
+		rect.y = it->top;
+		rect.w = it->width();
+		rect.h = it->height();
+		rects.push_back(rect);
+	}
+	SDL_UpdateRects(_screen, rects.size(), rects.begin());
+}
+
 void SurfaceSdlGraphicsManager::copyRectToScreen(const void *src, int pitch, int x, int y, int w, int h) {
 	// ResidualVM: not use it
 }
@@ -164,6 +164,18 @@ void ModularBackend::updateScreen() {
 #endif
 }
 
+void ModularBackend::updateScreenRects(const Common::List<Common::Rect> &dirtyRects) {
+#ifdef ENABLE_EVENTRECORDER
+	g_eventRec.preDrawOverlayGui();
+#endif
+
+	_graphicsManager->updateScreenRects(dirtyRects);
+
+#ifdef ENABLE_EVENTRECORDER
+	g_eventRec.postDrawOverlayGui();
+#endif
+}
+
 void ModularBackend::setShakePos(int shakeOffset) {
 	_graphicsManager->setShakePos(shakeOffset);
 }
@@ -87,6 +87,7 @@ public:
 	virtual void unlockScreen();
 	virtual void fillScreen(uint32 col);
 	virtual void updateScreen();
+	virtual void updateScreenRects(const Common::List<Common::Rect> &dirtyRects);
 	virtual void setShakePos(int shakeOffset);
 	virtual void setFocusRectangle(const Common::Rect& rect);
 	virtual void clearFocusRectangle();
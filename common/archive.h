@@ -31,6 +31,7 @@
 namespace Common {
 
 class FSNode;
+class MemoryReadStream;
 class SeekableReadStream;
 
 
@@ -48,6 +49,13 @@ public:
 	virtual SeekableReadStream *createReadStream() const = 0;
 	virtual String getName() const = 0;
 	virtual String getDisplayName() const { return getName(); }
+
+	/**
+	 * Creates a stream over the contents of the member mapped in memory,
+	 * which readers can access without copying them. Only some members
+	 * support this, the others return 0.
+	 */
+	virtual MemoryReadStream *createMappedReadStream() const { return 0; }
 };
 
 typedef SharedPtr<ArchiveMember> ArchiveMemberPtr;
@@ -97,6 +97,14 @@ bool File::exists(const String &filename) {
 	return false;
 }
 
+MemoryReadStream *File::createMappedReadStream(const String &filename) {
+	ArchiveMemberPtr member = SearchMan.getMember(filename);
+	if (!member)
+		return 0;
+
+	return member->createMappedReadStream();
+}
+
 void File::close() {
 	delete _handle;
 	_handle = NULL;
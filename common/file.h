@@ -57,6 +57,16 @@ public:
 	 */
 	static bool exists(const String &filename);
 
+	/**
+	 * Maps the file with the given name in memory. The file is searched in
+	 * SearchMan, as done by open(). Only the files of the file system can be
+	 * mapped, and only on the backends which support it.
+	 *
+	 * @param	filename	the file to map
+	 * @return	a stream over the mapped file, or 0 if it cannot be mapped
+	 */
+	static MemoryReadStream *createMappedReadStream(const String &filename);
+
 	/**
 	 * Try to open the file with the given filename, by searching SearchMan.
 	 * @note Must not be called if this file already is open (i.e. if isOpen returns true).
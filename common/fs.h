@@ -35,6 +35,7 @@ class AbstractFSNode;
 namespace Common {
 
 class FSNode;
+class MemoryReadStream;
 class SeekableReadStream;
 class WriteStream;
 
@@ -215,6 +216,15 @@ public:
 	 */
 	virtual SeekableReadStream *createReadStream() const;
 
+	/**
+	 * Creates a MemoryReadStream over the file referred by this node, mapped
+	 * in memory. This is only supported by some backends, and 0 is returned
+	 * when the file cannot be mapped.
+	 *
+	 * @return pointer to the stream object, 0 in case of a failure
+	 */
+	virtual MemoryReadStream *createMappedReadStream() const;
+
 	/**
 	 * Creates a WriteStream instance corresponding to the file
 	 * referred by this node. This assumes that the node actually refers
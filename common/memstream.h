@@ -70,6 +70,12 @@ public:
 	int32 size() const { return _size; }
 
 	bool seek(int32 offs, int whence = SEEK_SET);
+
+	/**
+	 * Return the start of the memory buffer, so that parts of it can be read
+	 * by other streams without copying them.
+	 */
+	const byte *getData() const { return _ptrOrig; }
 };
 
 
@@ -32,6 +32,7 @@ MODULE_OBJS := \
 	streamdebug.o \
 	system.o \
 	textconsole.o \
+	threadpool.o \
 	tokenizer.o \
 	translation.o \
 	unarj.o \
@@ -764,6 +764,16 @@ public:
 	 */
 	virtual void updateScreen() = 0;
 
+	/**
+	 * Flush the given areas of the screen framebuffer to the display. The
+	 * rest of the screen is assumed to be unchanged since the previous update.
+	 *
+	 * Backends which cannot present part of the screen redraw all of it.
+	 *
+	 * @param dirtyRects	the areas of the screen which changed
+	 */
+	virtual void updateScreenRects(const Common::List<Common::Rect> &dirtyRects) { updateScreen(); }
+
 	/**
 	 * !!! Not used in ResidualVM !!!
 	 *
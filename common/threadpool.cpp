@@ -0,0 +1,201 @@
+/* ScummVM - Graphic Adventure Engine
+ *
+ * ScummVM is the legal property of its developers, whose names
+ * are too numerous to list here. Please refer to the COPYRIGHT
+ * file distributed with this source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#define FORBIDDEN_SYMBOL_EXCEPTION_time_h
+#define FORBIDDEN_SYMBOL_EXCEPTION_unistd_h
+#define FORBIDDEN_SYMBOL_EXCEPTION_exit		//Needed for IRIX's unistd.h
+
+#include "common/threadpool.h"
+#include "common/textconsole.h"
+
+#if defined(USE_PTHREADS)
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+namespace Common {
+
+#if defined(USE_PTHREADS)
+
+struct ThreadPool::Workers {
+	pthread_mutex_t mutex;
+	pthread_cond_t wakeUp;
+	pthread_cond_t batchDone;
+	pthread_t *threads;
+	int numThreads;
+
+	// Current batch, protected by mutex
+	JobProc proc;
+	void *data;
+	int numJobs;
+	int nextJob;
+	int pendingJobs;
+	uint32 batch;
+	bool quit;
+
+	// Take jobs of the current batch until there are none left.
+	// The mutex must be held, and is held again on return.
+	void runJobs(int thread) {
+		while (nextJob < numJobs) {
+			int job = nextJob++;
+			JobProc jobProc = proc;
+			void *jobData = data;
+
+			pthread_mutex_unlock(&mutex);
+			jobProc(jobData, job, thread);
+			pthread_mutex_lock(&mutex);
+
+			if (--pendingJobs == 0)
+				pthread_cond_signal(&batchDone);
+		}
+	}
+
+	struct WorkerStart {
+		Workers *workers;
+		int thread;
+	};
+
+	static void *workerMain(void *arg);
+};
+
+void *ThreadPool::Workers::workerMain(void *arg) {
+	WorkerStart *start = (WorkerStart *)arg;
+	Workers *w = start->workers;
+	int thread = start->thread;
+	delete start;
+
+	pthread_mutex_lock(&w->mutex);
+	uint32 seenBatch = w->batch;
+	while (true) {
+		while (!w->quit && w->batch == seenBatch)
+			pthread_cond_wait(&w->wakeUp, &w->mutex);
+		if (w->quit)
+			break;
+		seenBatch = w->batch;
+		w->runJobs(thread);
+	}
+	pthread_mutex_unlock(&w->mutex);
+	return nullptr;
+}
+
+ThreadPool::ThreadPool(int numThreads) : _numThreads(1), _workers(nullptr) {
+	if (numThreads <= 1)
+		return;
+
+	_workers = new Workers();
+	pthread_mutex_init(&_workers->mutex, nullptr);
+	pthread_cond_init(&_workers->wakeUp, nullptr);
+	pthread_cond_init(&_workers->batchDone, nullptr);
+	_workers->threads = new pthread_t[numThreads - 1];
+	_workers->numThreads = 0;
+	_workers->proc = nullptr;
+	_workers->data = nullptr;
+	_workers->numJobs = 0;
+	_workers->nextJob = 0;
+	_workers->pendingJobs = 0;
+	_workers->batch = 0;
+	_workers->quit = false;
+
+	for (int i = 1; i < numThreads; i++) {
+		Workers::WorkerStart *start = new Workers::WorkerStart();
+		start->workers = _workers;
+		start->thread = i;
+		if (pthread_create(&_workers->threads[i - 1], nullptr, Workers::workerMain, start) != 0) {
+			warning("ThreadPool: could only start %d of %d threads", i, numThreads);
+			delete start;
+			break;
+		}
+		_workers->numThreads++;
+	}
+	_numThreads = _workers->numThreads + 1;
+}
+
+ThreadPool::~ThreadPool() {
+	if (!_workers)
+		return;
+
+	pthread_mutex_lock(&_workers->mutex);
+	_workers->quit = true;
+	pthread_cond_broadcast(&_workers->wakeUp);
+	pthread_mutex_unlock(&_workers->mutex);
+
+	for (int i = 0; i < _workers->numThreads; i++)
+		pthread_join(_workers->threads[i], nullptr);
+
+	pthread_cond_destroy(&_workers->batchDone);
+	pthread_cond_destroy(&_workers->wakeUp);
+	pthread_mutex_destroy(&_workers->mutex);
+	delete[] _workers->threads;
+	delete _workers;
+}
+
+void ThreadPool::run(JobProc proc, void *data, int numJobs) {
+	if (_numThreads <= 1 || numJobs <= 1) {
+		for (int i = 0; i < numJobs; i++)
+			proc(data, i, 0);
+		return;
+	}
+
+	pthread_mutex_lock(&_workers->mutex);
+	_workers->proc = proc;
+	_workers->data = data;
+	_workers->numJobs = numJobs;
+	_workers->nextJob = 0;
+	_workers->pendingJobs = numJobs;
+	_workers->batch++;
+	pthread_cond_broadcast(&_workers->wakeUp);
+
+	_workers->runJobs(0);
+	while (_workers->pendingJobs > 0)
+		pthread_cond_wait(&_workers->batchDone, &_workers->mutex);
+	pthread_mutex_unlock(&_workers->mutex);
+}
+
+int ThreadPool::getNumProcessors() {
+#ifdef _SC_NPROCESSORS_ONLN
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	if (count > 0)
+		return (int)count;
+#endif
+	return 1;
+}
+
+#else
+
+ThreadPool::ThreadPool(int numThreads) : _numThreads(1), _workers(nullptr) {
+}
+
+ThreadPool::~ThreadPool() {
+}
+
+void ThreadPool::run(JobProc proc, void *data, int numJobs) {
+	for (int i = 0; i < numJobs; i++)
+		proc(data, i, 0);
+}
+
+int ThreadPool::getNumProcessors() {
+	return 1;
+}
+
+#endif
+
+} // End of namespace Common
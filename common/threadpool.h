@@ -0,0 +1,73 @@
+/* ScummVM - Graphic Adventure Engine
+ *
+ * ScummVM is the legal property of its developers, whose names
+ * are too numerous to list here. Please refer to the COPYRIGHT
+ * file distributed with this source distribution.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ *
+ */
+
+#ifndef COMMON_THREADPOOL_H
+#define COMMON_THREADPOOL_H
+
+#include "common/scummsys.h"
+#include "common/noncopyable.h"
+
+namespace Common {
+
+/**
+ * A fixed set of worker threads executing batches of independent jobs.
+ *
+ * The calling thread takes part in every batch, so a pool created with a
+ * single thread does not spawn anything. On platforms without thread
+ * support the jobs are always run serially on the calling thread.
+ */
+class ThreadPool : NonCopyable {
+public:
+	/**
+	 * Job callback. It is called once for every job of a batch, together with
+	 * the index of the thread running it, which is in [0, getNumThreads()).
+	 * A given thread index never runs two jobs at the same time.
+	 */
+	typedef void (*JobProc)(void *data, int job, int thread);
+
+	explicit ThreadPool(int numThreads);
+	~ThreadPool();
+
+	int getNumThreads() const { return _numThreads; }
+
+	/**
+	 * Run proc for every job in [0, numJobs), and return once all of them
+	 * are done. Must not be called from inside a job.
+	 */
+	void run(JobProc proc, void *data, int numJobs);
+
+	/**
+	 * Return the number of processors available to the process, or 1 if
+	 * it cannot be determined.
+	 */
+	static int getNumProcessors();
+
+private:
+	struct Workers;
+
+	int _numThreads;
+	Workers *_workers;
+};
+
+} // End of namespace Common
+
+#endif
@@ -51,6 +51,15 @@ Shadow::Shadow() :
 		shadowMask(nullptr), shadowMaskSize(0), active(false), dontNegate(false), userData(nullptr) {
 }
 
+void Shadow::clearShadowMasks() {
+	for (ShadowMaskCache::iterator i = shadowMasks.begin(); i != shadowMasks.end(); ++i) {
+		delete[] i->_value;
+	}
+	shadowMasks.clear();
+	shadowMask = nullptr;
+	shadowMaskSize = 0;
+}
+
 static int animTurn(float turnAmt, const Math::Angle &dest, Math::Angle *cur) {
 	Math::Angle d = dest - *cur;
 	d.normalize(-180);
@@ -96,7 +105,7 @@ Actor::Actor() :
 		_globalAlpha(1.f), _alphaMode(AlphaOff),
 		 _mustPlaceText(false), 
 		_shadowActive(false), _puckOrient(false), _talking(false), 
-		_inOverworld(false), _drawnToClean(false), _backgroundTalk(false),
+		_inOverworld(false), _drawnToClean(false), _drawPrepared(false), _backgroundTalk(false),
 		_sortOrder(0), _haveSectorSortOrder(false), _sectorSortOrder(0),
 		_cleanBuffer(0), _lightMode(LightFastDyn), _hasFollowedBoxes(false),
 		_lookAtActor(0) {
@@ -230,8 +239,8 @@ void Actor::saveState(SaveGame *savedState) const {
 			savedState->writeString(p.sector->getName());
 		}
 
-		savedState->writeLESint32(shadow.shadowMaskSize);
-		savedState->write(shadow.shadowMask, shadow.shadowMaskSize);
+		// The shadow masks are drawn again after loading
+		savedState->writeLESint32(0);
 		savedState->writeBool(shadow.active);
 		savedState->writeBool(shadow.dontNegate);
 	}
@@ -399,13 +408,12 @@ bool Actor::restoreState(SaveGame *savedState) {
 			}
 		}
 
-		shadow.shadowMaskSize = savedState->readLESint32();
-		delete[] shadow.shadowMask;
-		if (shadow.shadowMaskSize > 0) {
-			shadow.shadowMask = new byte[shadow.shadowMaskSize];
-			savedState->read(shadow.shadowMask, shadow.shadowMaskSize);
-		} else {
-			shadow.shadowMask = nullptr;
+		// Older savegames contain the shadow mask, which is drawn again instead
+		int shadowMaskSize = savedState->readLESint32();
+		if (shadowMaskSize > 0) {
+			byte *shadowMask = new byte[shadowMaskSize];
+			savedState->read(shadowMask, shadowMaskSize);
+			delete[] shadowMask;
 		}
 		shadow.active = savedState->readBool();
 		shadow.dontNegate = savedState->readBool();
@@ -1594,17 +1602,22 @@ void Actor::update(uint frameTime) {
 		}
 	}
 
-	Costume *c = getCurrentCostume();
-	if (c) {
-		c->animate();
-	}
-
 	if (_lookingMode && _lookAtActor != 0) {
 		Actor *actor = Actor::getPool().getObject(_lookAtActor);
 		if (actor)
 			_lookAtVector = actor->getHeadPos();
 	}
 
+	if (g_grim->getGameType() == GType_GRIM)
+		animate();
+}
+
+void Actor::animate() {
+	Costume *c = getCurrentCostume();
+	if (c) {
+		c->animate();
+	}
+
 	for (Common::List<Costume *>::iterator i = _costumeStack.begin(); i != _costumeStack.end(); ++i) {
 		(*i)->moveHead(_lookingMode, _lookAtVector);
 	}
@@ -1636,12 +1649,24 @@ bool Actor::updateTalk(uint frameTime) {
 	return false;
 }
 
+void Actor::prepareDraw() {
+	for (Common::List<Costume *>::iterator i = _costumeStack.begin(); i != _costumeStack.end(); ++i) {
+		Costume *c = *i;
+		c->prepareDraw();
+	}
+	_drawPrepared = true;
+}
+
 void Actor::draw() {
 	for (Common::List<Costume *>::iterator i = _costumeStack.begin(); i != _costumeStack.end(); ++i) {
 		Costume *c = *i;
 		c->setupTextures();
 	}
 
+	if (!_drawPrepared)
+		prepareDraw();
+	_drawPrepared = false;
+
 	if (!g_driver->isHardwareAccelerated() && g_grim->getFlagRefreshShadowMask()) {
 		for (int l = 0; l < MAX_SHADOWS; l++) {
 			if (!_shadowArray[l].active)
@@ -1738,6 +1763,7 @@ void Actor::addShadowPlane(const char *n, Set *scene, int shadowId) {
 		// the scenes' sectors are deleted while they are still keeped by the actors.
 		Plane p = { scene->getName(), new Sector(*sector) };
 		_shadowArray[shadowId].planeList.push_back(p);
+		_shadowArray[shadowId].clearShadowMasks();
 		g_grim->flagRefreshShadowMask(true);
 	}
 }
@@ -1805,14 +1831,11 @@ void Actor::clearShadowPlanes() {
 			delete shadow->planeList.back().sector;
 			shadow->planeList.pop_back();
 		}
-		delete[] shadow->shadowMask;
-		shadow->shadowMaskSize = 0;
-		shadow->shadowMask = nullptr;
+		shadow->clearShadowMasks();
 		shadow->active = false;
 		shadow->dontNegate = false;
 
-		// TODO: Clean up the userData properly
-		shadow->userData = nullptr;
+		g_driver->destroyShadow(shadow);
 	}
 }
 
@@ -2343,6 +2366,28 @@ void Actor::restoreCleanBuffer() {
 	}
 }
 
+void Actor::releaseRenderData() {
+	for (int i = 0; i < MAX_SHADOWS; i++) {
+		Shadow *shadow = &_shadowArray[i];
+		shadow->clearShadowMasks();
+		g_driver->destroyShadow(shadow);
+	}
+
+	// _drawnToClean is kept, so that restoreRenderData() knows whether
+	// the buffer has to be drawn again
+	if (_cleanBuffer) {
+		g_driver->delBuffer(_cleanBuffer);
+		_cleanBuffer = 0;
+	}
+}
+
+void Actor::restoreRenderData() {
+	// Unlike after loading a savegame the actor is already posed, so it is
+	// only drawn again, without updating it
+	if (_drawnToClean)
+		drawToCleanBuffer();
+}
+
 Material *Actor::findMaterial(const Common::String &name) {
 	Common::String fixedName = g_resourceloader->fixFilename(name, false);
 	Common::List<Material *>::iterator it = _materials.begin();
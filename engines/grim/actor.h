@@ -26,6 +26,8 @@
 #include "engines/grim/pool.h"
 #include "engines/grim/object.h"
 #include "engines/grim/color.h"
+#include "common/hashmap.h"
+#include "common/hash-str.h"
 #include "math/vector3d.h"
 #include "math/angle.h"
 #include "math/quat.h"
@@ -50,12 +52,18 @@ typedef Common::List<Plane> SectorListType;
 
 #define MAX_SHADOWS 5
 
+typedef Common::HashMap<Common::String, byte *> ShadowMaskCache;
+
 struct Shadow {
 	Shadow();
+	void clearShadowMasks();
 
 	Common::String name;
 	Math::Vector3d pos;
 	SectorListType planeList;
+	// The shadow masks drawn by the software renderer, one for each set and
+	// camera setup. shadowMask points to the one of the current setup.
+	ShadowMaskCache shadowMasks;
 	byte *shadowMask;
 	int shadowMaskSize;
 	bool active;
@@ -483,10 +491,22 @@ public:
 	void setFollowBoxes(bool follow);
 	bool hasFollowedBoxes() const { return _hasFollowedBoxes; }
 	void update(uint frameTime);
+	/**
+	 * Apply the animations of the current costume and turn the head.
+	 * Grim actors are animated by update(), EMI ones by EMIEngine::animateActors()
+	 * once all the actors are updated.
+	 */
+	void animate();
 	/**
 	 * Check if the actor is still talking. If it is returns true, otherwise false.
 	 */
 	bool updateTalk(uint frameTime);
+	/**
+	 * Do the CPU side work of draw(), skinning and lighting the models.
+	 * This does not touch the renderer, so it may run on a worker thread.
+	 * If it was not called before draw(), draw() calls it itself.
+	 */
+	void prepareDraw();
 	void draw();
 
 	bool isLookAtVectorZero() {
@@ -545,6 +565,14 @@ public:
 	void drawToCleanBuffer();
 	void clearCleanBuffer();
 
+	/**
+	 * Release what the renderer keeps for the actor, i.e. the shadow data
+	 * and the clean buffer, before the renderer is changed.
+	 * restoreRenderData() creates it again with the new one.
+	 */
+	void releaseRenderData();
+	void restoreRenderData();
+
 	bool isTalkingForeground() const;
 
 	LightMode getLightMode() const { return _lightMode; }
@@ -706,6 +734,7 @@ private:
 	bool _shadowActive;
 	int _cleanBuffer;
 	bool _drawnToClean;
+	bool _drawPrepared;
 
 	LightMode _lightMode;
 
@@ -60,6 +60,7 @@ BitmapData::BitmapData(const Common::String &fname) {
 	_data = nullptr;
 	_loaded = false;
 	_keepData = true;
+	_fromFile = true;
 
 	// Initialize members to avoid warnings:
 	_numImages = 0;
@@ -90,6 +91,13 @@ void BitmapData::load() {
 	if (_loaded) {
 		return;
 	}
+	if (!_fromFile) {
+		if (_data) {
+			g_driver->createBitmap(this);
+			_loaded = true;
+		}
+		return;
+	}
 	Common::SeekableReadStream *data = g_resourceloader->openNewStreamFile(_fname.c_str());
 
 	uint32 tag = data->readUint32BE();
@@ -195,6 +203,7 @@ BitmapData::BitmapData(const Graphics::PixelBuffer &buf, int w, int h, const cha
 	_data[0].copyBuffer(0, w * h, buf);
 	_loaded = true;
 	_keepData = true;
+	_fromFile = false;
 
 	_userData = nullptr;
 	_texc = nullptr;
@@ -207,7 +216,7 @@ BitmapData::BitmapData(const Graphics::PixelBuffer &buf, int w, int h, const cha
 BitmapData::BitmapData() :
 		_numImages(0), _width(0), _height(0), _x(0), _y(0), _format(0), _numTex(0),
 		_bpp(0), _colorFormat(0), _texIds(nullptr), _hasTransparency(false), _data(nullptr),
-		_refCount(1), _loaded(false), _keepData(false), _texc(nullptr), _verts(nullptr),
+		_refCount(1), _loaded(false), _keepData(false), _fromFile(false), _texc(nullptr), _verts(nullptr),
 		_layers(nullptr), _numCoords(0), _numVerts(0), _numLayers(0), _userData(nullptr) {
 }
 
@@ -231,6 +240,47 @@ BitmapData::~BitmapData() {
 	delete[] _verts;
 }
 
+void BitmapData::unload() {
+	if (!_loaded) {
+		return;
+	}
+
+	Graphics::PixelBuffer *data = nullptr;
+	if (!_fromFile) {
+		// The renderer may have converted the pixels in place, go back to
+		// the format the bitmap was created with.
+		Graphics::PixelFormat pixelFormat(2, 5, 6, 5, 0, 11, 5, 0, 0);
+		data = new Graphics::PixelBuffer[_numImages];
+		for (int i = 0; i < _numImages; i++) {
+			data[i].create(pixelFormat, _width * _height, DisposeAfterUse::YES);
+			data[i].copyBuffer(0, 0, _width * _height, _data[i]);
+		}
+	}
+
+	g_driver->destroyBitmap(this);
+	delete[] _data;
+	_data = data;
+	_texIds = nullptr;
+	_numTex = 0;
+	_userData = nullptr;
+	_loaded = false;
+
+	if (_fromFile) {
+		delete[] _texc;
+		delete[] _layers;
+		delete[] _verts;
+		_texc = nullptr;
+		_layers = nullptr;
+		_verts = nullptr;
+		_numCoords = 0;
+		_numVerts = 0;
+		_numLayers = 0;
+	} else {
+		_bpp = 16;
+		_colorFormat = BM_RGB565;
+	}
+}
+
 void BitmapData::freeData() {
 	if (!_keepData) {
 		delete[] _data;
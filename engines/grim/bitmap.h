@@ -59,6 +59,14 @@ public:
 
 	void load();
 
+	/**
+	 * Release everything the current renderer created for the bitmap, so
+	 * that the next load() creates it again with the active renderer.
+	 * Bitmaps read from a file are read again, the others keep a copy of
+	 * their pixels.
+	 */
+	void unload();
+
 	/**
 	 * Loads an EMI TILE-bitmap.
 	 *
@@ -99,6 +107,7 @@ public:
 	bool _hasTransparency;
 	bool _loaded;
 	bool _keepData;
+	bool _fromFile;
 
 	int _refCount;
 
@@ -23,6 +23,8 @@
 #include "engines/grim/debugger.h"
 #include "engines/grim/md5check.h"
 #include "engines/grim/grim.h"
+#include "engines/grim/material.h"
+#include "engines/grim/resource.h"
 
 namespace Grim {
 
@@ -32,6 +34,7 @@ Debugger::Debugger() :
 	registerCmd("check_gamedata", WRAP_METHOD(Debugger, cmd_checkFiles));
 	registerCmd("lua_do", WRAP_METHOD(Debugger, cmd_lua_do));
 	registerCmd("emi_jump", WRAP_METHOD(Debugger, cmd_emi_jump));
+	registerCmd("resources", WRAP_METHOD(Debugger, cmd_resources));
 }
 
 Debugger::~Debugger() {
@@ -76,4 +79,36 @@ bool Debugger::cmd_emi_jump(int argc, const char **argv) {
 	return true;
 }
 
+template<class T>
+static void printRegistry(GUI::Debugger *debugger, const char *name, const ResourceRegistry<T> &registry) {
+	uint32 lookups = registry.getHits() + registry.getMisses();
+	debugger->debugPrintf("%-12s %5d loaded, %6d hits, %6d misses (%d%% hits)\n", name, registry.size(),
+	                      registry.getHits(), registry.getMisses(), lookups ? registry.getHits() * 100 / lookups : 0);
+}
+
+bool Debugger::cmd_resources(int argc, const char **argv) {
+	if (!g_resourceloader) {
+		debugPrintf("No resources loaded.\n");
+		return true;
+	}
+
+	printRegistry(this, "models", g_resourceloader->getModelRegistry());
+	printRegistry(this, "colormaps", g_resourceloader->getColormapRegistry());
+	printRegistry(this, "keyframes", g_resourceloader->getKeyframeRegistry());
+	printRegistry(this, "lipsyncs", g_resourceloader->getLipSyncRegistry());
+	printRegistry(this, "animations", g_resourceloader->getAnimationEmiRegistry());
+	if (MaterialData::_registry)
+		printRegistry(this, "materials", *MaterialData::_registry);
+	else
+		debugPrintf("%-12s %5d loaded\n", "materials", 0);
+
+	uint32 hits, misses, evictions;
+	uint64 inflatedBytesSaved;
+	g_resourceloader->getCacheCounters(hits, misses, evictions, inflatedBytesSaved);
+	debugPrintf("File cache: %d KB of %d KB, %d hits, %d misses, %d evictions, %d KB of inflating saved\n",
+	            g_resourceloader->getCacheMemorySize() / 1024, g_resourceloader->getCacheMemoryBudget() / 1024,
+	            hits, misses, evictions, (int)(inflatedBytesSaved / 1024));
+	return true;
+}
+
 }
@@ -37,6 +37,7 @@ public:
 	bool cmd_checkFiles(int argc, const char **argv);
 	bool cmd_lua_do(int argc, const char **argv);
 	bool cmd_emi_jump(int argc, const char **argv);
+	bool cmd_resources(int argc, const char **argv);
 };
 
 }
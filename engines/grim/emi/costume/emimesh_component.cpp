@@ -66,6 +66,13 @@ void EMIMeshComponent::reset() {
 	_visible = true;
 }
 
+void EMIMeshComponent::prepareDraw() {
+	if (_parent && _parent->isVisible())
+		return;
+	if (_obj)
+		_obj->prepareDraw();
+}
+
 void EMIMeshComponent::draw() {
 	// If the object was drawn by being a component
 	// of it's parent then don't draw it
@@ -37,6 +37,7 @@ public:
 	void init() override;
 	int update(uint time) override;
 	void reset() override;
+	void prepareDraw();
 	void draw() override;
 	void getBoundingBox(int *x1, int *y1, int *x2, int *y2) const;
 
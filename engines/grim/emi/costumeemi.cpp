@@ -190,6 +190,27 @@ Component *EMICostume::loadEMIComponent(Component *parent, int parentID, const c
 	return nullptr;
 }
 
+void EMICostume::prepareDraw() {
+	// Prepare the meshes that draw() will draw
+	bool preparedMesh = false;
+	for (Common::List<Chore*>::iterator it = _playingChores.begin(); it != _playingChores.end(); ++it) {
+		Chore *c = (*it);
+		if (!c->_playing)
+			continue;
+		for (int i = 0; i < c->_numTracks; ++i) {
+			Component *component = c->_tracks[i].component;
+			if (component && component->isComponentType('m', 'e', 's', 'h')) {
+				static_cast<EMIMeshComponent *>(component)->prepareDraw();
+				preparedMesh = true;
+			}
+		}
+	}
+
+	if (_wearChore && !preparedMesh && _isWearChoreActive) {
+		_wearChore->getMesh()->prepareDraw();
+	}
+}
+
 void EMICostume::draw() {
 	bool drewMesh = false;
 	for (Common::List<Chore*>::iterator it = _playingChores.begin(); it != _playingChores.end(); ++it) {
@@ -43,6 +43,7 @@ public:
 
 	void load(Common::SeekableReadStream *data) override;
 
+	void prepareDraw() override;
 	void draw() override;
 	int update(uint time) override;
 
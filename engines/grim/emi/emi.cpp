@@ -20,6 +20,7 @@
  *
  */
 
+#include "common/config-manager.h"
 #include "common/foreach.h"
 
 #include "engines/grim/emi/emi.h"
@@ -40,11 +41,19 @@ EMIEngine::EMIEngine(OSystem *syst, uint32 gameFlags, GrimGameType gameType, Com
 
 	g_emi = this;
 	g_emiregistry = new EmiRegistry();
+
+	// The serial path gives a reference to compare the threaded results with
+	ConfMan.registerDefault("serial_actor_update", false);
+	int numThreads = 1;
+	if (!ConfMan.getBool("serial_actor_update"))
+		numThreads = Common::ThreadPool::getNumProcessors();
+	_actorThreads = new Common::ThreadPool(numThreads);
 }
 
 
 
 EMIEngine::~EMIEngine() {
+	delete _actorThreads;
 	g_emi = nullptr;
 	delete g_emiregistry;
 	g_emiregistry = nullptr;
@@ -142,6 +151,7 @@ void EMIEngine::drawNormalMode() {
 	// Draw actors
 	buildActiveActorsList();
 	sortActiveActorsList();
+	prepareActorsDraw();
 
 	Bitmap *background = _currSet->getCurrSetup()->_bkgndBm;
 	background->_data->load();
@@ -184,6 +194,45 @@ void EMIEngine::drawNormalMode() {
 
 }
 
+void EMIEngine::animateActorJob(void *data, int job, int thread) {
+	Common::Array<Actor *> *actors = (Common::Array<Actor *> *)data;
+	(*actors)[job]->animate();
+}
+
+void EMIEngine::prepareActorDrawJob(void *data, int job, int thread) {
+	Common::Array<Actor *> *actors = (Common::Array<Actor *> *)data;
+	(*actors)[job]->prepareDraw();
+}
+
+void EMIEngine::animateActors() {
+	// Every actor only writes to its own costumes, except that attached actors
+	// read the joints of the actor they are attached to. Those are animated
+	// afterwards, in order.
+	_jobActors.clear();
+	foreach (Actor *a, _activeActors) {
+		if (!a->isAttached())
+			_jobActors.push_back(a);
+	}
+	_actorThreads->run(&animateActorJob, &_jobActors, _jobActors.size());
+
+	foreach (Actor *a, _activeActors) {
+		if (a->isAttached())
+			a->animate();
+	}
+}
+
+void EMIEngine::prepareActorsDraw() {
+	// The frustum of the current setup must be set up already, as the
+	// lighting is skipped for the actors outside of it. The actors picked
+	// here are the ones drawNormalMode() draws.
+	_jobActors.clear();
+	foreach (Actor *a, _activeActors) {
+		if (a->isInOverworld() || (a->isVisible() && a->getEffectiveSortOrder() >= 0))
+			_jobActors.push_back(a);
+	}
+	_actorThreads->run(&prepareActorDrawJob, &_jobActors, _jobActors.size());
+}
+
 void EMIEngine::updateDrawMode() {
 	// For EMI, draw mode is just like normal mode with frozen frame time.
 	updateNormalMode();
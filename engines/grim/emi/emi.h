@@ -23,6 +23,9 @@
 #ifndef EMI_ENGINE_H
 #define EMI_ENGINE_H
 
+#include "common/array.h"
+#include "common/threadpool.h"
+
 #include "engines/grim/grim.h"
 
 namespace Grim {
@@ -49,6 +52,10 @@ public:
 private:
 	LuaBase *createLua() override;
 	void drawNormalMode() override;
+	void animateActors() override;
+	void prepareActorsDraw();
+	static void animateActorJob(void *data, int job, int thread);
+	static void prepareActorDrawJob(void *data, int job, int thread);
 	void updateDrawMode() override;
 	static bool compareTextLayer(const TextObject *x, const TextObject *y);
 	void drawTextObjects() override;
@@ -59,6 +66,10 @@ private:
 
 	bool _textObjectsSortOrderInvalidated;
 	bool _sortOrderInvalidated;
+
+	// Animates, skins and lights the actors, one job per actor
+	Common::ThreadPool *_actorThreads;
+	Common::Array<Actor *> _jobActors;
 };
 
 extern EMIEngine *g_emi;
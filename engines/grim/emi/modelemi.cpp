@@ -145,6 +145,7 @@ void EMIModel::loadMesh(Common::SeekableReadStream *data) {
 		_vertices[i].readFromStream(data);
 		_drawVertices[i] = _vertices[i];
 	}
+	updateDrawBounds();
 	_normals = new Math::Vector3d[_numVertices];
 	_drawNormals = new Math::Vector3d[_numVertices];
 	if (type != 18) {
@@ -200,6 +201,40 @@ void EMIModel::loadMesh(Common::SeekableReadStream *data) {
 			data->read(f, 4);
 			_boneInfos[i]._weight = get_float(f);
 		}
+
+		_skinWeights = new float[_numBoneInfos];
+		_vertexSkinStart = new int[_numVertices + 1];
+		int boneVert = -1;
+		for (int i = 0; i < _numBoneInfos; i++) {
+			if (_boneInfos[i]._incFac == 1 && boneVert < _numVertices - 1) {
+				boneVert++;
+				_vertexSkinStart[boneVert] = i;
+			}
+			_skinWeights[i] = _boneInfos[i]._weight;
+		}
+		for (int i = boneVert + 1; i <= _numVertices; i++) {
+			_vertexSkinStart[i] = _numBoneInfos;
+		}
+
+		_boneJoints = new int[_numBones];
+		_boneBounds = new Math::AABB[_numBones];
+		_boneMatrices = new float[12 * _numBones];
+		for (int i = 0; i < _numBones; i++) {
+			_boneJoints[i] = -1;
+		}
+		memset(_boneMatrices, 0, 12 * _numBones * sizeof(float));
+		for (int i = 0; i < _numVertices; i++) {
+			float weights = 0.0f;
+			for (int j = _vertexSkinStart[i]; j < _vertexSkinStart[i + 1]; j++) {
+				uint32 bone = _boneInfos[j]._joint;
+				if (bone < (uint32)_numBones && _boneInfos[j]._weight > 0.0f) {
+					_boneBounds[bone].expand(_vertices[i]);
+					weights += _boneInfos[j]._weight;
+				}
+			}
+			if (weights < 0.999f)
+				_partialSkinWeights = true;
+		}
 	} else {
 		_numBones = 0;
 		_numBoneInfos = 0;
@@ -220,44 +255,142 @@ void EMIModel::setSkeleton(Skeleton *skel) {
 	for (int i = 0; i < _numBoneInfos; i++) {
 		_vertexBoneInfo[i] = _skeleton->findJointIndex(_boneNames[_boneInfos[i]._joint]);
 	}
+	for (int i = 0; i < _numBones; i++) {
+		_boneJoints[i] = _skeleton->findJointIndex(_boneNames[i]);
+	}
+	_skinRevision = 0;
+}
+
+void EMIModel::setSkinnedByRenderer(bool skinned) {
+	_skinnedByRenderer = skinned;
+	// Skin the model again on the next draw, the other way
+	_skinRevision = 0;
+}
+
+bool EMIModel::getVertexBones(float *indices, float *weights) const {
+	for (int i = 0; i < _numVertices; i++) {
+		int start = _vertexSkinStart[i];
+		int count = _vertexSkinStart[i + 1] - start;
+		if (count > 4)
+			return false;
+		for (int j = 0; j < 4; j++) {
+			indices[4 * i + j] = j < count ? (float)_boneInfos[start + j]._joint : 0.0f;
+			weights[4 * i + j] = j < count ? _skinWeights[start + j] : 0.0f;
+		}
+	}
+	return true;
 }
 
 void EMIModel::prepareForRender() {
 	if (!_skeleton || !_vertexBoneInfo)
 		return;
 
-	for (int i = 0; i < _numVertices; i++) {
-		_drawVertices[i].set(0.0f, 0.0f, 0.0f);
-		_drawNormals[i].set(0.0f, 0.0f, 0.0f);
+	// Nothing to do if no joint moved since the last time
+	if (_skinRevision == _skeleton->getRevision())
+		return;
+	_skinRevision = _skeleton->getRevision();
+
+	const Joint *joints = _skeleton->_joints;
+	if (_skinnedByRenderer) {
+		_drawBounds.reset();
+		bool reachesOrigin = _partialSkinWeights;
+		for (int i = 0; i < _numBones; i++) {
+			float *dst = &_boneMatrices[12 * i];
+			if (_boneJoints[i] < 0) {
+				memset(dst, 0, 12 * sizeof(float));
+				if (_boneBounds[i].isValid())
+					reachesOrigin = true;
+				continue;
+			}
+			const Math::Matrix4 &skin = joints[_boneJoints[i]]._skinMatrix;
+			memcpy(dst, skin.getData(), 12 * sizeof(float));
+
+			// The blended vertices stay within the bones' own transforms of them
+			if (_boneBounds[i].isValid()) {
+				Math::Vector3d corners[8];
+				_boneBounds[i].getCorners(corners);
+				for (int j = 0; j < 8; j++) {
+					skin.transform(&corners[j], true);
+					_drawBounds.expand(corners[j]);
+				}
+			}
+		}
+		// The weights missing from a vertex, and those of bones without a
+		// joint, pull it towards the origin
+		if (reachesOrigin)
+			_drawBounds.expand(Math::Vector3d(0.0f, 0.0f, 0.0f));
+		_skinCount++;
+		return;
 	}
 
-	int boneVert = -1;
-	for (int i = 0; i < _numBoneInfos; i++) {
-		if (_boneInfos[i]._incFac == 1) {
-			boneVert++;
+	for (int i = 0; i < _numVertices; i++) {
+		// Blend the skinning matrices of the joints affecting the vertex,
+		// so that the vertex and its normal are transformed only once.
+		// The inner loop works on whole rows, which compilers vectorize.
+		// The positions and normals stay packed: the renderers read them so,
+		// and splitting them per component measured slower.
+		float m[12] = { 0.0f };
+		for (int j = _vertexSkinStart[i]; j < _vertexSkinStart[i + 1]; j++) {
+			int jointIndex = _vertexBoneInfo[j];
+			if (jointIndex < 0)
+				continue;
+			const float *skin = joints[jointIndex]._skinMatrix.getData();
+			const float weight = _skinWeights[j];
+			for (int k = 0; k < 12; k++) {
+				m[k] += skin[k] * weight;
+			}
 		}
 
-		int jointIndex = _vertexBoneInfo[i];
-		const Math::Matrix4 &jointMatrix = _skeleton->_joints[jointIndex]._finalMatrix;
-		const Math::Matrix4 &bindPose = _skeleton->_joints[jointIndex]._absMatrix;
+		const float *v = _vertices[i].getData();
+		_drawVertices[i].set(m[0] * v[0] + m[1] * v[1] + m[2] * v[2] + m[3],
+		                     m[4] * v[0] + m[5] * v[1] + m[6] * v[2] + m[7],
+		                     m[8] * v[0] + m[9] * v[1] + m[10] * v[2] + m[11]);
+
+		const float *n = _normals[i].getData();
+		_drawNormals[i].set(m[0] * n[0] + m[1] * n[1] + m[2] * n[2],
+		                    m[4] * n[0] + m[5] * n[1] + m[6] * n[2],
+		                    m[8] * n[0] + m[9] * n[1] + m[10] * n[2]);
+		_drawNormals[i].normalize();
+	}
+
+	updateDrawBounds();
+	_drawVerticesDirty = true;
+	_skinCount++;
+}
+
+void EMIModel::prepareDraw() {
+	prepareForRender();
 
-		Math::Vector3d vert = _vertices[boneVert];
-		bindPose.inverseTranslate(&vert);
-		bindPose.inverseRotate(&vert);
-		jointMatrix.transform(&vert, true);
-		_drawVertices[boneVert] += vert * _boneInfos[i]._weight;
+	// If shaders are not available, we calculate lighting in software.
+	if (g_driver->supportsShaders())
+		return;
+
+	Actor *actor = _costume->getOwner();
+	Actor::LightMode lightMode = actor->getLightMode();
+	if (lightMode == Actor::LightNone)
+		return;
+
+	// The static lighting is only computed once, the dynamic one whenever
+	// updateLighting() finds that something changed
+	if (lightMode == Actor::LightStatic && !_lightingDirty)
+		return;
 
-		Math::Vector3d normal = _normals[boneVert];
-		bindPose.inverseRotate(&normal);
-		jointMatrix.transform(&normal, false);
-		_drawNormals[boneVert] += normal * _boneInfos[i]._weight;
+	Math::Matrix4 modelToWorld = actor->getFinalMatrix();
+	Math::AABB bounds = calculateWorldBounds(modelToWorld);
+	if (!actor->isInOverworld()) {
+		if (bounds.isValid() && !g_grim->getCurrSet()->getFrustum().isInside(bounds))
+			return;
 	}
 
+	updateLighting(modelToWorld, bounds);
+	_lightingDirty = false;
+}
+
+void EMIModel::updateDrawBounds() {
+	_drawBounds.reset();
 	for (int i = 0; i < _numVertices; i++) {
-		_drawNormals[i].normalize();
+		_drawBounds.expand(_drawVertices[i]);
 	}
-
-	g_driver->updateEMIModel(this);
 }
 
 void EMIModel::prepareTextures() {
@@ -266,13 +399,29 @@ void EMIModel::prepareTextures() {
 		// HACK: As we dont know what specialty-textures are yet, we skip loading them
 		if (!_texNames[i].contains("specialty"))
 			_mats[i] = _costume->loadMaterial(_texNames[i], false);
-		else
+	}
+	updateSpecialtyTextures();
+}
+
+void EMIModel::updateSpecialtyTextures() {
+	if (!_mats)
+		return;
+
+	// The specialty textures are owned by the renderer
+	for (uint32 i = 0; i < _numTextures; i++) {
+		if (_texNames[i].contains("specialty"))
 			_mats[i] = g_driver->getSpecialtyTexture(_texNames[i][9] - '0');
 	}
 }
 
 void EMIModel::draw() {
-	prepareForRender();
+	// The model was skinned and lit by prepareDraw(), called from Actor::draw()
+	// or beforehand for all the actors at once. When the renderer does the
+	// skinning, it needs the bone matrices for every draw.
+	if (_drawVerticesDirty || _skinnedByRenderer) {
+		g_driver->updateEMIModel(this);
+		_drawVerticesDirty = false;
+	}
 
 	Actor *actor = _costume->getOwner();
 	Math::Matrix4 modelToWorld = actor->getFinalMatrix();
@@ -283,20 +432,6 @@ void EMIModel::draw() {
 			return;
 	}
 
-	if (!g_driver->supportsShaders()) {
-		// If shaders are not available, we calculate lighting in software.
-		Actor::LightMode lightMode = actor->getLightMode();
-		if (lightMode != Actor::LightNone) {
-			if (lightMode != Actor::LightStatic)
-				_lightingDirty = true;
-
-			if (_lightingDirty) {
-				updateLighting(modelToWorld);
-				_lightingDirty = false;
-			}
-		}
-	}
-
 	// We will need to add a call to the skeleton, to get the modified vertices, but for now,
 	// I'll be happy with just static drawing
 	for (uint32 i = 0; i < _numFaces; i++) {
@@ -305,78 +440,163 @@ void EMIModel::draw() {
 	}
 }
 
-void EMIModel::updateLighting(const Math::Matrix4 &modelToWorld) {
+void EMIModel::updateLighting(const Math::Matrix4 &modelToWorld, const Math::AABB &worldBounds) {
 	// Current lighting implementation mimics the NormDyn mode of the original game, even if
 	// FastDyn is requested. We assume that FastDyn mode was used only for the purpose of
 	// performance optimization, but NormDyn mode is visually superior in all cases.
 
-	Common::Array<Grim::Light *> activeLights;
+	// Gather the parameters of the enabled lights. They are the input of the lighting,
+	// and together with the model matrix and the skin they tell whether the lighting
+	// computed last time is still valid.
+	static const int kLightParams = 15;
+	Common::Array<float> params;
+	params.reserve(_lightingParams.size());
+	foreach (Light *l, g_grim->getCurrSet()->getLights()) {
+		if (!l->_enabled)
+			continue;
+		params.push_back((float)l->_type);
+		params.push_back(l->_pos.x());
+		params.push_back(l->_pos.y());
+		params.push_back(l->_pos.z());
+		params.push_back(l->_dir.x());
+		params.push_back(l->_dir.y());
+		params.push_back(l->_dir.z());
+		params.push_back(l->_color.getRed() / 255.0f);
+		params.push_back(l->_color.getGreen() / 255.0f);
+		params.push_back(l->_color.getBlue() / 255.0f);
+		params.push_back(l->_intensity);
+		params.push_back(l->_umbraangle);
+		params.push_back(l->_penumbraangle);
+		params.push_back(l->_falloffNear);
+		params.push_back(l->_falloffFar);
+	}
+
+	if (!_lightingDirty && _lightingSkinCount == _skinCount && params == _lightingParams &&
+	    memcmp(_lightingMatrix.getData(), modelToWorld.getData(), 16 * sizeof(float)) == 0)
+		return;
+	_lightingMatrix = modelToWorld;
+	_lightingSkinCount = _skinCount;
+	_lightingParams = params;
+
+	// Bring the vertices and normals to world space, one array per component
+	const int n = _numVertices;
+	_lightingWorkspace.resize(9 * n);
+	float *px = _lightingWorkspace.begin();
+	float *py = px + n;
+	float *pz = py + n;
+	float *nx = pz + n;
+	float *ny = nx + n;
+	float *nz = ny + n;
+	float *red = nz + n;
+	float *green = red + n;
+	float *blue = green + n;
+
+	const float *m = modelToWorld.getData();
+	for (int i = 0; i < n; i++) {
+		const float *v = _drawVertices[i].getData();
+		px[i] = m[0] * v[0] + m[1] * v[1] + m[2] * v[2] + m[3];
+		py[i] = m[4] * v[0] + m[5] * v[1] + m[6] * v[2] + m[7];
+		pz[i] = m[8] * v[0] + m[9] * v[1] + m[10] * v[2] + m[11];
+		const float *vn = _drawNormals[i].getData();
+		nx[i] = m[0] * vn[0] + m[1] * vn[1] + m[2] * vn[2];
+		ny[i] = m[4] * vn[0] + m[5] * vn[1] + m[6] * vn[2];
+		nz[i] = m[8] * vn[0] + m[9] * vn[1] + m[10] * vn[2];
+		red[i] = 0.0f;
+		green[i] = 0.0f;
+		blue[i] = 0.0f;
+	}
+
+	// Add up one light at a time over all the vertices. Every vertex still gets
+	// the contributions of the lights in the same order as before.
 	bool hasAmbient = false;
+	for (uint j = 0; j < params.size(); j += kLightParams) {
+		const float *l = &params[j];
+		const Light::LightType type = (Light::LightType)(int)l[0];
+		const float colorR = l[7], colorG = l[8], colorB = l[9];
+		const float intensity = l[10];
+
+		if (type == Light::Ambient) {
+			hasAmbient = true;
+			for (int i = 0; i < n; i++) {
+				red[i] += colorR * intensity;
+				green[i] += colorG * intensity;
+				blue[i] += colorB * intensity;
+			}
+			continue;
+		}
 
-	foreach(Light *l, g_grim->getCurrSet()->getLights()) {
-		if (l->_enabled) {
-			activeLights.push_back(l);
-			if (l->_type == Light::Ambient)
-				hasAmbient = true;
+		const float dirX = l[4], dirY = l[5], dirZ = l[6];
+		if (type == Light::Direct) {
+			for (int i = 0; i < n; i++) {
+				float shade = intensity * MAX(0.0f, nx[i] * dirX + ny[i] * dirY + nz[i] * dirZ);
+				red[i] += colorR * shade;
+				green[i] += colorG * shade;
+				blue[i] += colorB * shade;
+			}
+			continue;
 		}
-	}
 
-	for (int i = 0; i < _numVertices; i++) {
-		Math::Vector3d &result = _lighting[i];
-		result.set(0.0f, 0.0f, 0.0f);
-
-		Math::Vector3d normal = _drawNormals[i];
-		Math::Vector3d vertex = _drawVertices[i];
-		modelToWorld.transform(&vertex, true);
-		modelToWorld.transform(&normal, false);
-
-		for (uint j = 0; j < activeLights.size(); ++j) {
-			Light *l = activeLights[j];
-			float shade = l->_intensity;
-		
-			if (l->_type != Light::Ambient) {
-				// Direction of incident light
-				Math::Vector3d dir = l->_dir;
-
-				if (l->_type != Light::Direct) {
-					dir = l->_pos - vertex;
-					float distSq = dir.getSquareMagnitude();
-					if (distSq > l->_falloffFar * l->_falloffFar)
-						continue;
-
-					dir.normalize();
-
-					if (distSq > l->_falloffNear * l->_falloffNear) {
-						float dist = sqrt(distSq);
-						float attn = 1.0f - (dist - l->_falloffNear) / (l->_falloffFar - l->_falloffNear);
-						shade *= attn;
-					}
-				}
+		// Omni and spot lights do not reach further than their far falloff, so
+		// skip the light if that sphere does not touch the bounds of the model.
+		const float posX = l[1], posY = l[2], posZ = l[3];
+		const float umbra = l[11], penumbra = l[12];
+		const float falloffNear = l[13], falloffFar = l[14];
+		const float nearSq = falloffNear * falloffNear;
+		const float farSq = falloffFar * falloffFar;
+		if (worldBounds.isValid()) {
+			const Math::Vector3d min = worldBounds.getMin();
+			const Math::Vector3d max = worldBounds.getMax();
+			float dx = MAX(MAX(min.x() - posX, posX - max.x()), 0.0f);
+			float dy = MAX(MAX(min.y() - posY, posY - max.y()), 0.0f);
+			float dz = MAX(MAX(min.z() - posZ, posZ - max.z()), 0.0f);
+			// Leave some slack, the bounds and the vertices are not rounded the same way
+			if (dx * dx + dy * dy + dz * dz > farSq * 1.001f)
+				continue;
+		}
 
-				if (l->_type == Light::Spot) {
-					float cosAngle = l->_dir.dotProduct(dir);
-					if (cosAngle < 0.0f)
-						continue;
+		for (int i = 0; i < n; i++) {
+			// Direction of incident light
+			float lx = posX - px[i];
+			float ly = posY - py[i];
+			float lz = posZ - pz[i];
+			float distSq = lx * lx + ly * ly + lz * lz;
+			if (distSq > farSq)
+				continue;
+
+			float dist = sqrt(distSq);
+			if (dist > 0.0f) {
+				lx /= dist;
+				ly /= dist;
+				lz /= dist;
+			}
 
-					float angle = acos(cosAngle);
-					if (angle > l->_penumbraangle)
-						continue;
+			float shade = intensity;
+			if (distSq > nearSq)
+				shade *= 1.0f - (dist - falloffNear) / (falloffFar - falloffNear);
 
-					if (angle > l->_umbraangle)
-						shade *= 1.0f - (angle - l->_umbraangle) / (l->_penumbraangle - l->_umbraangle);
-				}
+			if (type == Light::Spot) {
+				float cosAngle = dirX * lx + dirY * ly + dirZ * lz;
+				if (cosAngle < 0.0f)
+					continue;
 
-				float dot = MAX(0.0f, normal.dotProduct(dir));
-				shade *= dot;
-			}
+				float angle = acos(cosAngle);
+				if (angle > penumbra)
+					continue;
 
-			Math::Vector3d color;
-			color.x() = l->_color.getRed() / 255.0f;
-			color.y() = l->_color.getGreen() / 255.0f;
-			color.z() = l->_color.getBlue() / 255.0f;
+				if (angle > umbra)
+					shade *= 1.0f - (angle - umbra) / (penumbra - umbra);
+			}
 
-			result += color * shade;
+			shade *= MAX(0.0f, nx[i] * lx + ny[i] * ly + nz[i] * lz);
+			red[i] += colorR * shade;
+			green[i] += colorG * shade;
+			blue[i] += colorB * shade;
 		}
+	}
+
+	for (int i = 0; i < n; i++) {
+		Math::Vector3d &result = _lighting[i];
+		result.set(red[i], green[i], blue[i]);
 
 		if (!hasAmbient) {
 			// If the set does not specify an ambient light, a default ambient light is used
@@ -405,10 +625,7 @@ void EMIModel::getBoundingBox(int *x1, int *y1, int *x2, int *y2) const {
 }
 
 Math::AABB EMIModel::calculateWorldBounds(const Math::Matrix4 &matrix) const {
-	Math::AABB bounds;
-	for (int i = 0; i < _numVertices; i++) {
-		bounds.expand(_drawVertices[i]);
-	}
+	Math::AABB bounds = _drawBounds;
 	bounds.transform(matrix);
 	return bounds;
 }
@@ -431,6 +648,16 @@ EMIModel::EMIModel(const Common::String &filename, Common::SeekableReadStream *d
 	_boneInfos = nullptr;
 	_numBoneInfos = 0;
 	_vertexBoneInfo = nullptr;
+	_skinWeights = nullptr;
+	_vertexSkinStart = nullptr;
+	_skinRevision = 0;
+	_skinCount = 0;
+	_lightingSkinCount = 0;
+	_skinnedByRenderer = false;
+	_partialSkinWeights = false;
+	_boneJoints = nullptr;
+	_boneBounds = nullptr;
+	_boneMatrices = nullptr;
 	_skeleton = nullptr;
 	_radius = 0;
 	_center = new Math::Vector3d();
@@ -441,12 +668,17 @@ EMIModel::EMIModel(const Common::String &filename, Common::SeekableReadStream *d
 	_boneNames = nullptr;
 	_lighting = nullptr;
 	_lightingDirty = true;
+	_drawVerticesDirty = false;
+	_userData = nullptr;
 
 	loadMesh(data);
 	g_driver->createEMIModel(this);
 }
 
 EMIModel::~EMIModel() {
+	g_driver->destroyEMIModel(this);
+	g_resourceloader->uncacheEMIModel(this);
+
 	delete[] _vertices;
 	delete[] _drawVertices;
 	delete[] _normals;
@@ -458,6 +690,11 @@ EMIModel::~EMIModel() {
 	delete[] _mats;
 	delete[] _boneInfos;
 	delete[] _vertexBoneInfo;
+	delete[] _skinWeights;
+	delete[] _vertexSkinStart;
+	delete[] _boneJoints;
+	delete[] _boneBounds;
+	delete[] _boneMatrices;
 	delete[] _boneNames;
 	delete[] _lighting;
 	delete _center;
@@ -23,6 +23,8 @@
 #ifndef GRIM_MODELEMI_H
 #define GRIM_MODELEMI_H
 
+#include "common/array.h"
+
 #include "engines/grim/object.h"
 #include "math/matrix4.h"
 #include "math/vector2d.h"
@@ -77,6 +79,7 @@ public:
 	int _numVertices;
 	Math::Vector3d *_vertices;
 	Math::Vector3d *_drawVertices;
+	Math::AABB _drawBounds;
 	Math::Vector3d *_normals;
 	Math::Vector3d *_drawNormals;
 	Math::Vector3d *_lighting;
@@ -99,6 +102,28 @@ public:
 	Common::String *_boneNames;
 	int *_vertexBoneInfo;
 
+	// The bone infos in a form suited to skinning: the weights in their own
+	// array, and the range of bone infos of vertex i starts at
+	// _vertexSkinStart[i] and ends at _vertexSkinStart[i + 1]
+	float *_skinWeights;
+	int *_vertexSkinStart;
+	// Skeleton revision the draw vertices were computed for
+	uint32 _skinRevision;
+	// Incremented every time the draw vertices are recomputed
+	uint32 _skinCount;
+
+	// Set by the renderer in createEMIModel() when it skins the model itself.
+	// The draw vertices then stay in the bind pose, and prepareForRender()
+	// only computes the skinning matrices of the bones, stored as their first
+	// three rows, and the draw bounds from the bind pose bounds of the vertices
+	// every bone moves. _boneJoints maps the bones to the skeleton joints.
+	bool _skinnedByRenderer;
+	int *_boneJoints;
+	Math::AABB *_boneBounds;
+	float *_boneMatrices;
+	// Whether the weights of some vertex add up to less than one
+	bool _partialSkinWeights;
+
 	// Stuff we dont know how to use:
 	float _radius;
 	Math::Vector3d *_center;
@@ -112,17 +137,43 @@ public:
 
 	void *_userData;
 	bool _lightingDirty;
+	// What _lighting was last computed from, so that it is only computed again
+	// when the model, its skin or the lights changed
+	Math::Matrix4 _lightingMatrix;
+	uint32 _lightingSkinCount;
+	Common::Array<float> _lightingParams;
+	// Work space of updateLighting(), positions and normals in world space
+	// and the light accumulated so far, one array per component
+	Common::Array<float> _lightingWorkspace;
+	// The draw vertices changed since they were last handed to the renderer
+	bool _drawVerticesDirty;
 
 public:
 	EMIModel(const Common::String &filename, Common::SeekableReadStream *data, EMICostume *costume);
 	~EMIModel();
 	void setTex(uint32 index);
 	void setSkeleton(Skeleton *skel);
+	void setSkinnedByRenderer(bool skinned);
+	/**
+	 * Fill indices and weights, four per vertex, with the bones moving every
+	 * vertex, for the renderers skinning the model themselves. The unused
+	 * slots get a zero weight. Returns false if a vertex is moved by more
+	 * than four bones.
+	 */
+	bool getVertexBones(float *indices, float *weights) const;
 	void loadMesh(Common::SeekableReadStream *data);
 	void prepareForRender();
+	/**
+	 * Skin and light the model for the next draw(). Only the data of the
+	 * model itself is written, so that the models of different actors can
+	 * be prepared concurrently.
+	 */
+	void prepareDraw();
+	void updateDrawBounds();
 	void prepareTextures();
+	void updateSpecialtyTextures();
 	void draw();
-	void updateLighting(const Math::Matrix4 &modelToWorld);
+	void updateLighting(const Math::Matrix4 &modelToWorld, const Math::AABB &worldBounds);
 	void getBoundingBox(int *x1, int *y1, int *x2, int *y2) const;
 	Math::AABB calculateWorldBounds(const Math::Matrix4 &matrix) const;
 };
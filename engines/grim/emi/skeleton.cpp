@@ -34,7 +34,7 @@ namespace Grim {
 #define TRANSLATE_OP 3
 
 Skeleton::Skeleton(const Common::String &filename, Common::SeekableReadStream *data) :
-		_numJoints(0), _joints(nullptr), _animLayers(nullptr) {
+		_numJoints(0), _joints(nullptr), _animLayers(nullptr), _revision(1) {
 	loadSkeleton(data);
 }
 
@@ -82,6 +82,10 @@ void Skeleton::initBone(int index) {
 		// Might be the other way around.
 		_joints[index]._absMatrix =  _joints[index]._absMatrix * _joints[index]._relMatrix;
 	}
+
+	_joints[index]._invAbsMatrix = _joints[index]._absMatrix;
+	_joints[index]._invAbsMatrix.invertAffineOrthonormal();
+	_joints[index]._skinMatrix = _joints[index]._finalMatrix * _joints[index]._invAbsMatrix;
 }
 
 void Skeleton::initBones() {
@@ -171,16 +175,28 @@ void Skeleton::removeAnimation(AnimationStateEmi *anim) {
 }
 
 void Skeleton::commitAnim() {
+	bool changed = false;
 	for (int m = 0; m < _numJoints; ++m) {
-		const Joint *parent = getParentJoint(&_joints[m]);
+		Joint &joint = _joints[m];
+		const Joint *parent = getParentJoint(&joint);
+		Math::Matrix4 finalMatrix;
 		if (parent) {
-			_joints[m]._finalMatrix = parent->_finalMatrix * _joints[m]._animMatrix;
-			_joints[m]._finalQuat = parent->_finalQuat * _joints[m]._animQuat;
+			finalMatrix = parent->_finalMatrix * joint._animMatrix;
+			joint._finalQuat = parent->_finalQuat * joint._animQuat;
 		} else {
-			_joints[m]._finalMatrix = _joints[m]._animMatrix;
-			_joints[m]._finalQuat = _joints[m]._animQuat;
+			finalMatrix = joint._animMatrix;
+			joint._finalQuat = joint._animQuat;
+		}
+
+		if (memcmp(finalMatrix.getData(), joint._finalMatrix.getData(), 16 * sizeof(float)) != 0) {
+			joint._finalMatrix = finalMatrix;
+			joint._skinMatrix = finalMatrix * joint._invAbsMatrix;
+			changed = true;
 		}
 	}
+
+	if (changed)
+		++_revision;
 }
 
 int Skeleton::findJointIndex(const Common::String &name) const {
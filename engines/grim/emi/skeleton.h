@@ -51,6 +51,10 @@ struct Joint {
 	Math::Quaternion _animQuat;
 	Math::Matrix4 _finalMatrix;
 	Math::Quaternion _finalQuat;
+	// Inverse of _absMatrix, and _finalMatrix * _invAbsMatrix, which takes
+	// a bind pose vertex to its skinned position
+	Math::Matrix4 _invAbsMatrix;
+	Math::Matrix4 _skinMatrix;
 };
 
 struct JointAnimation {
@@ -92,8 +96,15 @@ public:
 	Joint *getParentJoint(const Joint *j) const;
 	int getJointIndex(const Joint *j) const;
 	AnimationLayer* getLayer(int priority) const;
+
+	/**
+	 * Returns a number which changes whenever commitAnim() moves a joint,
+	 * so that the skinned meshes can tell whether they are up to date.
+	 */
+	uint32 getRevision() const { return _revision; }
 private:
 	AnimationLayer *_animLayers;
+	uint32 _revision;
 	Common::List<AnimationStateEmi*> _activeAnims;
 };
 
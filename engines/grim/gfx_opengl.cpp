@@ -356,7 +356,7 @@ static void glShadowProjection(const Math::Vector3d &light, const Math::Vector3d
 }
 
 void GfxOpenGL::getBoundingBoxPos(const Mesh *model, int *x1, int *y1, int *x2, int *y2) {
-	if (_currentShadowArray) {
+	if (_currentShadowArray || !model->_bounds.isValid()) {
 		*x1 = -1;
 		*y1 = -1;
 		*x2 = -1;
@@ -369,34 +369,30 @@ void GfxOpenGL::getBoundingBoxPos(const Mesh *model, int *x1, int *y1, int *x2,
 	GLdouble left = 1000;
 	GLdouble bottom = -1000;
 
-	for (int i = 0; i < model->_numFaces; i++) {
-		Math::Vector3d obj;
-		float *pVertices;
-
-		for (int j = 0; j < model->_faces[i].getNumVertices(); j++) {
-			GLdouble modelView[16], projection[16];
-			GLint viewPort[4];
-
-			glGetDoublev(GL_MODELVIEW_MATRIX, modelView);
-			glGetDoublev(GL_PROJECTION_MATRIX, projection);
-			glGetIntegerv(GL_VIEWPORT, viewPort);
+	GLdouble modelView[16], projection[16];
+	GLint viewPort[4];
 
-			pVertices = model->_vertices + 3 * model->_faces[i].getVertex(j);
+	glGetDoublev(GL_MODELVIEW_MATRIX, modelView);
+	glGetDoublev(GL_PROJECTION_MATRIX, projection);
+	glGetIntegerv(GL_VIEWPORT, viewPort);
 
-			obj.set(*(pVertices), *(pVertices + 1), *(pVertices + 2));
+	// Projecting the corners of the cached bounds is much cheaper than
+	// projecting every vertex of every face
+	Math::Vector3d corners[8];
+	model->_bounds.getCorners(corners);
 
-			Math::Vector3d win;
-			Math::gluMathProject<GLdouble>(obj, modelView, projection, viewPort, win);
+	for (int i = 0; i < 8; i++) {
+		Math::Vector3d win;
+		Math::gluMathProject<GLdouble>(corners[i], modelView, projection, viewPort, win);
 
-			if (win.x() > right)
-				right = win.x();
-			if (win.x() < left)
-				left = win.x();
-			if (win.y() < top)
-				top = win.y();
-			if (win.y() > bottom)
-				bottom = win.y();
-		}
+		if (win.x() > right)
+			right = win.x();
+		if (win.x() < left)
+			left = win.x();
+		if (win.y() < top)
+			top = win.y();
+		if (win.y() > bottom)
+			bottom = win.y();
 	}
 
 	double t = bottom;
@@ -427,7 +423,7 @@ void GfxOpenGL::getBoundingBoxPos(const Mesh *model, int *x1, int *y1, int *x2,
 }
 
 void GfxOpenGL::getBoundingBoxPos(const EMIModel *model, int *x1, int *y1, int *x2, int *y2) {
-	if (_currentShadowArray) {
+	if (_currentShadowArray || !model->_drawBounds.isValid()) {
 		*x1 = -1;
 		*y1 = -1;
 		*x2 = -1;
@@ -447,24 +443,21 @@ void GfxOpenGL::getBoundingBoxPos(const EMIModel *model, int *x1, int *y1, int *
 	glGetDoublev(GL_PROJECTION_MATRIX, projection);
 	glGetIntegerv(GL_VIEWPORT, viewPort);
 
-	for (uint i = 0; i < model->_numFaces; i++) {
-		int *indices = (int *)model->_faces[i]._indexes;
-
-		for (uint j = 0; j < model->_faces[i]._faceLength * 3; j++) {
-			int index = indices[j];
-			Math::Vector3d obj = model->_drawVertices[index];
-			Math::Vector3d win;
-			Math::gluMathProject<GLdouble>(obj, modelView, projection, viewPort, win);
-
-			if (win.x() > right)
-				right = win.x();
-			if (win.x() < left)
-				left = win.x();
-			if (win.y() < top)
-				top = win.y();
-			if (win.y() > bottom)
-				bottom = win.y();
-		}
+	Math::Vector3d corners[8];
+	model->_drawBounds.getCorners(corners);
+
+	for (int i = 0; i < 8; i++) {
+		Math::Vector3d win;
+		Math::gluMathProject<GLdouble>(corners[i], modelView, projection, viewPort, win);
+
+		if (win.x() > right)
+			right = win.x();
+		if (win.x() < left)
+			left = win.x();
+		if (win.y() < top)
+			top = win.y();
+		if (win.y() > bottom)
+			bottom = win.y();
 	}
 	
 	double t = bottom;
@@ -502,11 +495,6 @@ void GfxOpenGL::startActorDraw(const Actor *actor) {
 	glMatrixMode(GL_MODELVIEW);
 	glPushMatrix();
 	if (_currentShadowArray) {
-		// TODO find out why shadowMask at device in woods is null
-		if (!_currentShadowArray->shadowMask) {
-			_currentShadowArray->shadowMask = new byte[_screenWidth * _screenHeight];
-			_currentShadowArray->shadowMaskSize = _screenWidth * _screenHeight;
-		}
 		Sector *shadowSector = _currentShadowArray->planeList.front().sector;
 		glEnable(GL_POLYGON_OFFSET_FILL);
 		glDisable(GL_LIGHTING);
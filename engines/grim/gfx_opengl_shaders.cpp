@@ -127,8 +127,18 @@ struct EMIModelUserData {
 	uint32 _colorMapVBO;
 	uint32 _verticesVBO;
 	uint32 _normalsVBO;
+	// Bone indices and weights, 0 if the model is skinned on the CPU
+	uint32 _bonesVBO;
 };
 
+// The most bones a model skinned by the actor shader may have. Must match
+// maxBones in emi_actor.vertex, which has to fit in the uniform space left.
+#ifdef USE_GLES2
+static const int kMaxSkinningBones = 20;
+#else
+static const int kMaxSkinningBones = 48;
+#endif
+
 struct ModelUserData {
 	Graphics::Shader *_shader;
 	uint32 _meshInfoVBO;
@@ -350,7 +360,8 @@ void GfxOpenGLS::setupShaders() {
 	_emergProgram = Graphics::Shader::fromFiles("emerg", commonAttributes);
 
 	static const char* actorAttributes[] = {"position", "texcoord", "color", "normal", NULL};
-	_actorProgram = Graphics::Shader::fromFiles(isEMI ? "emi_actor" : "grim_actor", actorAttributes);
+	static const char* emiActorAttributes[] = {"position", "texcoord", "color", "normal", "boneIndices", "boneWeights", NULL};
+	_actorProgram = Graphics::Shader::fromFiles(isEMI ? "emi_actor" : "grim_actor", isEMI ? emiActorAttributes : actorAttributes);
 	_spriteProgram = _actorProgram->clone();
 
 	if (!isEMI) {
@@ -508,12 +519,84 @@ void GfxOpenGLS::flipBuffer() {
 	g_system->updateScreen();
 }
 
+void GfxOpenGLS::projectBoundingBox(const Math::AABB &bounds, const Math::Matrix4 &mvpMatrix, double &left, double &top, double &right, double &bottom) const {
+	left = 1000;
+	top = 1000;
+	right = -1000;
+	bottom = -1000;
+
+	Math::Vector3d corners[8];
+	bounds.getCorners(corners);
+
+	for (int i = 0; i < 8; i++) {
+		Math::Vector4d v = Math::Vector4d(corners[i].x(), corners[i].y(), corners[i].z(), 1.0f);
+		v = mvpMatrix * v;
+		v /= v.w();
+
+		double winX = (1 + v.x()) / 2.0f * _gameWidth;
+		double winY = (1 + v.y()) / 2.0f * _gameHeight;
+
+		if (winX > right)
+			right = winX;
+		if (winX < left)
+			left = winX;
+		if (winY < top)
+			top = winY;
+		if (winY > bottom)
+			bottom = winY;
+	}
+}
+
 void GfxOpenGLS::getBoundingBoxPos(const Mesh *mesh, int *x1, int *y1, int *x2, int *y2) {
+	if (_currentShadowArray || !mesh->_bounds.isValid()) {
+		*x1 = -1;
+		*y1 = -1;
+		*x2 = -1;
+		*y2 = -1;
+		return;
+	}
+
+	// Rebuild the matrices the actor shader uses, see startActorDraw()
+	Math::Matrix4 modelMatrix = _currentActor->getRotationQuat().toMatrix();
+	modelMatrix.transpose();
+	modelMatrix.setPosition(_currentActor->getWorldPos());
+	modelMatrix.transpose();
+
+	Math::Matrix4 mvpMatrix = _matrixStack.top() * modelMatrix * _viewMatrix * _projMatrix;
+	mvpMatrix.transpose();
+
+	double top, right, left, bottom;
+	projectBoundingBox(mesh->_bounds, mvpMatrix, left, top, right, bottom);
+
+	double t = bottom;
+	bottom = _gameHeight - top;
+	top = _gameHeight - t;
+
+	if (left < 0)
+		left = 0;
+	if (right >= _gameWidth)
+		right = _gameWidth - 1;
+	if (top < 0)
+		top = 0;
+	if (bottom >= _gameHeight)
+		bottom = _gameHeight - 1;
+
+	if (top >= _gameHeight || left >= _gameWidth || bottom < 0 || right < 0) {
+		*x1 = -1;
+		*y1 = -1;
+		*x2 = -1;
+		*y2 = -1;
+		return;
+	}
 
+	*x1 = (int)left;
+	*y1 = (int)top;
+	*x2 = (int)right;
+	*y2 = (int)bottom;
 }
 
 void GfxOpenGLS::getBoundingBoxPos(const EMIModel *model, int *x1, int *y1, int *x2, int *y2) {
-	if (_currentShadowArray) {
+	if (_currentShadowArray || !model->_drawBounds.isValid()) {
 		*x1 = -1;
 		*y1 = -1;
 		*x2 = -1;
@@ -524,35 +607,8 @@ void GfxOpenGLS::getBoundingBoxPos(const EMIModel *model, int *x1, int *y1, int
 	Math::Matrix4 modelMatrix = _currentActor->getFinalMatrix();
 	Math::Matrix4 mvpMatrix = _mvpMatrix * modelMatrix;
 
-	double top = 1000;
-	double right = -1000;
-	double left = 1000;
-	double bottom = -1000;
-
-	for (uint i = 0; i < model->_numFaces; i++) {
-		int *indices = (int *)model->_faces[i]._indexes;
-
-		for (uint j = 0; j < model->_faces[i]._faceLength * 3; j++) {
-			int index = indices[j];
-			const Math::Vector3d &dv = model->_drawVertices[index];
-
-			Math::Vector4d v = Math::Vector4d(dv.x(), dv.y(), dv.z(), 1.0f);
-			v = mvpMatrix * v;
-			v /= v.w();
-
-			double winX = (1 + v.x()) / 2.0f * _gameWidth;
-			double winY = (1 + v.y()) / 2.0f * _gameHeight;
-
-			if (winX > right)
-				right = winX;
-			if (winX < left)
-				left = winX;
-			if (winY < top)
-				top = winY;
-			if (winY > bottom)
-				bottom = winY;
-		}
-	}
+	double top, right, left, bottom;
+	projectBoundingBox(model->_drawBounds, mvpMatrix, left, top, right, bottom);
 
 	double t = bottom;
 	bottom = _gameHeight - top;
@@ -705,6 +761,17 @@ void GfxOpenGLS::setShadow(Shadow *shadow) {
 	_currentShadowArray = shadow;
 }
 
+void GfxOpenGLS::destroyShadow(Shadow *shadow) {
+	ShadowUserData *sud = static_cast<ShadowUserData *>(shadow->userData);
+	if (sud) {
+		Graphics::Shader::freeBuffer(sud->_verticesVBO);
+		Graphics::Shader::freeBuffer(sud->_indicesVBO);
+		delete sud;
+	}
+
+	shadow->userData = nullptr;
+}
+
 void GfxOpenGLS::drawShadowPlanes() {
 	glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
 	glDepthMask(GL_FALSE);
@@ -828,6 +895,15 @@ void GfxOpenGLS::translateViewpointFinish() {
 
 void GfxOpenGLS::updateEMIModel(const EMIModel* model) {
 	const EMIModelUserData *mud = (const EMIModelUserData *)model->_userData;
+	if (mud->_bonesVBO) {
+		// The uniforms are shared by all the models, so they are set for every draw
+		if (model->_skeleton) {
+			mud->_shader->use();
+			mud->_shader->setUniform4fv("bones", 3 * model->_numBones, model->_boneMatrices);
+		}
+		return;
+	}
+
 	glBindBuffer(GL_ARRAY_BUFFER, mud->_verticesVBO);
 	glBufferSubData(GL_ARRAY_BUFFER, 0, model->_numVertices * 3 * sizeof(float), model->_drawVertices);
 	glBindBuffer(GL_ARRAY_BUFFER, mud->_normalsVBO);
@@ -837,6 +913,7 @@ void GfxOpenGLS::updateEMIModel(const EMIModel* model) {
 void GfxOpenGLS::drawEMIModelFace(const EMIModel* model, const EMIMeshFace* face) {
 	const EMIModelUserData *mud = (const EMIModelUserData *)model->_userData;
 	mud->_shader->use();
+	mud->_shader->setUniform("skinned", mud->_bonesVBO && model->_skeleton);
 	mud->_shader->setUniform("textured", face->_hasTexture ? GL_TRUE : GL_FALSE);
 	mud->_shader->setUniform("lightsEnabled", _lightsEnabled);
 	mud->_shader->setUniform("swapRandB", _selectedTexture->_colorFormat == BM_BGRA || _selectedTexture->_colorFormat == BM_BGR888);
@@ -920,6 +997,7 @@ void GfxOpenGLS::drawSprite(const Sprite *sprite) {
 	_spriteProgram->setUniform("extraMatrix", extraMatrix);
 	_spriteProgram->setUniform("textured", GL_TRUE);
 	_spriteProgram->setUniform("isBillboard", GL_TRUE);
+	_spriteProgram->setUniform("skinned", GL_FALSE);
 	_spriteProgram->setUniform("lightsEnabled", false);
 	if (sprite->_alphaTest) {
 		_spriteProgram->setUniform("alphaRef", g_grim->getGameType() == GType_MONKEY4 ? 0.1f : 0.5f);
@@ -1891,9 +1969,25 @@ void GfxOpenGLS::createSpecialtyTextures() {
 void GfxOpenGLS::createEMIModel(EMIModel *model) {
 	EMIModelUserData *mud = new EMIModelUserData;
 	model->_userData = mud;
-	mud->_verticesVBO = Graphics::Shader::createBuffer(GL_ARRAY_BUFFER, model->_numVertices * 3 * sizeof(float), model->_vertices, GL_STREAM_DRAW);
 
-	mud->_normalsVBO = Graphics::Shader::createBuffer(GL_ARRAY_BUFFER, model->_numVertices * 3 * sizeof(float), model->_normals, GL_STREAM_DRAW);
+	// Skin the model in the shader if it fits. The vertices in the bind pose
+	// are then uploaded once, together with the bones moving them.
+	Common::Array<float> bones;
+	bool skinned = model->_numBoneInfos > 0 && model->_numBones <= kMaxSkinningBones;
+	if (skinned) {
+		bones.resize(8 * model->_numVertices);
+		skinned = model->getVertexBones(&bones[0], &bones[4 * model->_numVertices]);
+	}
+	model->setSkinnedByRenderer(skinned);
+
+	GLenum usage = skinned ? GL_STATIC_DRAW : GL_STREAM_DRAW;
+	mud->_verticesVBO = Graphics::Shader::createBuffer(GL_ARRAY_BUFFER, model->_numVertices * 3 * sizeof(float), model->_vertices, usage);
+
+	mud->_normalsVBO = Graphics::Shader::createBuffer(GL_ARRAY_BUFFER, model->_numVertices * 3 * sizeof(float), model->_normals, usage);
+
+	mud->_bonesVBO = 0;
+	if (skinned)
+		mud->_bonesVBO = Graphics::Shader::createBuffer(GL_ARRAY_BUFFER, bones.size() * sizeof(float), &bones[0], GL_STATIC_DRAW);
 
 	mud->_texCoordsVBO = Graphics::Shader::createBuffer(GL_ARRAY_BUFFER, model->_numVertices * 2 * sizeof(float), model->_texVerts, GL_STATIC_DRAW);
 
@@ -1904,6 +1998,13 @@ void GfxOpenGLS::createEMIModel(EMIModel *model) {
 	actorShader->enableVertexAttribute("normal", mud->_normalsVBO, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), 0);
 	actorShader->enableVertexAttribute("texcoord", mud->_texCoordsVBO, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), 0);
 	actorShader->enableVertexAttribute("color", mud->_colorMapVBO, 4, GL_UNSIGNED_BYTE, GL_TRUE, 4 * sizeof(byte), 0);
+	if (skinned) {
+		actorShader->enableVertexAttribute("boneIndices", mud->_bonesVBO, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), 0);
+		actorShader->enableVertexAttribute("boneWeights", mud->_bonesVBO, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), 4 * model->_numVertices * sizeof(float));
+	} else {
+		actorShader->disableVertexAttribute("boneIndices", Math::Vector4d(0.0f, 0.0f, 0.0f, 0.0f));
+		actorShader->disableVertexAttribute("boneWeights", Math::Vector4d(0.0f, 0.0f, 0.0f, 0.0f));
+	}
 	mud->_shader = actorShader;
 
 	for (uint32 i = 0; i < model->_numFaces; ++i) {
@@ -1914,6 +2015,31 @@ void GfxOpenGLS::createEMIModel(EMIModel *model) {
 	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 }
 
+void GfxOpenGLS::destroyEMIModel(EMIModel *model) {
+	for (uint32 i = 0; i < model->_numFaces; ++i) {
+		EMIMeshFace *face = &model->_faces[i];
+		Graphics::Shader::freeBuffer(face->_indicesEBO);
+		face->_indicesEBO = 0;
+	}
+
+	EMIModelUserData *mud = static_cast<EMIModelUserData *>(model->_userData);
+
+	if (mud) {
+		Graphics::Shader::freeBuffer(mud->_verticesVBO);
+		Graphics::Shader::freeBuffer(mud->_normalsVBO);
+		Graphics::Shader::freeBuffer(mud->_texCoordsVBO);
+		Graphics::Shader::freeBuffer(mud->_colorMapVBO);
+		if (mud->_bonesVBO)
+			Graphics::Shader::freeBuffer(mud->_bonesVBO);
+
+		delete mud->_shader;
+		delete mud;
+	}
+
+	model->_userData = nullptr;
+	model->setSkinnedByRenderer(false);
+}
+
 void GfxOpenGLS::createMesh(Mesh *mesh) {
 	Common::Array<GrimVertex> meshInfo;
 	meshInfo.reserve(mesh->_numVertices * 5);
@@ -1967,12 +2093,14 @@ void GfxOpenGLS::destroyMesh(const Mesh *mesh) {
 		if (face->_userData) {
 			uint32 *data = static_cast<uint32 *>(face->_userData);
 			delete data;
+			face->_userData = nullptr;
 		}
 	}
 
 	if (!mud)
 		return;
 
+	Graphics::Shader::freeBuffer(mud->_meshInfoVBO);
 	delete mud->_shader;
 	delete mud;
 }
@@ -26,6 +26,7 @@
 #include "engines/grim/actor.h"
 #include "engines/grim/gfx_base.h"
 #include "graphics/opengles2/shader.h"
+#include "math/aabb.h"
 #include "common/stack.h"
 
 namespace Grim {
@@ -71,6 +72,7 @@ public:
 
 	virtual void finishActorDraw() override;
 	virtual void setShadow(Shadow *shadow) override;
+	virtual void destroyShadow(Shadow *shadow) override;
 	virtual void drawShadowPlanes() override;
 	virtual void setShadowMode() override;
 	virtual void clearShadowMode() override;
@@ -203,6 +205,7 @@ public:
 	virtual void createMesh(Mesh *mesh) override;
 	virtual void destroyMesh(const Mesh *mesh) override;
 	virtual void createEMIModel(EMIModel *model) override;
+	virtual void destroyEMIModel(EMIModel *model) override;
 	virtual void updateEMIModel(const EMIModel* model) override;
 
 protected:
@@ -238,6 +241,7 @@ private:
 
 	void setupZBuffer();
 	void drawDepthBitmap(int x, int y, int w, int h, char *data);
+	void projectBoundingBox(const Math::AABB &bounds, const Math::Matrix4 &mvpMatrix, double &left, double &top, double &right, double &bottom) const;
 
 	float _fov;
 	float _nclip;
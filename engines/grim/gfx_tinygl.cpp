@@ -20,6 +20,8 @@
  *
  */
 
+#include "common/array.h"
+#include "common/config-manager.h"
 #include "common/endian.h"
 #include "common/system.h"
 
@@ -30,6 +32,7 @@
 
 #include "engines/grim/actor.h"
 #include "engines/grim/colormap.h"
+#include "engines/grim/debug.h"
 #include "engines/grim/material.h"
 #include "engines/grim/font.h"
 #include "engines/grim/gfx_tinygl.h"
@@ -43,90 +46,98 @@
 
 namespace Grim {
 
+// Memory kept for the converted depth bitmaps of destroyed bitmaps
+static const uint32 kZBitmapCacheSize = 16 * 1024 * 1024;
+
 /**
  * This class is used for blitting bitmaps with transparent pixels.
- * Instead of checking every pixel for transparency, it creates a list of 'lines'.
- * A line is, well, a line of non trasparent pixels, and itstores a pointer to the
- * first pixel, and the position of it, which can be used to memcpy the entire line
- * to the destination buffer.
+ * Instead of checking every pixel for transparency, it stores the runs of non
+ * transparent pixels of every row, which can be memcpy'd to the destination
+ * buffer. The runs are packed in one array, and a row table gives the first
+ * run of every row, so that clipped blits start directly at the first visible row.
  */
 class BlitImage {
 public:
 	BlitImage() {
-		_lines = nullptr;
-		_last = nullptr;
 		_width = 0;
 		_height = 0;
 	}
-	~BlitImage() {
-		Line *temp = _lines;
-		while (temp != nullptr) {
-			_lines = temp->next;
-			delete temp;
-			temp = _lines;
-		}
-	}
+
 	void create(const Graphics::PixelBuffer &buf, uint32 transparency, int x, int y, int width, int height) {
 		Graphics::PixelBuffer srcBuf = buf;
 		_width = width;
 		_height = height;
-		// A line of pixels can not wrap more that one line of the image, since it would break
+		_spans.clear();
+		_rows.resize(height + 1);
+		// A run of pixels can not wrap more that one line of the image, since it would break
 		// blitting of bitmaps with a non-zero x position.
 		for (int l = 0; l < height; l++) {
+			_rows[l] = _spans.size();
 			int start = -1;
 
 			for (int r = 0; r < width; ++r) {
-				// We found a transparent pixel, so save a line from 'start' to the pixel before this.
+				// We found a transparent pixel, so save a run from 'start' to the pixel before this.
 				if (srcBuf.getValueAt(r) == transparency && start >= 0) {
-					newLine(start, l, r - start, srcBuf.getRawBuffer(start));
+					newSpan(start, r - start);
 
 					start = -1;
 				} else if (srcBuf.getValueAt(r) != transparency && start == -1) {
 					start = r;
 				}
 			}
-			// end of the bitmap line. if start is an actual pixel save the line.
+			// end of the bitmap line. if start is an actual pixel save the run.
 			if (start >= 0) {
-				newLine(start, l, width - start, srcBuf.getRawBuffer(start));
+				newSpan(start, width - start);
 			}
 
 			srcBuf.shiftBy(width);
 		}
+		_rows[height] = _spans.size();
 	}
 
-	void newLine(int x, int y, int length, byte *pixels) {
-		if (length < 1) {
-			return;
-		}
-
-		Line *line = new Line;
-
-		line->x = x;
-		line->y = y;
-		line->length = length;
-		line->pixels = pixels;
-		line->next = nullptr;
-
-		if (_last) {
-			_last->next = line;
-		}
-		if (!_lines) {
-			_lines = line;
+	/**
+	 * Copy the non transparent pixels of the rectangle at srcX, srcY of the
+	 * image. src and dst point to the top left pixel of the rectangle in the
+	 * source and destination buffers, and the pitches are in pixels.
+	 */
+	void copySpans(byte *dst, int dstPitch, const byte *src, int srcPitch, int srcX, int srcY,
+	               int width, int height, int bytesPerPixel) const {
+		int maxX = srcX + width;
+		int maxY = MIN(srcY + height, _height);
+		for (int y = MAX(srcY, 0); y < maxY; y++) {
+			byte *dstRow = dst + (y - srcY) * dstPitch * bytesPerPixel;
+			const byte *srcRow = src + (y - srcY) * srcPitch * bytesPerPixel;
+			for (uint32 i = _rows[y]; i < _rows[y + 1]; i++) {
+				int x0 = MAX<int>(_spans[i].x, srcX);
+				int x1 = MIN<int>(_spans[i].x + _spans[i].length, maxX);
+				if (x0 >= x1)
+					continue;
+				int offset = (x0 - srcX) * bytesPerPixel;
+				memcpy(dstRow + offset, srcRow + offset, (x1 - x0) * bytesPerPixel);
+			}
 		}
-		_last = line;
 	}
 
-	struct Line {
-		int x;
-		int y;
-		int length;
-		byte *pixels;
-
-		Line *next;
+	struct Span {
+		uint16 x;
+		uint16 length;
 	};
-	Line *_lines;
-	Line *_last;
+	// Index in _spans of the first run of every row, and one past the last one
+	Common::Array<uint32> _rows;
+	Common::Array<Span> _spans;
 	int _width, _height;
+
+private:
+	void newSpan(int x, int length) {
+		if (length < 1) {
+			return;
+		}
+
+		Span span;
+		span.x = x;
+		span.length = length;
+		_spans.push_back(span);
+	}
 };
 
 GfxBase *CreateGfxTinyGL() {
@@ -134,8 +145,8 @@ GfxBase *CreateGfxTinyGL() {
 }
 
 GfxTinyGL::GfxTinyGL() :
-		_smushWidth(0), _smushHeight(0), _zb(nullptr), _alpha(1.f),
-		_bufferId(0), _currentActor(nullptr) {
+		_smushWidth(0), _smushHeight(0), _zb(nullptr), _context(nullptr), _alpha(1.f),
+		_bufferId(0), _currentActor(nullptr), _zBitmapLUT(nullptr), _zBitmapCacheSize(0) {
 	g_driver = this;
 	_storedDisplay = nullptr;
 	// TGL_LEQUAL as tglDepthFunc ensures that subsequent drawing attempts for
@@ -147,9 +158,14 @@ GfxTinyGL::GfxTinyGL() :
 }
 
 GfxTinyGL::~GfxTinyGL() {
+	for (Common::List<ZBitmapCacheEntry>::iterator i = _zBitmapCache.begin(); i != _zBitmapCache.end(); ++i) {
+		for (uint j = 0; j < i->images.size(); j++)
+			delete[] i->images[j];
+	}
+	delete[] _zBitmapLUT;
 	if (_zb) {
 		delBuffer(1);
-		TinyGL::glClose();
+		TinyGL::destroyContext(_context);
 		delete _zb;
 	}
 }
@@ -171,7 +187,11 @@ byte *GfxTinyGL::setupScreen(int screenW, int screenH, bool fullscreen) {
 
 	_pixelFormat = buf.getFormat();
 	_zb = new TinyGL::FrameBuffer(screenW, screenH, buf);
-	TinyGL::glInit(_zb, 256);
+	_context = TinyGL::createContext(_zb, 256);
+	TinyGL::setCurrentContext(_context);
+	if (ConfMan.getInt("tinygl_threads") != 0)
+		_zb->enableTiledRasterization(true, ConfMan.getInt("tinygl_threads"));
+	_zb->enableDirtyRects(true);
 
 	_storedDisplay.create(_pixelFormat, _gameWidth * _gameHeight, DisposeAfterUse::YES);
 	_storedDisplay.clear(_gameWidth * _gameHeight);
@@ -258,11 +278,22 @@ void GfxTinyGL::clearScreen() {
 }
 
 void GfxTinyGL::clearDepthBuffer() {
+	tglFlush();
 	memset(_zb->zbuf, 0, _gameWidth * _gameHeight * sizeof(uint32));
+	_zb->invalidateDepthBlocks();
 }
 
 void GfxTinyGL::flipBuffer() {
-	g_system->updateScreen();
+	tglFlush();
+	// Only present the parts of the screen which changed since the last frame
+	Common::List<Common::Rect> dirtyRects;
+	_zb->getDirtyRects(dirtyRects);
+	g_system->updateScreenRects(dirtyRects);
+
+	uint32 culledSpans, culledPixels;
+	_zb->getCullingCounters(culledSpans, culledPixels);
+	_zb->resetCullingCounters();
+	Debug::debug(Debug::Engine, "GfxTinyGL: skipped %u hidden spans (%u pixels)", culledSpans, culledPixels);
 }
 
 int GfxTinyGL::genBuffer() {
@@ -371,7 +402,7 @@ static void tglShadowProjection(const Math::Vector3d &light, const Math::Vector3
 }
 
 void GfxTinyGL::getBoundingBoxPos(const Mesh *model, int *x1, int *y1, int *x2, int *y2) {
-	if (_currentShadowArray) {
+	if (_currentShadowArray || !model->_bounds.isValid()) {
 		*x1 = -1;
 		*y1 = -1;
 		*x2 = -1;
@@ -384,34 +415,30 @@ void GfxTinyGL::getBoundingBoxPos(const Mesh *model, int *x1, int *y1, int *x2,
 	TGLfloat left = 1000;
 	TGLfloat bottom = -1000;
 
-	for (int i = 0; i < model->_numFaces; i++) {
-		Math::Vector3d obj;
-		float *pVertices;
-
-		for (int j = 0; j < model->_faces[i].getNumVertices(); j++) {
-			TGLfloat modelView[16], projection[16];
-			TGLint viewPort[4];
-
-			tglGetFloatv(TGL_MODELVIEW_MATRIX, modelView);
-			tglGetFloatv(TGL_PROJECTION_MATRIX, projection);
-			tglGetIntegerv(TGL_VIEWPORT, viewPort);
-
-			pVertices = model->_vertices + 3 * model->_faces[i].getVertex(j);
-
-			obj.set(*(pVertices), *(pVertices + 1), *(pVertices + 2));
+	TGLfloat modelView[16], projection[16];
+	TGLint viewPort[4];
 
-			Math::Vector3d win;
-			Math::gluMathProject<TGLfloat>(obj, modelView, projection, viewPort, win);
+	tglGetFloatv(TGL_MODELVIEW_MATRIX, modelView);
+	tglGetFloatv(TGL_PROJECTION_MATRIX, projection);
+	tglGetIntegerv(TGL_VIEWPORT, viewPort);
 
-			if (win.x() > right)
-				right = win.x();
-			if (win.x() < left)
-				left = win.x();
-			if (win.y() < top)
-				top = win.y();
-			if (win.y() > bottom)
-				bottom = win.y();
-		}
+	// Projecting the corners of the cached bounds is much cheaper than
+	// projecting every vertex of every face
+	Math::Vector3d corners[8];
+	model->_bounds.getCorners(corners);
+
+	for (int i = 0; i < 8; i++) {
+		Math::Vector3d win;
+		Math::gluMathProject<TGLfloat>(corners[i], modelView, projection, viewPort, win);
+
+		if (win.x() > right)
+			right = win.x();
+		if (win.x() < left)
+			left = win.x();
+		if (win.y() < top)
+			top = win.y();
+		if (win.y() > bottom)
+			bottom = win.y();
 	}
 
 	float t = bottom;
@@ -442,7 +469,7 @@ void GfxTinyGL::getBoundingBoxPos(const Mesh *model, int *x1, int *y1, int *x2,
 }
 
 void GfxTinyGL::getBoundingBoxPos(const EMIModel *model, int *x1, int *y1, int *x2, int *y2) {
-	if (_currentShadowArray) {
+	if (_currentShadowArray || !model->_drawBounds.isValid()) {
 		*x1 = -1;
 		*y1 = -1;
 		*x2 = -1;
@@ -462,25 +489,21 @@ void GfxTinyGL::getBoundingBoxPos(const EMIModel *model, int *x1, int *y1, int *
 	tglGetFloatv(TGL_PROJECTION_MATRIX, projection);
 	tglGetIntegerv(TGL_VIEWPORT, viewPort);
 
-	for (uint i = 0; i < model->_numFaces; i++) {
-		int *indices = (int *)model->_faces[i]._indexes;
-		
-		for (uint j = 0; j < model->_faces[i]._faceLength * 3; j++) {
-			int index = indices[j];
-
-			Math::Vector3d obj = model->_drawVertices[index];
-			Math::Vector3d win;
-			Math::gluMathProject<TGLfloat>(obj, modelView, projection, viewPort, win);
-
-			if (win.x() > right)
-				right = win.x();
-			if (win.x() < left)
-				left = win.x();
-			if (win.y() < top)
-				top = win.y();
-			if (win.y() > bottom)
-				bottom = win.y();
-		}
+	Math::Vector3d corners[8];
+	model->_drawBounds.getCorners(corners);
+
+	for (int i = 0; i < 8; i++) {
+		Math::Vector3d win;
+		Math::gluMathProject<TGLfloat>(corners[i], modelView, projection, viewPort, win);
+
+		if (win.x() > right)
+			right = win.x();
+		if (win.x() < left)
+			left = win.x();
+		if (win.y() < top)
+			top = win.y();
+		if (win.y() > bottom)
+			bottom = win.y();
 	}
 
 	float t = bottom;
@@ -518,11 +541,10 @@ void GfxTinyGL::startActorDraw(const Actor *actor) {
 	tglMatrixMode(TGL_MODELVIEW);
 	tglPushMatrix();
 	if (_currentShadowArray) {
-		// TODO find out why shadowMask at device in woods is null
-		if (!_currentShadowArray->shadowMask) {
-			_currentShadowArray->shadowMask = new byte[_gameWidth * _gameHeight];
-			_currentShadowArray->shadowMaskSize = _gameWidth * _gameHeight;
-		}
+		// The mask may not have been drawn yet, e.g. at the device in the woods,
+		// if the shadow was activated after the last refresh
+		if (!_currentShadowArray->shadowMask)
+			drawShadowPlanes();
 		assert(_currentShadowArray->shadowMask);
 		//tglSetShadowColor(255, 255, 255);
 		tglSetShadowColor(_shadowColorR, _shadowColorG, _shadowColorB);
@@ -610,15 +632,26 @@ void GfxTinyGL::finishActorDraw() {
 }
 
 void GfxTinyGL::drawShadowPlanes() {
-	tglEnable(TGL_SHADOW_MASK_MODE);
-	if (!_currentShadowArray->shadowMask) {
-		_currentShadowArray->shadowMask = new byte[_gameWidth * _gameHeight];
-		_currentShadowArray->shadowMaskSize = _gameWidth * _gameHeight;
+	// The mask only depends on the shadow planes and the camera, so it is drawn
+	// once for every setup. Actor::addShadowPlane() discards the masks.
+	const Set *set = g_grim->getCurrSet();
+	Common::String key = Common::String::format("%s/%d", set->getName().c_str(), set->getSetup());
+	byte *mask = _currentShadowArray->shadowMasks.getVal(key, nullptr);
+	const int maskSize = ((_gameWidth + 7) / 8) * _gameHeight;
+	if (mask) {
+		_currentShadowArray->shadowMask = mask;
+		_currentShadowArray->shadowMaskSize = maskSize;
+		return;
 	}
-	memset(_currentShadowArray->shadowMask, 0, _gameWidth * _gameHeight);
 
-	tglSetShadowMaskBuf(_currentShadowArray->shadowMask);
-	_currentShadowArray->planeList.begin();
+	mask = new byte[maskSize];
+	memset(mask, 0, maskSize);
+	_currentShadowArray->shadowMasks[key] = mask;
+	_currentShadowArray->shadowMask = mask;
+	_currentShadowArray->shadowMaskSize = maskSize;
+
+	tglEnable(TGL_SHADOW_MASK_MODE);
+	tglSetShadowMaskBuf(mask);
 	for (SectorListType::iterator i = _currentShadowArray->planeList.begin(); i != _currentShadowArray->planeList.end(); ++i) {
 		Sector *shadowSector = i->sector;
 		tglBegin(TGL_POLYGON);
@@ -678,28 +711,41 @@ void GfxTinyGL::drawEMIModelFace(const EMIModel *model, const EMIMeshFace *face)
 	else
 		tglDisable(TGL_TEXTURE_2D);
 
-	tglBegin(TGL_TRIANGLES);
+	// Only the colors of the vertices used by this face are computed, the
+	// other entries of the array are never read
+	_colorArray.resize(model->_numVertices * 4);
 	float dim = 1.0f - _dimLevel;
 	for (uint j = 0; j < face->_faceLength * 3; j++) {
 		int index = indices[j];
-		if (face->_hasTexture) {
-			tglTexCoord2f(model->_texVerts[index].getX(), model->_texVerts[index].getY());
-		}
-
 		Math::Vector3d lighting = model->_lighting[index];
 		byte r = (byte)(model->_colorMap[index].r * lighting.x() * dim);
 		byte g = (byte)(model->_colorMap[index].g * lighting.y() * dim);
 		byte b = (byte)(model->_colorMap[index].b * lighting.z() * dim);
 		byte a = (int)(model->_colorMap[index].a * _alpha);
-		tglColor4ub(r, g, b, a);
-
-		Math::Vector3d normal = model->_normals[index];
-		Math::Vector3d vertex = model->_drawVertices[index];
+		float *color = &_colorArray[index * 4];
+		color[0] = r / 255.0f;
+		color[1] = g / 255.0f;
+		color[2] = b / 255.0f;
+		color[3] = a / 255.0f;
+	}
 
-		tglNormal3fv(normal.getData());
-		tglVertex3fv(vertex.getData());
+	tglEnableClientState(TGL_VERTEX_ARRAY);
+	tglEnableClientState(TGL_NORMAL_ARRAY);
+	tglEnableClientState(TGL_COLOR_ARRAY);
+	tglVertexPointer(3, TGL_FLOAT, 0, model->_drawVertices);
+	tglNormalPointer(TGL_FLOAT, 0, model->_normals);
+	tglColorPointer(4, TGL_FLOAT, 0, _colorArray.begin());
+	if (face->_hasTexture) {
+		tglEnableClientState(TGL_TEXTURE_COORD_ARRAY);
+		tglTexCoordPointer(2, TGL_FLOAT, 0, model->_texVerts);
 	}
-	tglEnd();
+
+	tglDrawElements(TGL_TRIANGLES, face->_faceLength * 3, TGL_UNSIGNED_INT, indices);
+
+	tglDisableClientState(TGL_VERTEX_ARRAY);
+	tglDisableClientState(TGL_NORMAL_ARRAY);
+	tglDisableClientState(TGL_COLOR_ARRAY);
+	tglDisableClientState(TGL_TEXTURE_COORD_ARRAY);
 
 	tglEnable(TGL_TEXTURE_2D);
 	tglEnable(TGL_DEPTH_TEST);
@@ -710,22 +756,152 @@ void GfxTinyGL::drawEMIModelFace(const EMIModel *model, const EMIMeshFace *face)
 	tglColor3f(1.0f, 1.0f, 1.0f);
 }
 
+// Vertex arrays of a Grim mesh. A face uses separate indices for its
+// positions and texture coordinates, so every distinct pair of them becomes
+// one vertex, shared by all the faces using it.
+struct MeshUserData {
+	Common::Array<float> _vertices;
+	Common::Array<float> _normals;
+	Common::Array<float> _texCoords;
+	Common::Array<uint32> _indices;
+	// First index of each face, the faces are triangulated in order
+	Common::Array<uint32> _faceStart;
+};
+
+void GfxTinyGL::createMesh(Mesh *mesh) {
+	MeshUserData *mud = new MeshUserData;
+	mesh->_userData = mud;
+
+	Common::HashMap<uint32, uint32> vertexIds;
+	Common::Array<uint32> ids;
+	const uint32 numTexIds = mesh->_numTextureVerts + 1;
+	mud->_faceStart.resize(mesh->_numFaces + 1);
+	for (int i = 0; i < mesh->_numFaces; ++i) {
+		const MeshFace *face = &mesh->_faces[i];
+		int numVertices = face->getNumVertices();
+		mud->_faceStart[i] = mud->_indices.size();
+
+		ids.resize(numVertices);
+		for (int j = 0; j < numVertices; ++j) {
+			int vertex = face->getVertex(j);
+			int texVertex = face->hasTexture() ? face->getTextureVertex(j) : -1;
+			uint32 key = vertex * numTexIds + (texVertex + 1);
+
+			Common::HashMap<uint32, uint32>::const_iterator it = vertexIds.find(key);
+			if (it != vertexIds.end()) {
+				ids[j] = it->_value;
+				continue;
+			}
+
+			uint32 id = mud->_vertices.size() / 3;
+			vertexIds[key] = id;
+			ids[j] = id;
+			for (int k = 0; k < 3; ++k) {
+				mud->_vertices.push_back(mesh->_vertices[3 * vertex + k]);
+				mud->_normals.push_back(mesh->_vertNormals[3 * vertex + k]);
+			}
+			for (int k = 0; k < 2; ++k) {
+				mud->_texCoords.push_back(texVertex >= 0 ? mesh->_textureVerts[2 * texVertex + k] : 0.0f);
+			}
+		}
+
+		// Same triangles, in the same order, as TGL_POLYGON
+		for (int j = numVertices - 1; j >= 2; --j) {
+			mud->_indices.push_back(ids[j]);
+			mud->_indices.push_back(ids[0]);
+			mud->_indices.push_back(ids[j - 1]);
+		}
+	}
+	mud->_faceStart[mesh->_numFaces] = mud->_indices.size();
+}
+
+void GfxTinyGL::destroyMesh(const Mesh *mesh) {
+	delete static_cast<MeshUserData *>(mesh->_userData);
+}
+
+void GfxTinyGL::drawMesh(const Mesh *mesh) {
+	const MeshUserData *mud = static_cast<const MeshUserData *>(mesh->_userData);
+	if (!mud) {
+		GfxBase::drawMesh(mesh);
+		return;
+	}
+
+	tglColor4f(1.0f, 1.0f, 1.0f, _alpha);
+	tglEnableClientState(TGL_VERTEX_ARRAY);
+	tglEnableClientState(TGL_NORMAL_ARRAY);
+	tglVertexPointer(3, TGL_FLOAT, 0, mud->_vertices.begin());
+	tglNormalPointer(TGL_FLOAT, 0, mud->_normals.begin());
+	tglTexCoordPointer(2, TGL_FLOAT, 0, mud->_texCoords.begin());
+
+	// Draw the runs of faces which share the same state in one call
+	for (int i = 0; i < mesh->_numFaces;) {
+		const MeshFace *face = &mesh->_faces[i];
+		int end = i + 1;
+		for (; end < mesh->_numFaces; ++end) {
+			const MeshFace *next = &mesh->_faces[end];
+			if (next->getMaterial() != face->getMaterial() || next->hasTexture() != face->hasTexture() ||
+					(next->getLight() == 0) != (face->getLight() == 0))
+				break;
+		}
+
+		bool unlit = face->getLight() == 0 && !isShadowModeActive();
+		if (unlit)
+			disableLights();
+
+		face->getMaterial()->select();
+		if (face->hasTexture())
+			tglEnableClientState(TGL_TEXTURE_COORD_ARRAY);
+		else
+			tglDisableClientState(TGL_TEXTURE_COORD_ARRAY);
+
+		uint32 first = mud->_faceStart[i];
+		uint32 count = mud->_faceStart[end] - first;
+		if (count > 0)
+			tglDrawElements(TGL_TRIANGLES, count, TGL_UNSIGNED_INT, &mud->_indices[first]);
+
+		if (unlit)
+			enableLights();
+		i = end;
+	}
+
+	tglDisableClientState(TGL_VERTEX_ARRAY);
+	tglDisableClientState(TGL_NORMAL_ARRAY);
+	tglDisableClientState(TGL_TEXTURE_COORD_ARRAY);
+}
+
 void GfxTinyGL::drawModelFace(const Mesh *mesh, const MeshFace *face) {
 	float *vertices = mesh->_vertices;
 	float *vertNormals = mesh->_vertNormals;
 	float *textureVerts = mesh->_textureVerts;
-	tglNormal3fv(const_cast<float *>(face->getNormal().getData()));
-	tglBegin(TGL_POLYGON);
-	for (int i = 0; i < face->getNumVertices(); i++) {
-		tglNormal3fv(vertNormals + 3 * face->getVertex(i));
-
+	int numVertices = face->getNumVertices();
+
+	// The texture coordinates have their own indices, so gather the face
+	// vertices into contiguous arrays
+	_vertexArray.resize(numVertices * 3);
+	_normalArray.resize(numVertices * 3);
+	_texCoordArray.resize(numVertices * 2);
+	for (int i = 0; i < numVertices; i++) {
+		memcpy(&_vertexArray[i * 3], vertices + 3 * face->getVertex(i), 3 * sizeof(float));
+		memcpy(&_normalArray[i * 3], vertNormals + 3 * face->getVertex(i), 3 * sizeof(float));
 		if (face->hasTexture())
-			tglTexCoord2fv(textureVerts + 2 * face->getTextureVertex(i));
+			memcpy(&_texCoordArray[i * 2], textureVerts + 2 * face->getTextureVertex(i), 2 * sizeof(float));
+	}
 
-		tglColor4f(1.0f, 1.0f, 1.0f, _alpha);
-		tglVertex3fv(vertices + 3 * face->getVertex(i));
+	tglColor4f(1.0f, 1.0f, 1.0f, _alpha);
+	tglEnableClientState(TGL_VERTEX_ARRAY);
+	tglEnableClientState(TGL_NORMAL_ARRAY);
+	tglVertexPointer(3, TGL_FLOAT, 0, _vertexArray.begin());
+	tglNormalPointer(TGL_FLOAT, 0, _normalArray.begin());
+	if (face->hasTexture()) {
+		tglEnableClientState(TGL_TEXTURE_COORD_ARRAY);
+		tglTexCoordPointer(2, TGL_FLOAT, 0, _texCoordArray.begin());
 	}
-	tglEnd();
+
+	tglDrawArrays(TGL_POLYGON, 0, numVertices);
+
+	tglDisableClientState(TGL_VERTEX_ARRAY);
+	tglDisableClientState(TGL_NORMAL_ARRAY);
+	tglDisableClientState(TGL_TEXTURE_COORD_ARRAY);
 }
 
 void GfxTinyGL::drawSprite(const Sprite *sprite) {
@@ -925,19 +1101,28 @@ void GfxTinyGL::createBitmap(BitmapData *bitmap) {
 		bitmap->convertToColorFormat(_pixelFormat);
 	}
 	if (bitmap->_format != 1) {
+		Common::Array<uint32 *> images;
+		bool cached = takeCachedZBitmap(bitmap, images);
+		if (!cached && !_zBitmapLUT) {
+			_zBitmapLUT = new uint32[0x10000];
+			for (uint32 val = 0; val < 0x10000; val++) {
+				_zBitmapLUT[val] = val * 0x10000 / 100 / (0x10000 - val) << 14;
+			}
+			// fix the value if it is incorrectly set to the bitmap transparency color
+			_zBitmapLUT[0xf81f] = _zBitmapLUT[0];
+		}
+
 		for (int pic = 0; pic < bitmap->_numImages; pic++) {
-			uint32 *buf = new uint32[bitmap->_width * bitmap->_height];
 			uint16 *bufPtr = reinterpret_cast<uint16 *>(bitmap->getImageData(pic).getRawBuffer());
-			for (int i = 0; i < (bitmap->_width * bitmap->_height); i++) {
-				uint16 val = READ_LE_UINT16(bufPtr + i);
-				// fix the value if it is incorrectly set to the bitmap transparency color
-				if (val == 0xf81f) {
-					val = 0;
+			if (!cached) {
+				uint32 *buf = new uint32[bitmap->_width * bitmap->_height];
+				for (int i = 0; i < (bitmap->_width * bitmap->_height); i++) {
+					buf[i] = _zBitmapLUT[READ_LE_UINT16(bufPtr + i)];
 				}
-				buf[i] = ((uint32)val) * 0x10000 / 100 / (0x10000 - val) << 14;
+				images.push_back(buf);
 			}
 			delete[] bufPtr;
-			bitmap->_data[pic] = Graphics::PixelBuffer(Graphics::PixelFormat(4, 8, 8, 8, 8, 0, 8, 16, 24), (byte *)buf);
+			bitmap->_data[pic] = Graphics::PixelBuffer(Graphics::PixelFormat(4, 8, 8, 8, 8, 0, 8, 16, 24), (byte *)images[pic]);
 		}
 	} else {
 		BlitImage *imgs = new BlitImage[bitmap->_numImages];
@@ -1023,24 +1208,7 @@ void GfxTinyGL::blit(const Graphics::PixelFormat &format, BlitImage *image, byte
 		}
 	} else {
 		if (image) {
-			BlitImage::Line *l = image->_lines;
-			int maxY = srcY + clampHeight;
-			int maxX = srcX + clampWidth;
-			while (l && l->y < srcY)
-				l = l->next;
-
-			while (l && l->y < maxY) {
-				if (l->x < maxX && l->x + l->length > srcX) {
-					int length = l->length;
-					int skipStart = (l->x < srcX) ? (srcX - l->x) : 0;
-					length -= skipStart;
-					int skipEnd   = (l->x + l->length > maxX) ? (l->x + l->length - maxX) : 0;
-					length -= skipEnd;
-					memcpy(dstBuf.getRawBuffer((l->y - srcY) * _gameWidth + MAX(l->x - srcX, 0)),
-						   l->pixels + skipStart * format.bytesPerPixel, length * format.bytesPerPixel);
-				}
-				l = l->next;
-			}
+			image->copySpans(dst, _gameWidth, src, srcWidth, srcX, srcY, clampWidth, clampHeight, format.bytesPerPixel);
 		} else {
 			for (int l = 0; l < clampHeight; l++) {
 				for (int r = 0; r < clampWidth; ++r) {
@@ -1055,10 +1223,19 @@ void GfxTinyGL::blit(const Graphics::PixelFormat &format, BlitImage *image, byte
 	}
 }
 
+// Whether the pixel has the color used for the transparent parts of bitmaps
+static bool isTransparentPixel(const Graphics::PixelBuffer &buf, int pixel) {
+	byte a, r, g, b;
+	buf.getARGBAt(pixel, a, r, g, b);
+	return r == 248 && g == 0 && b == 248;
+}
+
 void GfxTinyGL::blitScreen(const Graphics::PixelFormat &format, BlitImage *image, byte *src, int dstX, int dstY, int srcX, int srcY, int width, int height, int srcWidth, int srcHeight, bool trans, bool dimSprites) {
 	if (dstX >= _gameWidth || dstY >= _gameHeight)
 		return;
 
+	tglFlush();
+
 	int clampWidth, clampHeight;
 
 	if (dstX + width > _gameWidth)
@@ -1090,24 +1267,7 @@ void GfxTinyGL::blitScreen(const Graphics::PixelFormat &format, BlitImage *image
 			}
 		} else {
 			if (image) {
-				BlitImage::Line *l = image->_lines;
-				int maxY = srcY + clampHeight;
-				int maxX = srcX + clampWidth;
-				while (l && l->y < srcY) {
-					l = l->next;
-				}
-				while (l && l->y < maxY) {
-					if (l->x < maxX && l->x + l->length > srcX) {
-						int length = l->length;
-						int skipStart = (l->x < srcX) ? (srcX - l->x) : 0;
-						length -= skipStart;
-						int skipEnd   = (l->x + l->length > maxX) ? (l->x + l->length - maxX) : 0;
-						length -= skipEnd;
-						memcpy(dstBuf.getRawBuffer((l->y - srcY) * _gameWidth + MAX(l->x - srcX, 0)),
-							l->pixels + skipStart * format.bytesPerPixel, length * format.bytesPerPixel);
-					}
-					l = l->next;
-				}
+				image->copySpans(dst, _gameWidth, src, srcWidth, srcX, srcY, clampWidth, clampHeight, format.bytesPerPixel);
 			} else {
 				for (int l = 0; l < clampHeight; l++) {
 					for (int r = 0; r < clampWidth; ++r) {
@@ -1120,21 +1280,49 @@ void GfxTinyGL::blitScreen(const Graphics::PixelFormat &format, BlitImage *image
 				}
 			}
 		}
+		_zb->addDirtyRect(Common::Rect(dstX, dstY, dstX + clampWidth, dstY + clampHeight));
 	} else {
 		float colFactor = 1.0f - _dimLevel;
 		if (dimSprites == false) {
 			colFactor = 1.0f;
 		}
-		for (int l = 0; l < clampHeight; l++) {
-			for (int r = 0; r < clampWidth; ++r) {
-				byte aDst, rDst, gDst, bDst;
-				srcBuf.getARGBAt(r, aDst, rDst, gDst, bDst);
-				if (rDst == 248 && gDst == 0 && bDst == 248) 
-					continue;
-				_zb->writePixel((dstX + r) + (dstY + l) * _gameWidth, aDst, rDst * colFactor, gDst * colFactor, bDst * colFactor);
+		byte dim[256];
+		for (int i = 0; i < 256; i++) {
+			dim[i] = (byte)(i * colFactor);
+		}
+
+		if (image) {
+			int maxX = srcX + clampWidth;
+			int maxY = MIN(srcY + clampHeight, image->_height);
+			for (int y = MAX(srcY, 0); y < maxY; y++) {
+				int dstPixel = dstX - srcX + (dstY + y - srcY) * _gameWidth;
+				int srcPixel = -srcX + (y - srcY) * srcWidth;
+				for (uint32 i = image->_rows[y]; i < image->_rows[y + 1]; i++) {
+					const BlitImage::Span &span = image->_spans[i];
+					int x0 = MAX<int>(span.x, srcX);
+					int x1 = MIN<int>(span.x + span.length, maxX);
+					if (x0 < x1)
+						_zb->writeSpan(dstPixel + x0, srcBuf, srcPixel + x0, x1 - x0, dim);
+				}
+			}
+		} else {
+			// Write the runs between the pixels of the transparent color
+			for (int l = 0; l < clampHeight; l++) {
+				int dstPixel = dstX + (dstY + l) * _gameWidth;
+				int r = 0;
+				while (r < clampWidth) {
+					while (r < clampWidth && isTransparentPixel(srcBuf, r))
+						r++;
+					int start = r;
+					while (r < clampWidth && !isTransparentPixel(srcBuf, r))
+						r++;
+					if (start < r)
+						_zb->writeSpan(dstPixel + start, srcBuf, start, r - start, dim);
+				}
+				srcBuf.shiftBy(srcWidth);
 			}
-			srcBuf.shiftBy(srcWidth);
 		}
+		_zb->addDirtyRect(Common::Rect(dstX, dstY, dstX + clampWidth, dstY + clampHeight));
 	}
 }
 
@@ -1189,19 +1377,60 @@ void GfxTinyGL::drawBitmap(const Bitmap *bitmap, int x, int y, uint32 layer) {
 	if (bitmap->getFormat() == 1)
 		blitScreen(bitmap->getPixelFormat(num), &b[num], (byte *)bitmap->getData(num).getRawBuffer(),
 			 x, y, bitmap->getWidth(), bitmap->getHeight(), true, false);
-	else
+	else {
+		tglFlush();
 		blit(bitmap->getPixelFormat(num), nullptr, (byte *)_zb->zbuf, (byte *)bitmap->getData(num).getRawBuffer(),
 			 x, y, bitmap->getWidth(), bitmap->getHeight(), false);
+		_zb->invalidateDepthBlocks();
+	}
 }
 
 void GfxTinyGL::destroyBitmap(BitmapData *bitmap) {
-	for (int pic = 0; pic < bitmap->_numImages; pic++) {
-		if (bitmap->_data)
-			bitmap->_data[pic].free();
+	if (bitmap->_format != 1 && bitmap->_data) {
+		cacheZBitmap(bitmap);
+	} else {
+		for (int pic = 0; pic < bitmap->_numImages; pic++) {
+			if (bitmap->_data)
+				bitmap->_data[pic].free();
+		}
 	}
 	delete[] (BlitImage*)bitmap->_texIds;
 }
 
+bool GfxTinyGL::takeCachedZBitmap(const BitmapData *bitmap, Common::Array<uint32 *> &images) {
+	for (Common::List<ZBitmapCacheEntry>::iterator i = _zBitmapCache.begin(); i != _zBitmapCache.end(); ++i) {
+		if (i->fname == bitmap->_fname && i->width == bitmap->_width && i->height == bitmap->_height &&
+				(int)i->images.size() == bitmap->_numImages) {
+			images = i->images;
+			_zBitmapCacheSize -= i->images.size() * i->width * i->height * 4;
+			_zBitmapCache.erase(i);
+			return true;
+		}
+	}
+	return false;
+}
+
+void GfxTinyGL::cacheZBitmap(BitmapData *bitmap) {
+	ZBitmapCacheEntry entry;
+	entry.fname = bitmap->_fname;
+	entry.width = bitmap->_width;
+	entry.height = bitmap->_height;
+	for (int pic = 0; pic < bitmap->_numImages; pic++) {
+		entry.images.push_back((uint32 *)bitmap->_data[pic].getRawBuffer());
+		bitmap->_data[pic] = Graphics::PixelBuffer();
+	}
+	_zBitmapCache.push_back(entry);
+	_zBitmapCacheSize += entry.images.size() * entry.width * entry.height * 4;
+
+	while (_zBitmapCacheSize > kZBitmapCacheSize) {
+		ZBitmapCacheEntry &oldest = _zBitmapCache.front();
+		for (uint i = 0; i < oldest.images.size(); i++)
+			delete[] oldest.images[i];
+		_zBitmapCacheSize -= oldest.images.size() * oldest.width * oldest.height * 4;
+		_zBitmapCache.pop_front();
+	}
+}
+
 void GfxTinyGL::createFont(Font *font) {
 }
 
@@ -1314,28 +1543,32 @@ void GfxTinyGL::destroyTextObject(TextObject *text) {
 void GfxTinyGL::createTexture(Texture *texture, const char *data, const CMap *cmap, bool clamp) {
 	texture->_texture = new TGLuint[1];
 	tglGenTextures(1, (TGLuint *)texture->_texture);
-	uint8 *texdata = new uint8[texture->_width * texture->_height * 4];
-	uint8 *texdatapos = texdata;
+
+	TGLuint *textures = (TGLuint *)texture->_texture;
+	tglBindTexture(TGL_TEXTURE_2D, textures[0]);
+
+	// TinyGL doesn't have issues with dark lines in EMI intro so doesn't need TGL_CLAMP_TO_EDGE
+	tglTexParameteri(TGL_TEXTURE_2D, TGL_TEXTURE_WRAP_S, TGL_REPEAT);
+	tglTexParameteri(TGL_TEXTURE_2D, TGL_TEXTURE_WRAP_T, TGL_REPEAT);
+
+	tglTexParameteri(TGL_TEXTURE_2D, TGL_TEXTURE_MAG_FILTER, TGL_LINEAR);
+	tglTexParameteri(TGL_TEXTURE_2D, TGL_TEXTURE_MIN_FILTER, TGL_LINEAR);
 
 	if (cmap != nullptr) { // EMI doesn't have colour-maps
-		for (int y = 0; y < texture->_height; y++) {
-			for (int x = 0; x < texture->_width; x++) {
-				uint8 col = *data;
-				if (col == 0) {
-					memset(texdatapos, 0, 4); // transparent
-					if (!texture->_hasAlpha) {
-						texdatapos[3] = '\xff'; // fully opaque
-					}
-				} else {
-					memcpy(texdatapos, cmap->_colors + 3 * (col), 3);
-					texdatapos[3] = '\xff'; // fully opaque
-				}
-				texdatapos += 4;
-				data++;
-			}
+		// The texture keeps the 8 bit indices, with the colour-map as its palette
+		uint8 palette[256 * 4];
+		for (int i = 0; i < 256; i++) {
+			memcpy(palette + 4 * i, cmap->_colors + 3 * i, 3);
+			palette[4 * i + 3] = '\xff'; // fully opaque
 		}
-	} else {
-		memcpy(texdata, data, texture->_width * texture->_height * texture->_bpp);
+		memset(palette, 0, 3);
+		if (texture->_hasAlpha) {
+			palette[3] = 0; // transparent
+		}
+		tglColorTable(TGL_TEXTURE_2D, TGL_RGBA, 256, TGL_RGBA, TGL_UNSIGNED_BYTE, palette);
+		tglTexImage2D(TGL_TEXTURE_2D, 0, TGL_COLOR_INDEX8_EXT, texture->_width, texture->_height, 0,
+		              TGL_COLOR_INDEX, TGL_UNSIGNED_BYTE, const_cast<char *>(data));
+		return;
 	}
 
 	TGLuint format = 0;
@@ -1350,17 +1583,7 @@ void GfxTinyGL::createTexture(Texture *texture, const char *data, const CMap *cm
 //		internalFormat = TGL_RGB;
 	}
 
-	TGLuint *textures = (TGLuint *)texture->_texture;
-	tglBindTexture(TGL_TEXTURE_2D, textures[0]);
-
-	// TinyGL doesn't have issues with dark lines in EMI intro so doesn't need TGL_CLAMP_TO_EDGE
-	tglTexParameteri(TGL_TEXTURE_2D, TGL_TEXTURE_WRAP_S, TGL_REPEAT);
-	tglTexParameteri(TGL_TEXTURE_2D, TGL_TEXTURE_WRAP_T, TGL_REPEAT);
-
-	tglTexParameteri(TGL_TEXTURE_2D, TGL_TEXTURE_MAG_FILTER, TGL_LINEAR);
-	tglTexParameteri(TGL_TEXTURE_2D, TGL_TEXTURE_MIN_FILTER, TGL_LINEAR);
-	tglTexImage2D(TGL_TEXTURE_2D, 0, 3, texture->_width, texture->_height, 0, format, TGL_UNSIGNED_BYTE, texdata);
-	delete[] texdata;
+	tglTexImage2D(TGL_TEXTURE_2D, 0, 3, texture->_width, texture->_height, 0, format, TGL_UNSIGNED_BYTE, const_cast<char *>(data));
 }
 
 void GfxTinyGL::selectTexture(const Texture *texture) {
@@ -1411,6 +1634,7 @@ void GfxTinyGL::loadEmergFont() {
 }
 
 void GfxTinyGL::drawEmergString(int x, int y, const char *text, const Color &fgColor) {
+	tglFlush();
 	uint32 color = _pixelFormat.RGBToColor(fgColor.getRed(), fgColor.getGreen(), fgColor.getBlue());
 
 	int length = strlen(text);
@@ -1495,6 +1719,7 @@ void GfxTinyGL::dimRegion(int x, int y, int w, int h, float level) {
 }
 
 void GfxTinyGL::irisAroundRegion(int x1, int y1, int x2, int y2) {
+	tglFlush();
 	for (int ly = 0; ly < _gameHeight; ly++) {
 		for (int lx = 0; lx < _gameWidth; lx++) {
 			// Don't do anything with the data in the region we draw Around
@@ -1507,6 +1732,7 @@ void GfxTinyGL::irisAroundRegion(int x1, int y1, int x2, int y2) {
 }
 
 void GfxTinyGL::drawRectangle(const PrimitiveObject *primitive) {
+	tglFlush();
 	int x1 = primitive->getP1().x;
 	int y1 = primitive->getP1().y;
 	int x2 = primitive->getP2().x;
@@ -1542,6 +1768,7 @@ void GfxTinyGL::drawRectangle(const PrimitiveObject *primitive) {
 }
 
 void GfxTinyGL::drawLine(const PrimitiveObject *primitive) {
+	tglFlush();
 	int x1 = primitive->getP1().x;
 	int y1 = primitive->getP1().y;
 	int x2 = primitive->getP2().x;
@@ -1566,6 +1793,7 @@ void GfxTinyGL::drawLine(const PrimitiveObject *primitive) {
 }
 
 void GfxTinyGL::drawPolygon(const PrimitiveObject *primitive) {
+	tglFlush();
 	int x1 = primitive->getP1().x;
 	int y1 = primitive->getP1().y;
 	int x2 = primitive->getP2().x;
@@ -25,6 +25,8 @@
 
 #include "engines/grim/gfx_base.h"
 
+#include "common/list.h"
+
 #include "graphics/tinygl/zgl.h"
 
 namespace TinyGL {
@@ -82,6 +84,7 @@ public:
 
 	void drawEMIModelFace(const EMIModel *model, const EMIMeshFace *face) override;
 	void drawModelFace(const Mesh *mesh, const MeshFace *face) override;
+	void drawMesh(const Mesh *mesh) override;
 	void drawSprite(const Sprite *sprite) override;
 
 	void enableLights() override;
@@ -125,6 +128,9 @@ public:
 
 	void createSpecialtyTextures() override;
 
+	void createMesh(Mesh *mesh) override;
+	void destroyMesh(const Mesh *mesh) override;
+
 	int genBuffer() override;
 	void delBuffer(int buffer) override;
 	void selectBuffer(int buffer) override;
@@ -136,6 +142,7 @@ protected:
 
 private:
 	TinyGL::FrameBuffer *_zb;
+	TinyGL::GLContext *_context;
 	Graphics::PixelBuffer _smushBitmap;
 	int _smushWidth;
 	int _smushHeight;
@@ -146,7 +153,28 @@ private:
 	const Actor *_currentActor;
 	TGLenum _depthFunc;
 
+	// Z-buffer value of every 16 bit depth bitmap value, built on first use
+	uint32 *_zBitmapLUT;
+
+	// Converted images of destroyed depth bitmaps, most recently used last, so
+	// that going back to a set does not convert its depth bitmaps again
+	struct ZBitmapCacheEntry {
+		Common::String fname;
+		int width, height;
+		Common::Array<uint32 *> images;
+	};
+	Common::List<ZBitmapCacheEntry> _zBitmapCache;
+	uint32 _zBitmapCacheSize;
+
+	// Scratch arrays handed to tglDrawArrays / tglDrawElements
+	Common::Array<float> _vertexArray;
+	Common::Array<float> _normalArray;
+	Common::Array<float> _texCoordArray;
+	Common::Array<float> _colorArray;
+
 	void readPixels(int x, int y, int width, int height, uint8 *buffer);
+	bool takeCachedZBitmap(const BitmapData *bitmap, Common::Array<uint32 *> &images);
+	void cacheZBitmap(BitmapData *bitmap);
 	void blit(const Graphics::PixelFormat &format, BlitImage *blit, byte *dst, byte *src, int x, int y, int width, int height, bool trans);
 	void blit(const Graphics::PixelFormat &format, BlitImage *blit, byte *dst, byte *src, int dstX, int dstY, int srcX, int srcY, int width, int height, int srcWidth, int srcHeight, bool trans);
 	void blitScreen(const Graphics::PixelFormat &format, BlitImage *blit, byte *src, int x, int y, int width, int height, bool trans, bool dimSprites);
@@ -57,6 +57,7 @@
 #include "engines/grim/gfx_base.h"
 #include "engines/grim/bitmap.h"
 #include "engines/grim/font.h"
+#include "engines/grim/material.h"
 #include "engines/grim/primitives.h"
 #include "engines/grim/objectstate.h"
 #include "engines/grim/set.h"
@@ -100,6 +101,8 @@ GrimEngine::GrimEngine(OSystem *syst, uint32 gameFlags, GrimGameType gameType, C
 	ConfMan.registerDefault("fullscreen", false);
 	ConfMan.registerDefault("show_fps", false);
 	ConfMan.registerDefault("use_arb_shaders", true);
+	ConfMan.registerDefault("tinygl_threads", 0);
+	ConfMan.registerDefault("resource_cache_size", 32);
 
 	_showFps = ConfMan.getBool("show_fps");
 
@@ -485,6 +488,7 @@ void GrimEngine::luaUpdate() {
 			// when he needs to perform certain chores
 			a->update(_frameTime);
 		}
+		animateActors();
 
 		_iris->update(_frameTime);
 
@@ -679,19 +683,9 @@ void GrimEngine::mainLoop() {
 			g_system->setFeatureState(OSystem::kFeatureFullscreenMode, fullscreen);
 			ConfMan.setBool("fullscreen", fullscreen);
 
-			uint screenWidth = g_driver->getScreenWidth();
-			uint screenHeight = g_driver->getScreenHeight();
-
 			EngineMode mode = getMode();
 
-			_savegameFileName = "";
-			savegameSave();
-			clearPools();
-
-			delete g_driver;
-			createRenderer();
-			g_driver->setupScreen(screenWidth, screenHeight, fullscreen);
-			savegameRestore();
+			changeRenderer(fullscreen);
 
 			if (mode == DrawMode) {
 				setMode(GrimEngine::NormalMode);
@@ -803,6 +797,69 @@ void GrimEngine::loadGame(const Common::String &file) {
 	_savegameLoadRequest = true;
 }
 
+void GrimEngine::changeRenderer(bool fullscreen) {
+	uint screenWidth = g_driver->getScreenWidth();
+	uint screenHeight = g_driver->getScreenHeight();
+
+	byte r, g, b;
+	g_driver->getShadowColor(&r, &g, &b);
+	bool renderBitmaps = g_driver->getRenderBitmaps();
+	bool renderZBitmaps = g_driver->getRenderZBitmaps();
+
+	// Release everything the current renderer created while it is still
+	// alive. The engine objects themselves are kept, the new renderer
+	// creates its side of them again below.
+	foreach (TextObject *t, TextObject::getPool()) {
+		t->destroy();
+	}
+	foreach (Font *f, Font::getPool()) {
+		g_driver->destroyFont(f);
+		f->setUserData(nullptr);
+	}
+	foreach (Actor *a, Actor::getPool()) {
+		a->releaseRenderData();
+	}
+	g_resourceloader->releaseRenderData();
+	if (MaterialData::_materials) {
+		for (Common::List<MaterialData *>::iterator i = MaterialData::_materials->begin(); i != MaterialData::_materials->end(); ++i) {
+			(*i)->releaseTextures();
+		}
+	}
+	foreach (Bitmap *bitmap, Bitmap::getPool()) {
+		bitmap->_data->unload();
+	}
+
+	delete g_driver;
+	createRenderer();
+	g_driver->setupScreen(screenWidth, screenHeight, fullscreen);
+
+	g_driver->setShadowColor(r, g, b);
+	g_driver->renderBitmaps(renderBitmaps);
+	g_driver->renderZBitmaps(renderZBitmaps);
+
+	// Textures are created again when they are selected and text objects
+	// when they are drawn.
+	foreach (Bitmap *bitmap, Bitmap::getPool()) {
+		bitmap->_data->load();
+	}
+	foreach (Font *f, Font::getPool()) {
+		g_driver->createFont(f);
+	}
+	g_resourceloader->restoreRenderData();
+
+	_refreshShadowMask = true;
+	_shortFrame = true;
+
+	g_driver->refreshBuffers();
+	if (_currSet) {
+		_currSet->setupCamera();
+		g_driver->set3DMode();
+	}
+	foreach (Actor *a, Actor::getPool()) {
+		a->restoreRenderData();
+	}
+}
+
 void GrimEngine::savegameRestore() {
 	debug("GrimEngine::savegameRestore() started.");
 	_savegameLoadRequest = false;
@@ -201,10 +201,13 @@ protected:
 	void buildActiveActorsList();
 	void savegameCallback();
 	void createRenderer();
+	void changeRenderer(bool fullscreen);
 	virtual LuaBase *createLua();
 	virtual void updateNormalMode();
 	virtual void updateDrawMode();
 	virtual void drawNormalMode();
+	// Called once all the active actors are updated. Grim actors animate in Actor::update()
+	virtual void animateActors() { }
 
 	void savegameSave();
 	void saveGRIM();
@@ -21,13 +21,93 @@
  */
 
 #include "common/file.h"
-#include "common/substream.h"
+#include "common/memstream.h"
+#include "common/mutex.h"
 
 #include "engines/grim/grim.h"
 #include "engines/grim/lab.h"
 
 namespace Grim {
 
+class LabFile {
+public:
+	LabFile() : _mapped(nullptr) {}
+	~LabFile() { delete _mapped; }
+
+	// The lab mapped in memory, when the backend supports it
+	Common::MemoryReadStream *_mapped;
+
+	// Otherwise the members are read from the file
+	Common::File _file;
+	// The members may be read from other threads, such as the one of iMuse
+	Common::Mutex _mutex;
+};
+
+/**
+ * Stream of a member of a mapped lab, which reads the mapping directly.
+ */
+class LabMappedMemberStream : public Common::MemoryReadStream {
+public:
+	LabMappedMemberStream(const Common::SharedPtr<LabFile> &file, uint32 offset, uint32 len) :
+		Common::MemoryReadStream(file->_mapped->getData() + offset, len), _file(file) {}
+
+private:
+	Common::SharedPtr<LabFile> _file;
+};
+
+/**
+ * Stream of a member of a lab. It reads from the shared lab file at its own
+ * position, so that the streams of several members can be used together.
+ */
+class LabMemberStream : public Common::SeekableReadStream {
+public:
+	LabMemberStream(const Common::SharedPtr<LabFile> &file, uint32 begin, uint32 end) :
+		_file(file), _begin(begin), _end(end), _pos(begin), _eos(false) {}
+
+	bool eos() const override { return _eos; }
+	bool err() const override { return _file->_file.err(); }
+	void clearErr() override { _eos = false; _file->_file.clearErr(); }
+	int32 pos() const override { return _pos - _begin; }
+	int32 size() const override { return _end - _begin; }
+
+	bool seek(int32 offset, int whence = SEEK_SET) override {
+		switch (whence) {
+		case SEEK_END:
+			offset = size() + offset;
+			// fallthrough
+		case SEEK_SET:
+		default:
+			_pos = _begin + offset;
+			break;
+		case SEEK_CUR:
+			_pos += offset;
+			break;
+		}
+		assert(_pos >= _begin);
+		assert(_pos <= _end);
+		_eos = false;
+		return true;
+	}
+
+	uint32 read(void *dataPtr, uint32 dataSize) override {
+		if (dataSize > _end - _pos) {
+			dataSize = _end - _pos;
+			_eos = true;
+		}
+
+		Common::StackLock lock(_file->_mutex);
+		_file->_file.seek(_pos);
+		dataSize = _file->_file.read(dataPtr, dataSize);
+		_pos += dataSize;
+		return dataSize;
+	}
+
+private:
+	Common::SharedPtr<LabFile> _file;
+	uint32 _begin, _end, _pos;
+	bool _eos;
+};
+
 LabEntry::LabEntry(const Common::String &name, uint32 offset, uint32 len, Lab *parent) :
 		_offset(offset), _len(len), _parent(parent), _name(name) {
 	_name.toLowercase();
@@ -40,25 +120,33 @@ Common::SeekableReadStream *LabEntry::createReadStream() const {
 bool Lab::open(const Common::String &filename) {
 	_labFileName = filename;
 
-	bool result = true;
-
-	Common::File *file = new Common::File();
-	if (!file->open(filename) || file->readUint32BE() != MKTAG('L','A','B','N')) {
-		result = false;
-	} else {
-		file->readUint32LE(); // version
+	_file = Common::SharedPtr<LabFile>(new LabFile());
+	_file->_mapped = Common::File::createMappedReadStream(filename);
 
-		if (g_grim->getGameType() == GType_GRIM)
-			parseGrimFileTable(file);
-		else
-			parseMonkey4FileTable(file);
+	Common::SeekableReadStream *file = _file->_mapped;
+	if (!file) {
+		if (!_file->_file.open(filename)) {
+			_file.reset();
+			return false;
+		}
+		file = &_file->_file;
+	}
+	if (file->readUint32BE() != MKTAG('L','A','B','N')) {
+		_file.reset();
+		return false;
 	}
-	delete file;
 
-	return result;
+	file->readUint32LE(); // version
+
+	if (g_grim->getGameType() == GType_GRIM)
+		parseGrimFileTable(file);
+	else
+		parseMonkey4FileTable(file);
+
+	return true;
 }
 
-void Lab::parseGrimFileTable(Common::File *file) {
+void Lab::parseGrimFileTable(Common::SeekableReadStream *file) {
 	uint32 entryCount = file->readUint32LE();
 	uint32 stringTableSize = file->readUint32LE();
 
@@ -78,7 +166,7 @@ void Lab::parseGrimFileTable(Common::File *file) {
 		Common::String fname = stringTable + fnameOffset;
 		fname.toLowercase();
 
-		if (start + size > filesize)
+		if (start < 0 || size < 0 || start > filesize - size)
 			error("File \"%s\" past the end of lab \"%s\". Your game files may be corrupt.", fname.c_str(), _labFileName.c_str());
 
 		LabEntry *entry = new LabEntry(fname, start, size, this);
@@ -88,7 +176,7 @@ void Lab::parseGrimFileTable(Common::File *file) {
 	delete[] stringTable;
 }
 
-void Lab::parseMonkey4FileTable(Common::File *file) {
+void Lab::parseMonkey4FileTable(Common::SeekableReadStream *file) {
 	uint32 entryCount = file->readUint32LE();
 	uint32 stringTableSize = file->readUint32LE();
 	uint32 stringTableOffset = file->readUint32LE() - 0x13d0f;
@@ -121,7 +209,7 @@ void Lab::parseMonkey4FileTable(Common::File *file) {
 		Common::String fname = str;
 		fname.toLowercase();
 
-		if (start + size > filesize)
+		if (start < 0 || size < 0 || start > filesize - size)
 			error("File \"%s\" past the end of lab \"%s\". Your game files may be corrupt.", fname.c_str(), _labFileName.c_str());
 
 		LabEntry *entry = new LabEntry(fname, start, size, this);
@@ -132,9 +220,7 @@ void Lab::parseMonkey4FileTable(Common::File *file) {
 }
 
 bool Lab::hasFile(const Common::String &filename) const {
-	Common::String fname(filename);
-	fname.toLowercase();
-	return _entries.contains(fname);
+	return _entries.contains(filename);
 }
 
 int Lab::listMembers(Common::ArchiveMemberList &list) const {
@@ -149,25 +235,28 @@ int Lab::listMembers(Common::ArchiveMemberList &list) const {
 }
 
 const Common::ArchiveMemberPtr Lab::getMember(const Common::String &name) const {
-	if (!hasFile(name))
+	LabMap::const_iterator i = _entries.find(name);
+	if (i == _entries.end())
 		return Common::ArchiveMemberPtr();
 
-	Common::String fname(name);
-	fname.toLowercase();
-	return _entries[fname];
+	return i->_value;
 }
 
 Common::SeekableReadStream *Lab::createReadStreamForMember(const Common::String &filename) const {
-	if (!hasFile(filename))
+	LabMap::const_iterator i = _entries.find(filename);
+	if (i == _entries.end())
 		return nullptr;
 
-	Common::String fname(filename);
-	fname.toLowercase();
-	LabEntryPtr i = _entries[fname];
-
-	Common::File *file = new Common::File();
-	file->open(_labFileName);
-	return new Common::SeekableSubReadStream(file, i->_offset, i->_offset + i->_len, DisposeAfterUse::YES);
+	const LabEntry *entry = i->_value.get();
+	if (_file->_mapped) {
+		uint32 labSize = _file->_mapped->size();
+		if (entry->_offset > labSize || entry->_len > labSize - entry->_offset) {
+			warning("File \"%s\" past the end of lab \"%s\"", filename.c_str(), _labFileName.c_str());
+			return nullptr;
+		}
+		return new LabMappedMemberStream(_file, entry->_offset, entry->_len);
+	}
+	return new LabMemberStream(_file, entry->_offset, entry->_offset + entry->_len);
 }
 
 } // end of namespace Grim
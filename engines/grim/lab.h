@@ -26,12 +26,13 @@
 #include "common/archive.h"
 
 namespace Common {
-	class File;
+	class SeekableReadStream;
 }
 
 namespace Grim {
 
 class Lab;
+class LabFile;
 
 class LabEntry : public Common::ArchiveMember {
 	Lab *_parent;
@@ -55,10 +56,12 @@ public:
 	virtual Common::SeekableReadStream *createReadStreamForMember(const Common::String &name) const override;
 
 private:
-	void parseGrimFileTable(Common::File *_f);
-	void parseMonkey4FileTable(Common::File *_f);
+	void parseGrimFileTable(Common::SeekableReadStream *_f);
+	void parseMonkey4FileTable(Common::SeekableReadStream *_f);
 
 	Common::String _labFileName;
+	// The lab file is kept open or mapped, and shared by the streams of its members
+	Common::SharedPtr<LabFile> _file;
 	typedef Common::SharedPtr<LabEntry> LabEntryPtr;
 	typedef Common::HashMap<Common::String, LabEntryPtr, Common::IgnoreCase_Hash, Common::IgnoreCase_EqualTo> LabMap;
 	LabMap _entries;
@@ -35,6 +35,7 @@
 namespace Grim {
 
 Common::List<MaterialData *> *MaterialData::_materials = nullptr;
+ResourceRegistry<MaterialData> *MaterialData::_registry = nullptr;
 
 MaterialData::MaterialData(const Common::String &filename, Common::SeekableReadStream *data, CMap *cmap) :
 		_fname(filename), _cmap(cmap), _refCount(1), _textures(nullptr) {
@@ -164,11 +165,26 @@ void MaterialData::initEMI(Common::SeekableReadStream *data) {
 
 MaterialData::~MaterialData() {
 	_materials->remove(this);
+	Common::String key = getKey(_fname, _cmap);
+	if (_registry->remove(key, this)) {
+		for (Common::List<MaterialData *>::iterator i = _materials->begin(); i != _materials->end(); ++i) {
+			if (getKey((*i)->_fname, (*i)->_cmap) == key) {
+				_registry->add(key, *i);
+				break;
+			}
+		}
+	}
 	if (_materials->empty()) {
 		delete _materials;
 		_materials = nullptr;
+		delete _registry;
+		_registry = nullptr;
 	}
 
+	freeTextures();
+}
+
+void MaterialData::freeTextures() {
 	for (int i = 0; i < _numImages; ++i) {
 		Texture *t = _textures + i;
 		if (t->_width && t->_height && t->_texture)
@@ -176,27 +192,48 @@ MaterialData::~MaterialData() {
 		delete[] t->_data;
 	}
 	delete[] _textures;
+	_textures = nullptr;
+	_numImages = 0;
+}
+
+void MaterialData::releaseTextures() {
+	freeTextures();
+
+	Common::SeekableReadStream *data = g_resourceloader->openNewStreamFile(_fname.c_str(), true);
+	if (!data)
+		error("Could not find material %s", _fname.c_str());
+
+	if (g_grim->getGameType() == GType_MONKEY4) {
+		initEMI(data);
+	} else {
+		initGrim(data);
+	}
+	delete data;
+}
+
+Common::String MaterialData::getKey(const Common::String &filename, const CMap *cmap) {
+	// EMI shares the materials regardless of the colormap
+	if (g_grim->getGameType() == GType_MONKEY4 || !cmap)
+		return filename;
+	return filename + ':' + cmap->getFilename();
 }
 
 MaterialData *MaterialData::getMaterialData(const Common::String &filename, Common::SeekableReadStream *data, CMap *cmap) {
 	if (!_materials) {
 		_materials = new Common::List<MaterialData *>();
+		_registry = new ResourceRegistry<MaterialData>();
 	}
 
-	for (Common::List<MaterialData *>::iterator i = _materials->begin(); i != _materials->end(); ++i) {
-		MaterialData *m = *i;
-		if (m->_fname == filename && g_grim->getGameType() == GType_MONKEY4) {
-			++m->_refCount;
-			return m;
-		}
-		if (m->_fname == filename && m->_cmap->getFilename() == cmap->getFilename()) {
-			++m->_refCount;
-			return m;
-		}
+	Common::String key = getKey(filename, cmap);
+	MaterialData *m = _registry->find(key);
+	if (m) {
+		++m->_refCount;
+		return m;
 	}
 
-	MaterialData *m = new MaterialData(filename, data, cmap);
+	m = new MaterialData(filename, data, cmap);
 	_materials->push_back(m);
+	_registry->add(key, m);
 	return m;
 }
 
@@ -28,6 +28,7 @@
 namespace Grim {
 
 class CMap;
+template<class T> class ResourceRegistry;
 
 class Texture {
 public:
@@ -47,6 +48,14 @@ public:
 
 	static MaterialData *getMaterialData(const Common::String &filename, Common::SeekableReadStream *data, CMap *cmap);
 	static Common::List<MaterialData *> *_materials;
+	static ResourceRegistry<MaterialData> *_registry;
+
+	/**
+	 * Destroy the textures of the current renderer. The images are read again
+	 * from the file, since their data is dropped once it is uploaded, and the
+	 * next renderer creates its textures from them on demand.
+	 */
+	void releaseTextures();
 
 	Common::String _fname;
 	const ObjectPtr<CMap> _cmap;
@@ -55,8 +64,11 @@ public:
 	int _refCount;
 
 private:
+	static Common::String getKey(const Common::String &filename, const CMap *cmap);
+
 	void initGrim(Common::SeekableReadStream *data);
 	void initEMI(Common::SeekableReadStream *data);
+	void freeTextures();
 };
 
 class Material : public Object {
@@ -227,7 +227,9 @@ void Model::reload(CMap *cmap) {
 	}
 	for (int i = 0; i < _numGeosets; i++)
 		_geosets[i].changeMaterials(_materials);
+	Common::String oldKey = ResourceLoader::getModelKey(_fname, _cmap);
 	_cmap = cmap;
+	g_resourceloader->rekeyModel(this, oldKey);
 }
 
 void Model::loadMaterial(int index, CMap *cmap) {
@@ -458,6 +460,7 @@ void Mesh::loadBinary(Common::SeekableReadStream *data, Material *materials[]) {
 	_radius = get_float(f);
 	data->seek(24, SEEK_CUR);
 	sortFaces();
+	calculateBounds();
 }
 
 void Mesh::loadText(TextSplitter *ts, Material *materials[]) {
@@ -525,6 +528,7 @@ void Mesh::loadText(TextSplitter *ts, Material *materials[]) {
 		_faces[num].setNormal(Math::Vector3d(x, y, z));
 	}
 	sortFaces();
+	calculateBounds();
 }
 
 void Mesh::sortFaces() {
@@ -558,6 +562,16 @@ void Mesh::sortFaces() {
 	delete[] copied;
 }
 
+void Mesh::calculateBounds() {
+	_bounds.reset();
+	for (int i = 0; i < _numFaces; i++) {
+		for (int j = 0; j < _faces[i].getNumVertices(); j++) {
+			const float *v = _vertices + 3 * _faces[i].getVertex(j);
+			_bounds.expand(Math::Vector3d(v[0], v[1], v[2]));
+		}
+	}
+}
+
 void Mesh::update() {
 }
 
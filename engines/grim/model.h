@@ -24,6 +24,7 @@
 #define GRIM_MODEL_H
 
 #include "engines/grim/object.h"
+#include "math/aabb.h"
 #include "math/matrix4.h"
 #include "math/quat.h"
 
@@ -149,10 +150,14 @@ public:
 	MeshFace *_faces;
 	Math::Matrix4 _matrix;
 
+	// Object space bounds of the vertices used by the faces
+	Math::AABB _bounds;
+
 	void *_userData;
 
 private:
 	void sortFaces();
+	void calculateBounds();
 };
 
 class ModelNode {
@@ -33,6 +33,7 @@
 #include "engines/grim/lab.h"
 #include "engines/grim/bitmap.h"
 #include "engines/grim/font.h"
+#include "engines/grim/gfx_base.h"
 #include "engines/grim/model.h"
 #include "engines/grim/sprite.h"
 #include "engines/grim/inputdialog.h"
@@ -71,8 +72,12 @@ public:
 };
 
 ResourceLoader::ResourceLoader() {
-	_cacheDirty = false;
 	_cacheMemorySize = 0;
+	_cacheMemoryBudget = MAX(ConfMan.getInt("resource_cache_size"), 0) * 1024 * 1024;
+	_cacheHits = 0;
+	_cacheMisses = 0;
+	_cacheEvictions = 0;
+	_cacheInflatedBytesSaved = 0;
 
 	Lab *l;
 	Common::ArchiveMemberList files, updFiles;
@@ -215,11 +220,12 @@ void clearList(Common::List<T> &list) {
 }
 
 ResourceLoader::~ResourceLoader() {
-	for (Common::Array<ResourceCache>::iterator i = _cache.begin(); i != _cache.end(); ++i) {
-		ResourceCache &r = *i;
-		delete[] r.fname;
-		delete[] r.resPtr;
-	}
+	// The resources remove themselves from the registries as they are deleted
+	_modelRegistry.clear();
+	_colormapRegistry.clear();
+	_keyframeRegistry.clear();
+	_lipsyncRegistry.clear();
+	_emiAnimRegistry.clear();
 	clearList(_models);
 	clearList(_colormaps);
 	clearList(_keyframeAnims);
@@ -227,32 +233,45 @@ ResourceLoader::~ResourceLoader() {
 	MD5Check::clear();
 }
 
-static int sortCallback(const void *entry1, const void *entry2) {
-	return scumm_stricmp(((const ResourceLoader::ResourceCache *)entry1)->fname, ((const ResourceLoader::ResourceCache *)entry2)->fname);
-}
+namespace {
 
-Common::SeekableReadStream *ResourceLoader::getFileFromCache(const Common::String &filename) const {
-	ResourceLoader::ResourceCache *entry = getEntryFromCache(filename);
-	if (!entry)
-		return nullptr;
+struct CacheBufferDeleter {
+	void operator()(byte *ptr) { delete[] ptr; }
+};
 
-	return new Common::MemoryReadStream(entry->resPtr, entry->len);
+// A stream over a cached file, which keeps the file in memory even if it is
+// dropped from the cache while the stream is still in use
+class CachedResourceStream : public Common::MemoryReadStream {
+public:
+	CachedResourceStream(const Common::SharedPtr<byte> &data, uint32 len) :
+		Common::MemoryReadStream(data.get(), len), _data(data) {}
+
+private:
+	Common::SharedPtr<byte> _data;
+};
 
 }
 
-ResourceLoader::ResourceCache *ResourceLoader::getEntryFromCache(const Common::String &filename) const {
-	if (_cache.empty())
+Common::SeekableReadStream *ResourceLoader::getFileFromCache(const Common::String &filename) const {
+	ResourceCacheMap::iterator entry = _cache.find(filename);
+	if (entry == _cache.end()) {
+		++_cacheMisses;
 		return nullptr;
-
-	if (_cacheDirty) {
-		qsort(_cache.begin(), _cache.size(), sizeof(ResourceCache), sortCallback);
-		_cacheDirty = false;
 	}
 
-	ResourceCache key;
-	key.fname = const_cast<char *>(filename.c_str());
+	++_cacheHits;
+	ResourceCache &r = entry->_value;
+	_cacheLRU.erase(r.lruPos);
+	_cacheLRU.push_front(filename);
+	r.lruPos = _cacheLRU.begin();
+
+	Common::SeekableReadStream *s = new CachedResourceStream(r.resPtr, r.len);
+	if (r.compressed)
+		return Common::wrapCompressedReadStream(s);
 
-	return (ResourceLoader::ResourceCache *)bsearch(&key, _cache.begin(), _cache.size(), sizeof(ResourceCache), sortCallback);
+	if (r.inflated)
+		_cacheInflatedBytesSaved += r.len;
+	return s;
 }
 
 Common::SeekableReadStream *ResourceLoader::loadFile(const Common::String &filename) const {
@@ -280,26 +299,86 @@ Common::SeekableReadStream *ResourceLoader::openNewStreamFile(Common::String fna
 			uint32 size = s->size();
 			byte *buf = new byte[size];
 			s->read(buf, size);
-			putIntoCache(fname, buf, size);
 			delete s;
-			s = new Common::MemoryReadStream(buf, size);
+			s = putIntoCache(fname, buf, size);
 		}
-	} else {
-		s = loadFile(fname);
+		return s;
 	}
+
+	s = loadFile(fname);
 	// This will only have an effect if the stream is actually compressed.
 	return Common::wrapCompressedReadStream(s);
 }
 
-void ResourceLoader::putIntoCache(const Common::String &fname, byte *res, uint32 len) const {
-	ResourceCache entry;
-	entry.resPtr = res;
+Common::SeekableReadStream *ResourceLoader::putIntoCache(const Common::String &fname, byte *res, uint32 len) const {
+	// Keep compressed files inflated when they fit in the budget, so that the
+	// hits can read them straight away. Otherwise keep the compressed data,
+	// which is also the case for zlib streams that do not tell their size.
+	// A stream that ends early is kept compressed too, so that reading it
+	// fails the same way as without the cache.
+	bool compressed = false;
+	bool wasInflated = false;
+	Common::SeekableReadStream *raw = new Common::MemoryReadStream(res, len);
+	Common::SeekableReadStream *inflated = Common::wrapCompressedReadStream(raw);
+	if (inflated != raw) {
+		compressed = true;
+		if (inflated && inflated->size() > 0 && (uint32)inflated->size() <= _cacheMemoryBudget) {
+			uint32 size = inflated->size();
+			byte *buf = new byte[size];
+			if (inflated->read(buf, size) == size && !inflated->err()) {
+				delete[] res;
+				res = buf;
+				len = size;
+				compressed = false;
+				wasInflated = true;
+			} else {
+				delete[] buf;
+			}
+		}
+	}
+	delete inflated;
+
+	// A file bigger than the whole budget would only push everything else out
+	if (len > _cacheMemoryBudget) {
+		Common::SeekableReadStream *s = new Common::MemoryReadStream(res, len, DisposeAfterUse::YES);
+		return compressed ? Common::wrapCompressedReadStream(s) : s;
+	}
+
+	while (_cacheMemorySize + len > _cacheMemoryBudget) {
+		Common::String oldest = _cacheLRU.back();
+		Debug::debug(Debug::Engine, "ResourceLoader: dropping %s from the cache", oldest.c_str());
+		removeFromCache(oldest);
+		++_cacheEvictions;
+	}
+
+	ResourceCache &entry = _cache[fname];
+	entry.resPtr = Common::SharedPtr<byte>(res, CacheBufferDeleter());
 	entry.len = len;
-	entry.fname = new char[fname.size() + 1];
-	strcpy(entry.fname, fname.c_str());
+	entry.compressed = compressed;
+	entry.inflated = wasInflated;
+	_cacheLRU.push_front(fname);
+	entry.lruPos = _cacheLRU.begin();
 	_cacheMemorySize += len;
-	_cache.push_back(entry);
-	_cacheDirty = true;
+
+	Common::SeekableReadStream *s = new CachedResourceStream(entry.resPtr, len);
+	return compressed ? Common::wrapCompressedReadStream(s) : s;
+}
+
+void ResourceLoader::removeFromCache(const Common::String &fname) const {
+	ResourceCacheMap::iterator entry = _cache.find(fname);
+	if (entry == _cache.end())
+		return;
+
+	_cacheMemorySize -= entry->_value.len;
+	_cacheLRU.erase(entry->_value.lruPos);
+	_cache.erase(entry);
+}
+
+void ResourceLoader::getCacheCounters(uint32 &hits, uint32 &misses, uint32 &evictions, uint64 &inflatedBytesSaved) const {
+	hits = _cacheHits;
+	misses = _cacheMisses;
+	evictions = _cacheEvictions;
+	inflatedBytesSaved = _cacheInflatedBytesSaved;
 }
 
 CMap *ResourceLoader::loadColormap(const Common::String &filename) {
@@ -310,6 +389,7 @@ CMap *ResourceLoader::loadColormap(const Common::String &filename) {
 
 	CMap *result = new CMap(filename, stream);
 	_colormaps.push_back(result);
+	_colormapRegistry.add(result->getFilename(), result);
 	delete stream;
 
 	return result;
@@ -374,6 +454,7 @@ KeyframeAnim *ResourceLoader::loadKeyframe(const Common::String &filename) {
 
 	KeyframeAnim *result = new KeyframeAnim(filename, stream);
 	_keyframeAnims.push_back(result);
+	_keyframeRegistry.add(result->getFilename(), result);
 	delete stream;
 
 	return result;
@@ -390,9 +471,10 @@ LipSync *ResourceLoader::loadLipSync(const Common::String &filename) {
 	result = new LipSync(filename, stream);
 
 	// Some lipsync files have no data
-	if (result->isValid())
+	if (result->isValid()) {
 		_lipsyncs.push_back(result);
-	else {
+		_lipsyncRegistry.add(result->getFilename(), result);
+	} else {
 		delete result;
 		result = nullptr;
 	}
@@ -435,6 +517,7 @@ Model *ResourceLoader::loadModel(const Common::String &filename, CMap *c, Model
 
 	Model *result = new Model(filename, stream, c, parent);
 	_models.push_back(result);
+	_modelRegistry.add(getModelKey(result->getFilename(), result->getCMap()), result);
 	delete stream;
 
 	return result;
@@ -504,6 +587,7 @@ AnimationEmi *ResourceLoader::loadAnimationEmi(const Common::String &filename) {
 
 	AnimationEmi *result = new AnimationEmi(filename, stream);
 	_emiAnims.push_back(result);
+	_emiAnimRegistry.add(result->getFilename(), result);
 	delete stream;
 
 	return result;
@@ -512,52 +596,115 @@ AnimationEmi *ResourceLoader::loadAnimationEmi(const Common::String &filename) {
 void ResourceLoader::uncache(const char *filename) const {
 	Common::String fname = filename;
 	fname.toLowercase();
-
-	if (_cacheDirty) {
-		qsort(_cache.begin(), _cache.size(), sizeof(ResourceCache), sortCallback);
-		_cacheDirty = false;
-	}
-
-	for (unsigned int i = 0; i < _cache.size(); i++) {
-		if (fname.compareTo(_cache[i].fname) == 0) {
-			delete[] _cache[i].fname;
-			_cacheMemorySize -= _cache[i].len;
-			delete[] _cache[i].resPtr;
-			_cache.remove_at(i);
-			_cacheDirty = true;
+	removeFromCache(fname);
+}
+
+// Remove res from the registry, and add the next resource with the same name
+// in its place, if there is one
+template<class T>
+static void unregisterResource(ResourceRegistry<T> &registry, const Common::List<T *> &list, T *res,
+                               const Common::String &key, Common::String (*getKey)(const T *)) {
+	if (!registry.remove(key, res))
+		return;
+	for (typename Common::List<T *>::const_iterator i = list.begin(); i != list.end(); ++i) {
+		if (getKey(*i) == key) {
+			registry.add(key, *i);
+			return;
 		}
 	}
 }
 
+Common::String ResourceLoader::getModelKey(const Common::String &fname, const CMap *c) {
+	// Models loaded by the costumes may have no colormap
+	if (!c)
+		return fname + ':';
+	return fname + ':' + c->getFilename();
+}
+
+static Common::String getModelKeyOf(const Model *m) {
+	return ResourceLoader::getModelKey(m->getFilename(), m->getCMap());
+}
+
+template<class T>
+static Common::String getFilenameKey(const T *res) {
+	return res->getFilename();
+}
+
 void ResourceLoader::uncacheModel(Model *m) {
 	_models.remove(m);
+	unregisterResource(_modelRegistry, _models, m, getModelKeyOf(m), &getModelKeyOf);
+}
+
+void ResourceLoader::rekeyModel(Model *m, const Common::String &oldKey) {
+	unregisterResource(_modelRegistry, _models, m, oldKey, &getModelKeyOf);
+	_modelRegistry.add(getModelKeyOf(m), m);
+}
+
+void ResourceLoader::uncacheEMIModel(EMIModel *m) {
+	_emiModels.remove(m);
 }
 
 void ResourceLoader::uncacheColormap(CMap *c) {
 	_colormaps.remove(c);
+	unregisterResource(_colormapRegistry, _colormaps, c, c->getFilename(), &getFilenameKey<CMap>);
 }
 
 void ResourceLoader::uncacheKeyframe(KeyframeAnim *k) {
 	_keyframeAnims.remove(k);
+	unregisterResource(_keyframeRegistry, _keyframeAnims, k, k->getFilename(), &getFilenameKey<KeyframeAnim>);
 }
 
 void ResourceLoader::uncacheLipSync(LipSync *s) {
 	_lipsyncs.remove(s);
+	unregisterResource(_lipsyncRegistry, _lipsyncs, s, s->getFilename(), &getFilenameKey<LipSync>);
 }
 
 void ResourceLoader::uncacheAnimationEmi(AnimationEmi *a) {
 	_emiAnims.remove(a);
+	unregisterResource(_emiAnimRegistry, _emiAnims, a, a->getFilename(), &getFilenameKey<AnimationEmi>);
 }
 
-ModelPtr ResourceLoader::getModel(const Common::String &fname, CMap *c) {
-	Common::String filename = fname;
-	filename.toLowercase();
+void ResourceLoader::releaseRenderData() {
+	for (Common::List<Model *>::const_iterator i = _models.begin(); i != _models.end(); ++i) {
+		Model *m = *i;
+		for (int j = 0; j < m->_numHierNodes; ++j) {
+			Mesh *mesh = m->_rootHierNode[j]._mesh;
+			if (mesh) {
+				g_driver->destroyMesh(mesh);
+				mesh->_userData = nullptr;
+			}
+		}
+	}
+	for (Common::List<EMIModel *>::const_iterator i = _emiModels.begin(); i != _emiModels.end(); ++i) {
+		g_driver->destroyEMIModel(*i);
+	}
+}
+
+void ResourceLoader::restoreRenderData() {
 	for (Common::List<Model *>::const_iterator i = _models.begin(); i != _models.end(); ++i) {
 		Model *m = *i;
-		if (filename == m->getFilename() && *m->getCMap() == *c) {
-			return m;
+		for (int j = 0; j < m->_numHierNodes; ++j) {
+			Mesh *mesh = m->_rootHierNode[j]._mesh;
+			if (mesh) {
+				g_driver->createMesh(mesh);
+			}
 		}
 	}
+	for (Common::List<EMIModel *>::const_iterator i = _emiModels.begin(); i != _emiModels.end(); ++i) {
+		EMIModel *m = *i;
+		g_driver->createEMIModel(m);
+		// The skinned vertices are only uploaded when the skeleton moves
+		g_driver->updateEMIModel(m);
+		m->updateSpecialtyTextures();
+	}
+}
+
+ModelPtr ResourceLoader::getModel(const Common::String &fname, CMap *c) {
+	Common::String filename = fname;
+	filename.toLowercase();
+	Model *m = _modelRegistry.find(getModelKey(filename, c));
+	if (m)
+		return m;
 
 	return loadModel(fname, c);
 }
@@ -565,12 +712,9 @@ ModelPtr ResourceLoader::getModel(const Common::String &fname, CMap *c) {
 CMapPtr ResourceLoader::getColormap(const Common::String &fname) {
 	Common::String filename = fname;
 	filename.toLowercase();
-	for (Common::List<CMap *>::const_iterator i = _colormaps.begin(); i != _colormaps.end(); ++i) {
-		CMap *c = *i;
-		if (filename.equals(c->_fname)) {
-			return c;
-		}
-	}
+	CMap *c = _colormapRegistry.find(filename);
+	if (c)
+		return c;
 
 	return loadColormap(fname);
 }
@@ -578,12 +722,9 @@ CMapPtr ResourceLoader::getColormap(const Common::String &fname) {
 KeyframeAnimPtr ResourceLoader::getKeyframe(const Common::String &fname) {
 	Common::String filename = fname;
 	filename.toLowercase();
-	for (Common::List<KeyframeAnim *>::const_iterator i = _keyframeAnims.begin(); i != _keyframeAnims.end(); ++i) {
-		KeyframeAnim *k = *i;
-		if (filename == k->getFilename()) {
-			return k;
-		}
-	}
+	KeyframeAnim *k = _keyframeRegistry.find(filename);
+	if (k)
+		return k;
 
 	return loadKeyframe(fname);
 }
@@ -591,12 +732,9 @@ KeyframeAnimPtr ResourceLoader::getKeyframe(const Common::String &fname) {
 LipSyncPtr ResourceLoader::getLipSync(const Common::String &fname) {
 	Common::String filename = fname;
 	filename.toLowercase();
-	for (Common::List<LipSync *>::const_iterator i = _lipsyncs.begin(); i != _lipsyncs.end(); ++i) {
-		LipSync *l = *i;
-		if (filename == l->getFilename()) {
-			return l;
-		}
-	}
+	LipSync *l = _lipsyncRegistry.find(filename);
+	if (l)
+		return l;
 
 	return loadLipSync(fname);
 }
@@ -604,12 +742,9 @@ LipSyncPtr ResourceLoader::getLipSync(const Common::String &fname) {
 AnimationEmiPtr ResourceLoader::getAnimationEmi(const Common::String &fname) {
 	Common::String filename = fname;
 	filename.toLowercase();
-	for (Common::List<AnimationEmi *>::const_iterator i = _emiAnims.begin(); i != _emiAnims.end(); ++i) {
-		AnimationEmi *a = *i;
-		if (filename == a->getFilename()) {
-			return a;
-		}
-	}
+	AnimationEmi *a = _emiAnimRegistry.find(filename);
+	if (a)
+		return a;
 
 	return loadAnimationEmi(fname);
 }
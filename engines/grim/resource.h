@@ -25,6 +25,10 @@
 
 #include "common/archive.h"
 #include "common/array.h"
+#include "common/hashmap.h"
+#include "common/hash-str.h"
+#include "common/list.h"
+#include "common/ptr.h"
 
 #include "engines/grim/object.h"
 
@@ -55,6 +59,58 @@ typedef ObjectPtr<Font> FontPtr;
 typedef ObjectPtr<LipSync> LipSyncPtr;
 typedef ObjectPtr<AnimationEmi> AnimationEmiPtr;
 
+/**
+ * Index of loaded resources by name, used to find the ones that can be shared
+ * without going through the whole list of them. The resources are still owned
+ * by their lists. If more resources have the same name, the first one that was
+ * added is found.
+ */
+template<class T>
+class ResourceRegistry {
+public:
+	ResourceRegistry() : _hits(0), _misses(0) {}
+
+	T *find(const Common::String &key) {
+		typename Map::const_iterator i = _map.find(key);
+		if (i == _map.end()) {
+			++_misses;
+			return nullptr;
+		}
+		++_hits;
+		return i->_value;
+	}
+
+	void add(const Common::String &key, T *res) {
+		if (!_map.contains(key))
+			_map[key] = res;
+	}
+
+	/**
+	 * Remove res from the index. Return true if it was the one found with
+	 * key, so that the caller can add another resource with the same name.
+	 */
+	bool remove(const Common::String &key, T *res) {
+		typename Map::iterator i = _map.find(key);
+		if (i == _map.end() || i->_value != res)
+			return false;
+		_map.erase(i);
+		return true;
+	}
+
+	void clear() { _map.clear(); }
+
+	uint size() const { return _map.size(); }
+	uint32 getHits() const { return _hits; }
+	uint32 getMisses() const { return _misses; }
+
+private:
+	typedef Common::HashMap<Common::String, T *> Map;
+
+	Map _map;
+	uint32 _hits;
+	uint32 _misses;
+};
+
 class ResourceLoader {
 public:
 	ResourceLoader();
@@ -79,29 +135,80 @@ public:
 	LipSyncPtr getLipSync(const Common::String &fname);
 	AnimationEmiPtr getAnimationEmi(const Common::String &fname);
 	void uncacheModel(Model *m);
+	/**
+	 * Find the model with its current colormap, after it was found with the
+	 * key oldKey until now.
+	 */
+	void rekeyModel(Model *m, const Common::String &oldKey);
+	void uncacheEMIModel(EMIModel *m);
 	void uncacheColormap(CMap *c);
 	void uncacheKeyframe(KeyframeAnim *kf);
 	void uncacheLipSync(LipSync *l);
 	void uncacheAnimationEmi(AnimationEmi *a);
 
-	struct ResourceCache {
-		char *fname;
-		byte *resPtr;
-		uint32 len;
-	};
+	/**
+	 * Get the counters of the cache used by openNewStreamFile(). The counters
+	 * are kept from the start of the engine. inflatedBytesSaved adds up the
+	 * inflated size of the compressed files, once for every hit that did not
+	 * have to inflate them again.
+	 */
+	void getCacheCounters(uint32 &hits, uint32 &misses, uint32 &evictions, uint64 &inflatedBytesSaved) const;
+	uint32 getCacheMemorySize() const { return _cacheMemorySize; }
+	uint32 getCacheMemoryBudget() const { return _cacheMemoryBudget; }
+
+	const ResourceRegistry<Model> &getModelRegistry() const { return _modelRegistry; }
+	const ResourceRegistry<CMap> &getColormapRegistry() const { return _colormapRegistry; }
+	const ResourceRegistry<KeyframeAnim> &getKeyframeRegistry() const { return _keyframeRegistry; }
+	const ResourceRegistry<LipSync> &getLipSyncRegistry() const { return _lipsyncRegistry; }
+	const ResourceRegistry<AnimationEmi> &getAnimationEmiRegistry() const { return _emiAnimRegistry; }
+
+	/**
+	 * Get the key with which a model with the given name and colormap is found.
+	 * Colormaps are the same if they have the same name, see CMap::operator==.
+	 */
+	static Common::String getModelKey(const Common::String &fname, const CMap *c);
 
 	static Common::String fixFilename(const Common::String &filename, bool append = true);
 
+	/**
+	 * Release the renderer side of the loaded models before the renderer is
+	 * changed. restoreRenderData() creates it again with the new renderer.
+	 */
+	void releaseRenderData();
+	void restoreRenderData();
+
 private:
 	Common::SeekableReadStream *loadFile(const Common::String &filename) const;
 	Common::SeekableReadStream *getFileFromCache(const Common::String &filename) const;
-	ResourceLoader::ResourceCache *getEntryFromCache(const Common::String &filename) const;
-	void putIntoCache(const Common::String &fname, byte *res, uint32 len) const;
+	Common::SeekableReadStream *putIntoCache(const Common::String &fname, byte *res, uint32 len) const;
 	void uncache(const char *fname) const;
+	void removeFromCache(const Common::String &fname) const;
+
+	/**
+	 * The cached files are kept in a hash map, and a list keeps their names
+	 * from the most to the least recently used. When the files take more than
+	 * the budget, the least recently used ones are dropped. The streams that
+	 * are still reading a dropped file keep its data alive.
+	 * Compressed files are kept inflated, unless they are too big for that.
+	 */
+	struct ResourceCache {
+		Common::SharedPtr<byte> resPtr;
+		uint32 len;
+		bool compressed;
+		// Whether the data was inflated from a compressed file
+		bool inflated;
+		Common::List<Common::String>::iterator lruPos;
+	};
+	typedef Common::HashMap<Common::String, ResourceCache> ResourceCacheMap;
 
-	mutable Common::Array<ResourceCache> _cache;
-	mutable bool _cacheDirty;
-	mutable int32 _cacheMemorySize;
+	mutable ResourceCacheMap _cache;
+	mutable Common::List<Common::String> _cacheLRU;
+	mutable uint32 _cacheMemorySize;
+	uint32 _cacheMemoryBudget;
+	mutable uint32 _cacheHits;
+	mutable uint32 _cacheMisses;
+	mutable uint32 _cacheEvictions;
+	mutable uint64 _cacheInflatedBytesSaved;
 
 	Common::List<EMIModel *> _emiModels;
 	Common::List<Model *> _models;
@@ -109,6 +216,12 @@ private:
 	Common::List<KeyframeAnim *> _keyframeAnims;
 	Common::List<LipSync *> _lipsyncs;
 	Common::List<AnimationEmi *> _emiAnims;
+
+	ResourceRegistry<Model> _modelRegistry;
+	ResourceRegistry<CMap> _colormapRegistry;
+	ResourceRegistry<KeyframeAnim> _keyframeRegistry;
+	ResourceRegistry<LipSync> _lipsyncRegistry;
+	ResourceRegistry<AnimationEmi> _emiAnimRegistry;
 };
 
 extern ResourceLoader *g_resourceloader;
@@ -26,6 +26,19 @@
 
 namespace Myst3 {
 
+/**
+ * Stream of a resource of a mapped archive, which reads the mapping directly
+ * and keeps it mapped for as long as it is used.
+ */
+class MappedResourceStream : public Common::MemoryReadStream {
+public:
+	MappedResourceStream(const Common::SharedPtr<Common::MemoryReadStream> &mapped, uint32 offset, uint32 size) :
+		Common::MemoryReadStream(mapped->getData() + offset, size), _mapped(mapped) {}
+
+private:
+	Common::SharedPtr<Common::MemoryReadStream> _mapped;
+};
+
 void Archive::_decryptHeader(Common::SeekableReadStream &inStream, Common::WriteStream &outStream) {
 	static const uint32 addKey = 0x3C6EF35F;
 	static const uint32 multKey = 0x0019660D;
@@ -55,7 +68,10 @@ void Archive::_decryptHeader(Common::SeekableReadStream &inStream, Common::Write
 
 void Archive::_readDirectory() {
 	Common::MemoryWriteStreamDynamic buf(DisposeAfterUse::YES);
-	_decryptHeader(_file, buf);
+	if (_mapped)
+		_decryptHeader(*_mapped, buf);
+	else
+		_decryptHeader(_file, buf);
 
 	Common::MemoryReadStream directory(buf.getData(), buf.size());
 	directory.skip(sizeof(uint32));
@@ -74,11 +90,26 @@ void Archive::_readDirectory() {
 
 void Archive::dumpToFiles() {
 	for (uint i = 0; i < _directory.size(); i++) {
-		_directory[i].dumpToFiles(_file);
+		if (_mapped)
+			_directory[i].dumpToFiles(*_mapped);
+		else
+			_directory[i].dumpToFiles(_file);
 	}
 }
 
 Common::MemoryReadStream *Archive::dumpToMemory(uint32 offset, uint32 size) {
+	if (_mapped) {
+		// Like reading the file, only give what there is of a resource
+		// that goes past the end of the archive
+		uint32 archiveSize = _mapped->size();
+		if (offset > archiveSize || size > archiveSize - offset) {
+			warning("Resource at offset %d past the end of the archive", offset);
+			offset = MIN(offset, archiveSize);
+			size = archiveSize - offset;
+		}
+		return new MappedResourceStream(_mapped, offset, size);
+	}
+
 	_file.seek(offset);
 	return static_cast<Common::MemoryReadStream *>(_file.readStream(size));
 }
@@ -102,6 +133,13 @@ bool Archive::open(const char *fileName, const char *room) {
 	if (!_multipleRoom)
 		Common::strlcpy(_roomName, room, sizeof(_roomName));
 
+	Common::MemoryReadStream *mapped = Common::File::createMappedReadStream(fileName);
+	if (mapped) {
+		_mapped = Common::SharedPtr<Common::MemoryReadStream>(mapped);
+		_readDirectory();
+		return true;
+	}
+
 	if (_file.open(fileName)) {
 		_readDirectory();
 		return true;
@@ -113,6 +151,7 @@ bool Archive::open(const char *fileName, const char *room) {
 void Archive::close() {
 	_directory.clear();
 	_file.close();
+	_mapped.reset();
 }
 
 } // End of namespace Myst3
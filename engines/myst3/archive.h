@@ -27,6 +27,7 @@
 #include "common/stream.h"
 #include "common/array.h"
 #include "common/file.h"
+#include "common/ptr.h"
 
 namespace Myst3 {
 
@@ -35,6 +36,8 @@ private:
 	bool _multipleRoom;
 	char _roomName[5];
 	Common::File _file;
+	// The archive mapped in memory, when the backend supports it
+	Common::SharedPtr<Common::MemoryReadStream> _mapped;
 	Common::Array<DirectoryEntry> _directory;
 
 	void _decryptHeader(Common::SeekableReadStream &inStream, Common::WriteStream &outStream);
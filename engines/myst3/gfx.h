@@ -55,6 +55,7 @@ class Renderer {
 	virtual void initFont(const Graphics::Surface *surface) = 0;
 
 	virtual void clear() = 0;
+	virtual void flipBuffer() { }
 	virtual void setupCameraOrtho2D() = 0;
 	virtual void setupCameraPerspective(float pitch, float heading, float fov) = 0;
 
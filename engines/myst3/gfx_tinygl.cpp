@@ -26,6 +26,7 @@
 #undef ARRAYSIZE
 #endif
 
+#include "common/config-manager.h"
 #include "common/rect.h"
 #include "common/textconsole.h"
 
@@ -89,10 +90,19 @@ Renderer *CreateGfxTinyGL(OSystem *system) {
 TinyGLRenderer::TinyGLRenderer(OSystem *system) :
 		BaseRenderer(system),
 		_nonPowerOfTwoTexSupport(false),
-		_fb(NULL) {
+		_fb(NULL),
+		_context(NULL) {
 }
 
 TinyGLRenderer::~TinyGLRenderer() {
+	// The textures belong to the context, release them while it still exists
+	if (_font) {
+		freeTexture(_font);
+		_font = NULL;
+	}
+
+	TinyGL::destroyContext(_context);
+	delete _fb;
 }
 
 Texture *TinyGLRenderer::createTexture(const Graphics::Surface *surface) {
@@ -110,7 +120,11 @@ void TinyGLRenderer::init(Graphics::PixelBuffer &screenBuffer) {
 	_nonPowerOfTwoTexSupport = true;
 
 	_fb = new TinyGL::FrameBuffer(kOriginalWidth, kOriginalHeight, screenBuffer);
-	TinyGL::glInit(_fb, 512);
+	// Large enough for the 640x640 cube faces to be used without scaling
+	_context = TinyGL::createContext(_fb, 1024);
+	TinyGL::setCurrentContext(_context);
+	if (ConfMan.getInt("tinygl_threads") != 0)
+		_fb->enableTiledRasterization(true, ConfMan.getInt("tinygl_threads"));
 
 	tglMatrixMode(TGL_PROJECTION);
 	tglLoadIdentity();
@@ -128,6 +142,10 @@ void TinyGLRenderer::clear() {
 	tglColor3f(1.0f, 1.0f, 1.0f);
 }
 
+void TinyGLRenderer::flipBuffer() {
+	tglFlush();
+}
+
 void TinyGLRenderer::setupCameraOrtho2D() {
 	tglViewport(0, 0, kOriginalWidth, kOriginalHeight);
 	tglMatrixMode(TGL_PROJECTION);
@@ -176,6 +194,7 @@ void TinyGLRenderer::drawRect2D(const Common::Rect &rect, uint32 color) {
 		tglBlendFunc(TGL_SRC_ALPHA, TGL_ONE_MINUS_SRC_ALPHA);
 	}
 
+	tglFlush();
 	for (int x = rect.left; x < rect.right; x++) {
 		for (int y = rect.top; y < rect.bottom; y++) {
 			_fb->writePixel(y * kOriginalWidth + x, a, r, g, b);
@@ -349,6 +368,8 @@ void TinyGLRenderer::blitScreen(Texture *texture, int dstX, int dstY, int srcX,
 	if (dstX >= screenWidth || dstY >= screenHeight)
 		return;
 
+	tglFlush();
+
 	int clampWidth, clampHeight;
 
 	if (dstX + width > screenWidth)
@@ -40,6 +40,7 @@ public:
 	virtual void init(Graphics::PixelBuffer &screenBuffer) override;
 
 	virtual void clear() override;
+	virtual void flipBuffer() override;
 	virtual void setupCameraOrtho2D() override;
 	virtual void setupCameraPerspective(float pitch, float heading, float fov) override;
 
@@ -65,6 +66,7 @@ private:
 	void blitScreen(Texture *texture, int dstX, int dstY, int srcX, int srcY, int width, int height, float transparency, bool invertY = false);
 
 	TinyGL::FrameBuffer *_fb;
+	TinyGL::GLContext *_context;
 	int _cubeViewport[4];
 	float _cubeProjectionMatrix[16];
 	float _cubeModelViewMatrix[16];
@@ -602,6 +602,7 @@ void Myst3Engine::drawFrame(bool noSwap) {
 		_cursor->draw();
 
 	if (!noSwap) {
+		_gfx->flipBuffer();
 		_system->updateScreen();
 		_system->delayMillis(10);
 		_state->updateFrameCounters();
@@ -1526,6 +1527,7 @@ void Myst3Engine::settingsInitDefaults() {
 	ConfMan.registerDefault("text_language", defaultTextLanguage);
 	ConfMan.registerDefault("water_effects", true);
 	ConfMan.registerDefault("transition_speed", 50);
+	ConfMan.registerDefault("tinygl_threads", 0);
 	ConfMan.registerDefault("mouse_speed", 50);
 	ConfMan.registerDefault("zip_mode", false);
 	ConfMan.registerDefault("subtitles", false);
@@ -50,6 +50,7 @@ MODULE_OBJS := \
 	tinygl/zbuffer.o \
 	tinygl/zline.o \
 	tinygl/zmath.o \
+	tinygl/ztiles.o \
 	tinygl/ztriangle.o \
 
 ifdef USE_SCALERS
@@ -112,6 +112,13 @@ public:
 			glUniform1f(pos, f);
 	}
 
+	// Set count consecutive elements of a vec4 array
+	void setUniform4fv(const char *uniform, int count, const float *v) {
+		GLint pos = getUniformLocation(uniform);
+		if (pos != -1)
+			glUniform4fv(pos, count, v);
+	}
+
 
 	GLint getUniformLocation(const char *uniform) const {
 		UniformsMap::iterator kv = _uniforms->find(uniform);
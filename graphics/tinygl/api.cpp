@@ -532,6 +532,20 @@ void tglTexImage2D(int target, int level, int components, int width, int height,
 	TinyGL::gl_add_op(p);
 }
 
+void tglColorTable(int target, int internalformat, int width, int format, int type, const void *table) {
+	TinyGL::GLParam p[7];
+
+	p[0].op = TinyGL::OP_ColorTable;
+	p[1].i = target;
+	p[2].i = internalformat;
+	p[3].i = width;
+	p[4].i = format;
+	p[5].i = type;
+	p[6].p = const_cast<void *>(table);
+
+	TinyGL::gl_add_op(p);
+}
+
 void tglBindTexture(int target, int texture) {
 	TinyGL::GLParam p[3];
 
@@ -640,7 +654,8 @@ void tglCallList(unsigned int list) {
 }
 
 void tglFlush() {
-	// nothing to do
+	TinyGL::GLContext *c = TinyGL::gl_get_context();
+	c->fb->flushTiles();
 }
 
 void tglHint(int target, int mode) {
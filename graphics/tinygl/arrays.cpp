@@ -1,4 +1,3 @@
-
 #include "graphics/tinygl/zgl.h"
 
 #define VERTEX_ARRAY    0x0001
@@ -8,19 +7,23 @@
 
 namespace TinyGL {
 
-void glopArrayElement(GLContext *c, GLParam *param) {
+// set the current color, normal and texture coordinates from the enabled arrays
+static void gl_load_array_attributes(GLContext *c, int idx) {
 	int i;
 	int states = c->client_states;
-	int idx = param[1].i;
 
 	if (states & COLOR_ARRAY) {
-		GLParam p[5];
+		GLParam p[9];
 		int size = c->color_array_size;
 		i = idx * (size + c->color_array_stride);
 		p[1].f = c->color_array[i];
 		p[2].f = c->color_array[i + 1];
 		p[3].f = c->color_array[i + 2];
 		p[4].f = size > 3 ? c->color_array[i + 3] : 1.0f;
+		p[5].ui = (unsigned int)(p[1].f * (ZB_POINT_RED_MAX - ZB_POINT_RED_MIN) + ZB_POINT_RED_MIN);
+		p[6].ui = (unsigned int)(p[2].f * (ZB_POINT_GREEN_MAX - ZB_POINT_GREEN_MIN) + ZB_POINT_GREEN_MIN);
+		p[7].ui = (unsigned int)(p[3].f * (ZB_POINT_BLUE_MAX - ZB_POINT_BLUE_MIN) + ZB_POINT_BLUE_MIN);
+		p[8].ui = (unsigned int)(p[4].f * (ZB_POINT_ALPHA_MAX - ZB_POINT_ALPHA_MIN) + ZB_POINT_ALPHA_MIN);
 		glopColor(c, p);
 	}
 	if (states & NORMAL_ARRAY) {
@@ -38,32 +41,274 @@ void glopArrayElement(GLContext *c, GLParam *param) {
 		c->current_tex_coord.Z = size > 2 ? c->texcoord_array[i + 2] : 0.0f;
 		c->current_tex_coord.W = size > 3 ? c->texcoord_array[i + 3] : 1.0f;
 	}
-	if (states & VERTEX_ARRAY) {
+}
+
+static void gl_load_array_vertex(GLContext *c, int idx, Vector4 &coord) {
+	int size = c->vertex_array_size;
+	int i = idx * (size + c->vertex_array_stride);
+	coord.X = c->vertex_array[i];
+	coord.Y = c->vertex_array[i + 1];
+	coord.Z = size > 2 ? c->vertex_array[i + 2] : 0.0f;
+	coord.W = size > 3 ? c->vertex_array[i + 3] : 1.0f;
+}
+
+void glopArrayElement(GLContext *c, GLParam *param) {
+	int idx = param[1].i;
+
+	gl_load_array_attributes(c, idx);
+	if (c->client_states & VERTEX_ARRAY) {
 		GLParam p[5];
-		int size = c->vertex_array_size;
-		i = idx * (size + c->vertex_array_stride);
-		p[1].f = c->vertex_array[i];
-		p[2].f = c->vertex_array[i + 1];
-		p[3].f = size > 2 ? c->vertex_array[i + 2] : 0.0f;
-		p[4].f = size > 3 ? c->vertex_array[i + 3] : 1.0f;
+		Vector4 coord;
+		gl_load_array_vertex(c, idx, coord);
+		p[1].f = coord.X;
+		p[2].f = coord.Y;
+		p[3].f = coord.Z;
+		p[4].f = coord.W;
 		glopVertex(c, p);
 	}
 }
 
-void glArrayElement(TGLint i) {
+// indices of a glDrawArrays call, relative to the first vertex
+struct SequentialIndices {
+	int operator[](int i) const { return i; }
+};
+
+// indices of a glDrawElements call, relative to the smallest index
+template <typename T>
+struct ElementIndices {
+	ElementIndices(const T *indices, int base) : _indices(indices), _base(base) { }
+	int operator[](int i) const { return _indices[i] - _base; }
+
+	const T *_indices;
+	int _base;
+};
+
+static void gl_reserve_array_vertices(GLContext *c, int n) {
+	if (n <= c->array_vertex_max)
+		return;
+
+	gl_free(c->array_vertex);
+	gl_free(c->array_vertex_stamp);
+	c->array_vertex = (GLVertex *)gl_malloc(sizeof(GLVertex) * n);
+	c->array_vertex_stamp = (unsigned int *)gl_zalloc(sizeof(unsigned int) * n);
+	if (!c->array_vertex || !c->array_vertex_stamp) {
+		error("unable to allocate GLVertex array.");
+	}
+	c->array_vertex_max = n;
+	c->array_stamp = 0;
+}
+
+// each vertex referenced by a call is transformed on first use only, and
+// then shared by all the triangles using it
+static GLVertex *gl_array_vertex(GLContext *c, int idx, int first, int &current) {
+	GLVertex *v = &c->array_vertex[idx];
+	if (c->array_vertex_stamp[idx] != c->array_stamp) {
+		c->array_vertex_stamp[idx] = c->array_stamp;
+		gl_load_array_attributes(c, first + idx);
+		gl_load_array_vertex(c, first + idx, v->coord);
+		gl_process_vertex(c, v);
+		current = idx;
+	}
+	return v;
+}
+
+// glBegin / glEnd draw with the attributes of the last vertex sent as the
+// current ones, and the clipper uses them for the vertices it creates
+static void gl_array_current(GLContext *c, int idx, int first, int &current) {
+	if (current != idx) {
+		gl_load_array_attributes(c, first + idx);
+		current = idx;
+	}
+}
+
+// draws the same triangles, with the same vertex order, as glBegin / glEnd
+template <typename Indices>
+static void gl_draw_arrays(GLContext *c, int mode, int count, int first, int numVertices, const Indices &indices) {
 	GLParam p[2];
-	p[0].op = OP_ArrayElement;
-	p[1].i = i;
-	gl_add_op(p);
+	p[1].i = mode;
+	glopBegin(c, p);
+
+	switch (mode) {
+	case TGL_TRIANGLES:
+	case TGL_TRIANGLE_STRIP:
+	case TGL_TRIANGLE_FAN:
+	case TGL_POLYGON:
+		break;
+	default:
+		// other primitives are rarely used, let glBegin / glEnd assemble them
+		for (int i = 0; i < count; i++) {
+			p[1].i = first + indices[i];
+			glopArrayElement(c, p);
+		}
+		glopEnd(c, p);
+		return;
+	}
+
+	gl_reserve_array_vertices(c, numVertices);
+	if (++c->array_stamp == 0) {
+		memset(c->array_vertex_stamp, 0, sizeof(unsigned int) * c->array_vertex_max);
+		c->array_stamp = 1;
+	}
+
+	int current = -1;
+	GLVertex *v[3];
+	switch (mode) {
+	case TGL_TRIANGLES:
+		for (int i = 0; i + 2 < count; i += 3) {
+			v[0] = gl_array_vertex(c, indices[i], first, current);
+			v[1] = gl_array_vertex(c, indices[i + 1], first, current);
+			v[2] = gl_array_vertex(c, indices[i + 2], first, current);
+			gl_array_current(c, indices[i + 2], first, current);
+			gl_draw_triangle(c, v[0], v[1], v[2]);
+		}
+		break;
+	case TGL_TRIANGLE_STRIP:
+		for (int i = 2; i < count; i++) {
+			// glVertex keeps the last three vertices in a ring buffer
+			v[(i - 2) % 3] = gl_array_vertex(c, indices[i - 2], first, current);
+			v[(i - 1) % 3] = gl_array_vertex(c, indices[i - 1], first, current);
+			v[i % 3] = gl_array_vertex(c, indices[i], first, current);
+			gl_array_current(c, indices[i], first, current);
+			// needed to respect triangle orientation
+			if (i & 1)
+				gl_draw_triangle(c, v[2], v[1], v[0]);
+			else
+				gl_draw_triangle(c, v[0], v[1], v[2]);
+		}
+		break;
+	case TGL_TRIANGLE_FAN:
+		for (int i = 2; i < count; i++) {
+			v[0] = gl_array_vertex(c, indices[0], first, current);
+			v[1] = gl_array_vertex(c, indices[i - 1], first, current);
+			v[2] = gl_array_vertex(c, indices[i], first, current);
+			gl_array_current(c, indices[i], first, current);
+			gl_draw_triangle(c, v[0], v[1], v[2]);
+		}
+		break;
+	case TGL_POLYGON:
+		// glEnd only draws once all the vertices are sent
+		for (int i = count - 1; i >= 2; i--) {
+			v[0] = gl_array_vertex(c, indices[i], first, current);
+			v[1] = gl_array_vertex(c, indices[0], first, current);
+			v[2] = gl_array_vertex(c, indices[i - 1], first, current);
+			gl_array_current(c, indices[count - 1], first, current);
+			gl_draw_triangle(c, v[0], v[1], v[2]);
+		}
+		break;
+	}
+
+	c->in_begin = 0;
+}
+
+void glopDrawArrays(GLContext *c, GLParam *p) {
+	int mode = p[1].i;
+	int first = p[2].i;
+	int count = p[3].i;
+
+	if (!(c->client_states & VERTEX_ARRAY) || count <= 0)
+		return;
+
+	gl_draw_arrays(c, mode, count, first, count, SequentialIndices());
+}
+
+template <typename T>
+static void gl_draw_elements(GLContext *c, int mode, int count, const T *indices) {
+	T minIndex = indices[0];
+	T maxIndex = indices[0];
+	for (int i = 1; i < count; i++) {
+		minIndex = MIN(minIndex, indices[i]);
+		maxIndex = MAX(maxIndex, indices[i]);
+	}
+
+	gl_draw_arrays(c, mode, count, minIndex, maxIndex - minIndex + 1, ElementIndices<T>(indices, minIndex));
+}
+
+void glopDrawElements(GLContext *c, GLParam *p) {
+	int mode = p[1].i;
+	int count = p[2].i;
+	int type = p[3].i;
+	const void *indices = p[4].p;
+
+	if (!(c->client_states & VERTEX_ARRAY) || count <= 0)
+		return;
+
+	switch (type) {
+	case TGL_UNSIGNED_BYTE:
+		gl_draw_elements(c, mode, count, (const unsigned char *)indices);
+		break;
+	case TGL_UNSIGNED_SHORT:
+		gl_draw_elements(c, mode, count, (const unsigned short *)indices);
+		break;
+	case TGL_UNSIGNED_INT:
+		gl_draw_elements(c, mode, count, (const unsigned int *)indices);
+		break;
+	default:
+		error("glDrawElements: type %x not handled", type);
+	}
 }
 
 void glopEnableClientState(GLContext *c, GLParam *p) {
 	c->client_states |= p[1].i;
 }
 
-void glEnableClientState(TGLenum array) {
-	GLParam p[2];
-	p[0].op = OP_EnableClientState;
+void glopDisableClientState(GLContext *c, GLParam *p) {
+	c->client_states &= p[1].i;
+}
+
+void glopVertexPointer(GLContext *c, GLParam *p) {
+	c->vertex_array_size = p[1].i;
+	c->vertex_array_stride = p[2].i;
+	c->vertex_array = (float *)p[3].p;
+}
+
+void glopColorPointer(GLContext *c, GLParam *p) {
+	c->color_array_size = p[1].i;
+	c->color_array_stride = p[2].i;
+	c->color_array = (float *)p[3].p;
+}
+
+void glopNormalPointer(GLContext *c, GLParam *p) {
+	c->normal_array_stride = p[1].i;
+	c->normal_array = (float *)p[2].p;
+}
+
+void glopTexCoordPointer(GLContext *c, GLParam *p) {
+	c->texcoord_array_size = p[1].i;
+	c->texcoord_array_stride = p[2].i;
+	c->texcoord_array = (float *)p[3].p;
+}
+
+} // end of namespace TinyGL
+
+void tglArrayElement(TGLint i) {
+	TinyGL::GLParam p[2];
+	p[0].op = TinyGL::OP_ArrayElement;
+	p[1].i = i;
+	TinyGL::gl_add_op(p);
+}
+
+void tglDrawArrays(TGLenum mode, TGLint first, TGLsizei count) {
+	TinyGL::GLParam p[4];
+	p[0].op = TinyGL::OP_DrawArrays;
+	p[1].i = mode;
+	p[2].i = first;
+	p[3].i = count;
+	TinyGL::gl_add_op(p);
+}
+
+void tglDrawElements(TGLenum mode, TGLsizei count, TGLenum type, const TGLvoid *indices) {
+	TinyGL::GLParam p[5];
+	p[0].op = TinyGL::OP_DrawElements;
+	p[1].i = mode;
+	p[2].i = count;
+	p[3].i = type;
+	p[4].p = const_cast<void *>(indices);
+	TinyGL::gl_add_op(p);
+}
+
+void tglEnableClientState(TGLenum array) {
+	TinyGL::GLParam p[2];
+	p[0].op = TinyGL::OP_EnableClientState;
 
 	switch (array) {
 	case TGL_VERTEX_ARRAY:
@@ -82,16 +327,12 @@ void glEnableClientState(TGLenum array) {
 		assert(0);
 		break;
 	}
-	gl_add_op(p);
+	TinyGL::gl_add_op(p);
 }
 
-void glopDisableClientState(GLContext *c, GLParam *p) {
-	c->client_states &= p[1].i;
-}
-
-void glDisableClientState(TGLenum array) {
-	GLParam p[2];
-	p[0].op = OP_DisableClientState;
+void tglDisableClientState(TGLenum array) {
+	TinyGL::GLParam p[2];
+	p[0].op = TinyGL::OP_DisableClientState;
 
 	switch (array) {
 	case TGL_VERTEX_ARRAY:
@@ -110,69 +351,44 @@ void glDisableClientState(TGLenum array) {
 		assert(0);
 		break;
 	}
-	gl_add_op(p);
+	TinyGL::gl_add_op(p);
 }
 
-void glopVertexPointer(GLContext *c, GLParam *p) {
-	c->vertex_array_size = p[1].i;
-	c->vertex_array_stride = p[2].i;
-	c->vertex_array = (float *)p[3].p;
-}
-
-void  glVertexPointer(TGLint size, TGLenum type, TGLsizei stride, const TGLvoid *pointer) {
-	GLParam p[4];
+void tglVertexPointer(TGLint size, TGLenum type, TGLsizei stride, const TGLvoid *pointer) {
+	TinyGL::GLParam p[4];
 	assert(type == TGL_FLOAT);
-	p[0].op = OP_VertexPointer;
+	p[0].op = TinyGL::OP_VertexPointer;
 	p[1].i = size;
 	p[2].i = stride;
 	p[3].p = const_cast<void *>(pointer);
-	gl_add_op(p);
-}
-
-void glopColorPointer(GLContext *c, GLParam *p) {
-	c->color_array_size = p[1].i;
-	c->color_array_stride = p[2].i;
-	c->color_array = (float *)p[3].p;
+	TinyGL::gl_add_op(p);
 }
 
-void  glColorPointer(TGLint size, TGLenum type, TGLsizei stride, const TGLvoid *pointer) {
-	GLParam p[4];
+void tglColorPointer(TGLint size, TGLenum type, TGLsizei stride, const TGLvoid *pointer) {
+	TinyGL::GLParam p[4];
 	assert(type == TGL_FLOAT);
-	p[0].op = OP_ColorPointer;
+	p[0].op = TinyGL::OP_ColorPointer;
 	p[1].i = size;
 	p[2].i = stride;
 	p[3].p = const_cast<void *>(pointer);
-	gl_add_op(p);
-}
-
-void glopNormalPointer(GLContext *c, GLParam *p) {
-	c->normal_array_stride = p[1].i;
-	c->normal_array = (float *)p[2].p;
+	TinyGL::gl_add_op(p);
 }
 
-void glNormalPointer(TGLenum type, TGLsizei stride, const TGLvoid *pointer) {
-	GLParam p[3];
+void tglNormalPointer(TGLenum type, TGLsizei stride, const TGLvoid *pointer) {
+	TinyGL::GLParam p[3];
 	assert(type == TGL_FLOAT);
-	p[0].op = OP_NormalPointer;
+	p[0].op = TinyGL::OP_NormalPointer;
 	p[1].i = stride;
 	p[2].p = const_cast<void *>(pointer);
-	gl_add_op(p);
+	TinyGL::gl_add_op(p);
 }
 
-void glopTexCoordPointer(GLContext *c, GLParam *p) {
-	c->texcoord_array_size = p[1].i;
-	c->texcoord_array_stride = p[2].i;
-	c->texcoord_array = (float *)p[3].p;
-}
-
-void glTexCoordPointer(TGLint size, TGLenum type, TGLsizei stride, const TGLvoid *pointer) {
-	GLParam p[4];
+void tglTexCoordPointer(TGLint size, TGLenum type, TGLsizei stride, const TGLvoid *pointer) {
+	TinyGL::GLParam p[4];
 	assert(type == TGL_FLOAT);
-	p[0].op = OP_TexCoordPointer;
+	p[0].op = TinyGL::OP_TexCoordPointer;
 	p[1].i = size;
 	p[2].i = stride;
 	p[3].p = const_cast<void *>(pointer);
-	gl_add_op(p);
+	TinyGL::gl_add_op(p);
 }
-
-} // end of namespace TinyGL
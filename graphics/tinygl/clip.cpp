@@ -41,8 +41,9 @@ void gl_transform_to_viewport(GLContext *c, GLVertex *v) {
 
 	// texture
 	if (c->texture_2d_enabled) {
-		v->zp.s = (int)(v->tex_coord.X * (ZB_POINT_ST_MAX - ZB_POINT_ST_MIN) + ZB_POINT_ST_MIN);
-		v->zp.t = (int)(v->tex_coord.Y * (ZB_POINT_ST_MAX - ZB_POINT_ST_MIN) + ZB_POINT_ST_MIN);
+		const GLImage &im = c->current_texture->images[0];
+		v->zp.s = (int)(v->tex_coord.X * (ZB_POINT_ST_MAX(im.xsize) - ZB_POINT_ST_MIN) + ZB_POINT_ST_MIN);
+		v->zp.t = (int)(v->tex_coord.Y * (ZB_POINT_ST_MAX(im.ysize) - ZB_POINT_ST_MIN) + ZB_POINT_ST_MIN);
 	}
 }
 
@@ -397,7 +398,8 @@ void gl_draw_triangle_fill(GLContext *c, GLVertex *p0, GLVertex *p1, GLVertex *p
 #ifdef TINYGL_PROFILE
 		count_triangles_textured++;
 #endif
-		c->fb->setTexture(c->current_texture->images[0].pixmap);
+		const GLImage &im = c->current_texture->images[0];
+		c->fb->setTexture(im.pixmap, im.xsize, im.ysize, c->current_texture->palette);
 		if (c->current_shade_model == TGL_SMOOTH) {
 			c->fb->fillTriangleTextureMappingPerspectiveSmooth(&p0->zp, &p1->zp, &p2->zp);
 		} else {
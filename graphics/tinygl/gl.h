@@ -629,7 +629,11 @@ enum {
 
 	// Color-types from 1.2, from SDL_opengl.h
 	TGL_BGR                         = 0x80E0,
-	TGL_BGRA                        = 0x80E1
+	TGL_BGRA                        = 0x80E1,
+	TGL_UNSIGNED_SHORT_5_6_5        = 0x8363,
+
+	// EXT_paletted_texture
+	TGL_COLOR_INDEX8_EXT            = 0x80E5
 };
 
 enum {
@@ -769,6 +773,8 @@ void tglBindTexture(int target, int texture);
 void tglTexImage2D(int target, int level, int components,
 				   int width, int height, int border,
 				   int format, int type, void *pixels);
+// Palette of TGL_COLOR_INDEX textures, as in EXT_paletted_texture
+void tglColorTable(int target, int internalformat, int width, int format, int type, const void *table);
 void tglTexEnvi(int target, int pname, int param);
 void tglTexParameteri(int target, int pname, int param);
 void tglPixelStorei(int pname, int param);
@@ -797,6 +803,8 @@ void tglBlendFunc(TGLenum sfactor, TGLenum dfactor);
 void tglAlphaFunc(TGLenum func, float ref);
 void tglDepthFunc(TGLenum func);
 
+// buf holds one bit per pixel, least significant bit first, with each row
+// starting on a byte boundary
 void tglSetShadowMaskBuf(unsigned char *buf);
 void tglSetShadowColor(unsigned char r, unsigned char g, unsigned char b);
 
@@ -808,6 +816,8 @@ void tglVertexPointer(TGLint size, TGLenum type, TGLsizei stride, const TGLvoid
 void tglColorPointer(TGLint size, TGLenum type, TGLsizei stride, const TGLvoid *pointer);
 void tglNormalPointer(TGLenum type, TGLsizei stride, const TGLvoid *pointer);
 void tglTexCoordPointer(TGLint size, TGLenum type, TGLsizei stride, const TGLvoid *pointer);
+void tglDrawArrays(TGLenum mode, TGLint first, TGLsizei count);
+void tglDrawElements(TGLenum mode, TGLsizei count, TGLenum type, const TGLvoid *indices);
 
 // opengl 1.2 polygon offset
 void tglPolygonOffset(TGLfloat factor, TGLfloat units);
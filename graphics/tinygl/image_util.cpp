@@ -89,7 +89,7 @@ void gl_resizeImage(unsigned char *dest, int xsize_dest, int ysize_dest,
 
 // resizing with no interlating nor nearest pixel
 void gl_resizeImageNoInterpolate(unsigned char *dest, int xsize_dest, int ysize_dest,
-								 unsigned char *src, int xsize_src, int ysize_src) {
+								 unsigned char *src, int xsize_src, int ysize_src, int bytesPerPixel) {
 	unsigned char *pix, *pix_src, *pix1;
 	int x1, y1, x1inc, y1inc;
 	int xi, yi;
@@ -106,14 +106,12 @@ void gl_resizeImageNoInterpolate(unsigned char *dest, int xsize_dest, int ysize_
 		for (int x = 0; x < xsize_dest; x++) {
 			xi = x1 >> FRAC_BITS;
 			yi = y1 >> FRAC_BITS;
-			pix1 = pix_src + (yi * xsize_src + xi) * 4;
+			pix1 = pix_src + (yi * xsize_src + xi) * bytesPerPixel;
 
-			pix[0] = pix1[0];
-			pix[1] = pix1[1];
-			pix[2] = pix1[2];
-			pix[3] = pix1[3];
+			for (int i = 0; i < bytesPerPixel; i++)
+				pix[i] = pix1[i];
 
-			pix += 4;
+			pix += bytesPerPixel;
 			x1 += x1inc;
 		}
 		y1 += y1inc;
@@ -1,9 +1,52 @@
 
+#define FORBIDDEN_SYMBOL_EXCEPTION_time_h
+
 #include "graphics/tinygl/zgl.h"
 
+#if defined(USE_PTHREADS)
+#include <pthread.h>
+#endif
+
 namespace TinyGL {
 
-GLContext *gl_ctx;
+// Each thread draws with its own current context, so that several contexts
+// can be used at the same time from different threads.
+#if defined(USE_PTHREADS)
+
+static pthread_key_t currentContextKey;
+static pthread_once_t currentContextKeyOnce = PTHREAD_ONCE_INIT;
+static bool currentContextKeyCreated = false;
+
+static void createCurrentContextKey() {
+	if (pthread_key_create(&currentContextKey, NULL) != 0)
+		error("TinyGL: Could not create the current context key");
+	currentContextKeyCreated = true;
+}
+
+void setCurrentContext(GLContext *c) {
+	pthread_once(&currentContextKeyOnce, createCurrentContextKey);
+	pthread_setspecific(currentContextKey, c);
+}
+
+GLContext *gl_get_context() {
+	if (!currentContextKeyCreated)
+		return NULL;
+	return (GLContext *)pthread_getspecific(currentContextKey);
+}
+
+#else
+
+static GLContext *currentContext = NULL;
+
+void setCurrentContext(GLContext *c) {
+	currentContext = c;
+}
+
+GLContext *gl_get_context() {
+	return currentContext;
+}
+
+#endif
 
 void initSharedState(GLContext *c) {
 	GLSharedState *s = &c->shared_state;
@@ -25,24 +68,26 @@ void endSharedState(GLContext *c) {
 	gl_free(s->texture_hash_table);
 }
 
-void glInit(void *zbuffer1, int textureSize) {
-	FrameBuffer *zbuffer = (FrameBuffer *)zbuffer1;
+GLContext *createContext(FrameBuffer *zbuffer, int textureSize) {
 	GLContext *c;
 	GLViewport *v;
 
 	if ((textureSize & (textureSize - 1)))
-		error("glInit: texture size not power of two: %d", textureSize);
+		error("createContext: texture size not power of two: %d", textureSize);
 
 	if (textureSize <= 1 || textureSize > 4096)
-		error("glInit: texture size not allowed: %d", textureSize);
+		error("createContext: texture size not allowed: %d", textureSize);
 
 	c = (GLContext *)gl_zalloc(sizeof(GLContext));
-	gl_ctx = c;
+
+	// The default state below is set through the API, which works on the
+	// current context
+	GLContext *previous = gl_get_context();
+	setCurrentContext(c);
 
 	c->fb = zbuffer;
 
-	c->fb->_textureSize = c->_textureSize = textureSize;
-	c->fb->_textureSizeMask = (textureSize - 1) << ZB_POINT_ST_FRAC_BITS;
+	c->_textureSize = textureSize;
 
 	// allocate GLVertex array
 	c->vertex_max = POLYGON_MAX_VERTEX;
@@ -171,6 +216,10 @@ void glInit(void *zbuffer1, int textureSize) {
 
 	// opengl 1.1 arrays
 	c->client_states = 0;
+	c->array_vertex = NULL;
+	c->array_vertex_stamp = NULL;
+	c->array_stamp = 0;
+	c->array_vertex_max = 0;
 
 	// opengl 1.1 polygon offset
 	c->offset_states = 0;
@@ -190,16 +239,25 @@ void glInit(void *zbuffer1, int textureSize) {
 	c->depth_test = 0;
 
 	c->color_mask = (1 << 24) | (1 << 16) | (1 << 8) | (1 << 0);
+
+	setCurrentContext(previous);
+	return c;
 }
 
-void glClose() {
-	GLContext *c = gl_get_context();
+void destroyContext(GLContext *c) {
+	if (!c)
+		return;
+
+	if (gl_get_context() == c)
+		setCurrentContext(NULL);
 
 	specbuf_cleanup(c);
 	for (int i = 0; i < 3; i++)
 		gl_free(c->matrix_stack[i]);
 	endSharedState(c);
 	gl_free(c->vertex);
+	gl_free(c->array_vertex);
+	gl_free(c->array_vertex_stamp);
 
 	gl_free(c);
 }
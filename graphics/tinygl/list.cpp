@@ -25,10 +25,6 @@ static int op_table_size[] = {
 #include "graphics/tinygl/opinfo.h"
 };
 
-GLContext *gl_get_context() {
-	return gl_ctx;
-}
-
 static GLList *find_list(GLContext *c, unsigned int list) {
 	return c->shared_state.lists[list];
 }
@@ -40,6 +40,7 @@ ADD_OP(PopName, 0, "")
 ADD_OP(LoadName, 1, "%d")
 
 ADD_OP(TexImage2D, 9, "%d %d %d %d %d %d %d %d %d")
+ADD_OP(ColorTable, 6, "%C %C %d %C %C %d")
 ADD_OP(BindTexture, 2, "%C %d")
 ADD_OP(TexEnv, 7, "%C %C %C %f %f %f %f")
 ADD_OP(TexParameter, 7, "%C %C %C %f %f %f %f")
@@ -70,6 +71,8 @@ ADD_OP(VertexPointer, 4, "%d %C %d %p")
 ADD_OP(ColorPointer, 4, "%d %C %d %p")
 ADD_OP(NormalPointer, 3, "%C %d %p")
 ADD_OP(TexCoordPointer, 4, "%d %C %d %p")
+ADD_OP(DrawArrays, 3, "%C %d %d")
+ADD_OP(DrawElements, 4, "%C %d %C %p")
 
 // opengl 1.1 polygon offset
 ADD_OP(PolygonOffset, 2, "%f %f")
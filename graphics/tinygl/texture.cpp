@@ -21,6 +21,9 @@ void free_texture(GLContext *c, int h) {
 	GLTexture *t, **ht;
 	GLImage *im;
 
+	// queued triangles may still sample from this texture
+	c->fb->flushTiles();
+
 	t = find_texture(c, h);
 	if (!t->prev) {
 		ht = &c->shared_state.texture_hash_table[t->handle % TEXTURE_HASH_TABLE_SIZE];
@@ -36,6 +39,8 @@ void free_texture(GLContext *c, int h) {
 		if (im->pixmap)
 			im->pixmap.free();
 	}
+	if (t->palette)
+		t->palette.free();
 
 	gl_free(t);
 }
@@ -78,91 +83,110 @@ void glopBindTexture(GLContext *c, GLParam *p) {
 	c->current_texture = t;
 }
 
-void glopTexImage2D(GLContext *c, GLParam *p) {
-	int target = p[1].i;
-	int level = p[2].i;
-	int components = p[3].i;
-	int width = p[4].i;
-	int height = p[5].i;
-	int border = p[6].i;
-	int format = p[7].i;
-	int type = p[8].i;
-	byte *pixels = (byte *)p[9].p;
-	GLImage *im;
-	byte *pixels1;
-	bool do_free_after_rgb2rgba = false;
-
-	Graphics::PixelFormat sourceFormat;
+static Graphics::PixelFormat getSourceFormat(int format) {
 	switch (format) {
 		case TGL_RGBA:
-			sourceFormat = Graphics::PixelFormat(4, 8, 8, 8, 8, 0, 8, 16, 24);
-			break;
+			return Graphics::PixelFormat(4, 8, 8, 8, 8, 0, 8, 16, 24);
 		case TGL_RGB:
-			sourceFormat = Graphics::PixelFormat(3, 8, 8, 8, 0, 0, 8, 16, 0);
-			break;
+			return Graphics::PixelFormat(3, 8, 8, 8, 0, 0, 8, 16, 0);
 		case TGL_BGRA:
-			sourceFormat = Graphics::PixelFormat(4, 8, 8, 8, 8, 16, 8, 0, 24);
-			break;
+			return Graphics::PixelFormat(4, 8, 8, 8, 8, 16, 8, 0, 24);
 		case TGL_BGR:
-			sourceFormat = Graphics::PixelFormat(3, 8, 8, 8, 0, 16, 8, 0, 0);
-			break;
+			return Graphics::PixelFormat(3, 8, 8, 8, 0, 16, 8, 0, 0);
 		default:
 			error("tglTexImage2D: Pixel format not handled.");
 	}
+}
 
-	Graphics::PixelFormat pf;
+// 32 bit format used to store texels and palette entries given in format
+static Graphics::PixelFormat getStorageFormat(int format) {
 	switch (format) {
 		case TGL_RGBA:
 		case TGL_RGB:
 #if defined(SCUMM_BIG_ENDIAN)
-			pf = Graphics::PixelFormat(4, 8, 8, 8, 8, 24, 16, 8, 0);
+			return Graphics::PixelFormat(4, 8, 8, 8, 8, 24, 16, 8, 0);
 #elif defined(SCUMM_LITTLE_ENDIAN)
-			pf = Graphics::PixelFormat(4, 8, 8, 8, 8, 0, 8, 16, 24);
+			return Graphics::PixelFormat(4, 8, 8, 8, 8, 0, 8, 16, 24);
 #endif
-			break;
 		case TGL_BGRA:
 		case TGL_BGR:
+		default:
 #if defined(SCUMM_BIG_ENDIAN)
-			pf = Graphics::PixelFormat(4, 8, 8, 8, 8, 24, 0, 8, 16);
+			return Graphics::PixelFormat(4, 8, 8, 8, 8, 24, 0, 8, 16);
 #elif defined(SCUMM_LITTLE_ENDIAN)
-			pf = Graphics::PixelFormat(4, 8, 8, 8, 8, 16, 8, 0, 24);
+			return Graphics::PixelFormat(4, 8, 8, 8, 8, 16, 8, 0, 24);
 #endif
-			break;
-		default:
-			break;
 	}
-	int bytes = pf.bytesPerPixel;
+}
+
+void glopTexImage2D(GLContext *c, GLParam *p) {
+	int target = p[1].i;
+	int level = p[2].i;
+	int components = p[3].i;
+	int width = p[4].i;
+	int height = p[5].i;
+	int border = p[6].i;
+	int format = p[7].i;
+	int type = p[8].i;
+	byte *pixels = (byte *)p[9].p;
+	GLImage *im;
+	byte *pixels1;
+	bool do_free_after_rgb2rgba = false;
+
+	// the old image is about to be replaced, draw what is using it first
+	c->fb->flushTiles();
 
-	// Simply unpack RGB into RGBA with 255 for Alpha.
-	// FIXME: This will need additional checks when we get around to adding 24/32-bit backend.
-	if (target == TGL_TEXTURE_2D && level == 0 && components == 3 && border == 0 && pixels != NULL) {
-		if (format == TGL_RGB || format == TGL_BGR) {
-			Graphics::PixelBuffer temp(pf, width * height, DisposeAfterUse::NO);
-			Graphics::PixelBuffer pixPtr(sourceFormat, pixels);
-
-			for (int i = 0; i < width * height; ++i) {
-				uint8 r, g, b;
-				pixPtr.getRGBAt(i, r, g, b);
-				temp.setPixelAt(i, 255, r, g, b);
+	Graphics::PixelFormat pf;
+	if (format == TGL_COLOR_INDEX && type == TGL_UNSIGNED_BYTE) {
+		// Indices into the palette set with tglColorTable, kept as they are
+		pf = Graphics::PixelFormat::createFormatCLUT8();
+	} else if (format == TGL_RGB && type == TGL_UNSIGNED_SHORT_5_6_5) {
+		// Kept as 16 bit texels, the rasterizer reads them directly
+		pf = Graphics::PixelFormat(2, 5, 6, 5, 0, 11, 5, 0, 0);
+	} else {
+		Graphics::PixelFormat sourceFormat = getSourceFormat(format);
+		pf = getStorageFormat(format);
+
+		// Simply unpack RGB into RGBA with 255 for Alpha.
+		// FIXME: This will need additional checks when we get around to adding 24/32-bit backend.
+		if (target == TGL_TEXTURE_2D && level == 0 && components == 3 && border == 0 && pixels != NULL) {
+			if (format == TGL_RGB || format == TGL_BGR) {
+				Graphics::PixelBuffer temp(pf, width * height, DisposeAfterUse::NO);
+				Graphics::PixelBuffer pixPtr(sourceFormat, pixels);
+
+				for (int i = 0; i < width * height; ++i) {
+					uint8 r, g, b;
+					pixPtr.getRGBAt(i, r, g, b);
+					temp.setPixelAt(i, 255, r, g, b);
+				}
+				pixels = temp.getRawBuffer();
+				do_free_after_rgb2rgba = true;
 			}
-			pixels = temp.getRawBuffer();
-			do_free_after_rgb2rgba = true;
+		} else if (format != TGL_RGBA || type != TGL_UNSIGNED_BYTE) {
+			error("tglTexImage2D: combination of parameters not handled");
 		}
-	} else if (format != TGL_RGBA || type != TGL_UNSIGNED_BYTE) {
-		error("tglTexImage2D: combination of parameters not handled");
 	}
+	int bytes = pf.bytesPerPixel;
 
-	pixels1 = new byte[c->_textureSize * c->_textureSize * bytes];
+	// Textures keep their own size, only the ones above the maximum size are scaled down
+	int imageWidth = MIN(width, c->_textureSize);
+	int imageHeight = MIN(height, c->_textureSize);
+	pixels1 = new byte[imageWidth * imageHeight * bytes];
 	if (pixels != NULL) {
-		if (width != c->_textureSize || height != c->_textureSize) {
-			// we use interpolation for better looking result
-			gl_resizeImage(pixels1, c->_textureSize, c->_textureSize, pixels, width, height);
-			width = c->_textureSize;
-			height = c->_textureSize;
+		if (width != imageWidth || height != imageHeight) {
+			if (bytes == 4) {
+				// we use interpolation for better looking result
+				gl_resizeImage(pixels1, imageWidth, imageHeight, pixels, width, height);
+			} else {
+				// palette indices can't be interpolated
+				gl_resizeImageNoInterpolate(pixels1, imageWidth, imageHeight, pixels, width, height, bytes);
+			}
 		} else {
-			memcpy(pixels1, pixels, c->_textureSize * c->_textureSize * bytes);
+			memcpy(pixels1, pixels, imageWidth * imageHeight * bytes);
 		}
 	}
+	width = imageWidth;
+	height = imageHeight;
 
 	im = &c->current_texture->images[level];
 	im->xsize = width;
@@ -178,6 +202,35 @@ void glopTexImage2D(GLContext *c, GLParam *p) {
 	}
 }
 
+void glopColorTable(GLContext *c, GLParam *p) {
+	int target = p[1].i;
+	int width = p[3].i;
+	int format = p[4].i;
+	int type = p[5].i;
+	byte *table = (byte *)p[6].p;
+
+	if (target != TGL_TEXTURE_2D || type != TGL_UNSIGNED_BYTE || width <= 0 || width > 256)
+		error("tglColorTable: combination of parameters not handled");
+
+	// textures drawn with the old palette may still be queued
+	c->fb->flushTiles();
+
+	Graphics::PixelFormat pf = getStorageFormat(format);
+	Graphics::PixelBuffer source(getSourceFormat(format), table);
+	Graphics::PixelBuffer &palette = c->current_texture->palette;
+	if (!palette)
+		palette.create(pf, 256, DisposeAfterUse::NO);
+	else
+		palette.set(pf, palette.getRawBuffer());
+	palette.clear(256 * pf.bytesPerPixel);
+
+	for (int i = 0; i < width; i++) {
+		uint8 a, r, g, b;
+		source.getARGBAt(i, a, r, g, b);
+		palette.setPixelAt(i, a, r, g, b);
+	}
+}
+
 // TODO: not all tests are done
 void glopTexEnv(GLContext *, GLParam *p) {
 	int target = p[1].i;
@@ -162,6 +162,37 @@ static inline void gl_vertex_transform(GLContext *c, GLVertex *v) {
 	v->clip_code = gl_clipcode(v->pc.X, v->pc.Y, v->pc.Z, v->pc.W);
 }
 
+// transform, light and project a vertex whose coordinates are set, using
+// the current attributes
+void gl_process_vertex(GLContext *c, GLVertex *v) {
+	gl_vertex_transform(c, v);
+
+	// color
+
+	if (c->lighting_enabled) {
+		gl_shade_vertex(c, v);
+	} else {
+		v->color = c->current_color;
+	}
+
+	// tex coords
+
+	if (c->texture_2d_enabled) {
+		if (c->apply_texture_matrix) {
+			c->matrix_stack_ptr[2]->transform(c->current_tex_coord, v->tex_coord);
+		} else {
+			v->tex_coord = c->current_tex_coord;
+		}
+	}
+	// precompute the mapping to the viewport
+	if (v->clip_code == 0)
+		gl_transform_to_viewport(c, v);
+
+	// edge flag
+
+	v->edge_flag = c->current_edge_flag;
+}
+
 void glopVertex(GLContext *c, GLParam *p) {
 	GLVertex *v;
 	int n, cnt;
@@ -194,32 +225,7 @@ void glopVertex(GLContext *c, GLParam *p) {
 	v->coord.Z = p[3].f;
 	v->coord.W = p[4].f;
 
-	gl_vertex_transform(c, v);
-
-	// color
-
-	if (c->lighting_enabled) {
-		gl_shade_vertex(c, v);
-	} else {
-		v->color = c->current_color;
-	}
-
-	// tex coords
-
-	if (c->texture_2d_enabled) {
-		if (c->apply_texture_matrix) {
-			c->matrix_stack_ptr[2]->transform(c->current_tex_coord, v->tex_coord);
-		} else {
-			v->tex_coord = c->current_tex_coord;
-		}
-	}
-	// precompute the mapping to the viewport
-	if (v->clip_code == 0)
-		gl_transform_to_viewport(c, v);
-
-	// edge flag
-
-	v->edge_flag = c->current_edge_flag;
+	gl_process_vertex(c, v);
 
 	switch (c->begin_type) {
 	case TGL_POINTS:
@@ -11,8 +11,6 @@
 
 namespace TinyGL {
 
-uint8 PSZB;
-
 // adr must be aligned on an 'int'
 void memset_s(void *adr, int val, int count) {
 	int n, v;
@@ -57,13 +55,15 @@ void memset_l(void *adr, int val, int count) {
 		*p++ = val;
 }
 
-FrameBuffer::FrameBuffer(int width, int height, const Graphics::PixelBuffer &frame_buffer) : _depthWrite(true) {
+FrameBuffer::FrameBuffer(int width, int height, const Graphics::PixelBuffer &frame_buffer) : _depthWrite(true), _tiles(NULL),
+	_dirtyCells(NULL), _dirtyCellsWidth(0), _dirtyCellsHeight(0), _allDirty(false), _presentedFrame(NULL),
+	_depthBlocksValid(false), _culledSpans(0), _culledPixels(0) {
 	int size;
 
 	this->xsize = width;
 	this->ysize = height;
 	this->cmode = frame_buffer.getFormat();
-	PSZB = this->pixelbytes = this->cmode.bytesPerPixel;
+	this->pixelbytes = this->cmode.bytesPerPixel;
 	this->pixelbits = this->cmode.bytesPerPixel * 8;
 	this->linesize = (xsize * this->pixelbytes + 3) & ~3;
 
@@ -71,6 +71,11 @@ FrameBuffer::FrameBuffer(int width, int height, const Graphics::PixelBuffer &fra
 
 	this->zbuf = (unsigned int *)gl_malloc(size);
 
+	_depthBlocksWidth = (xsize + ZB_DEPTH_BLOCK_SIZE - 1) / ZB_DEPTH_BLOCK_SIZE;
+	_depthBlocksHeight = (ysize + ZB_DEPTH_BLOCK_SIZE - 1) / ZB_DEPTH_BLOCK_SIZE;
+	_depthBlockMin = (unsigned int *)gl_malloc(_depthBlocksWidth * _depthBlocksHeight * sizeof(unsigned int));
+	_depthBlockMax = (unsigned int *)gl_malloc(_depthBlocksWidth * _depthBlocksHeight * sizeof(unsigned int));
+
 	if (!frame_buffer) {
 		byte *pixelBuffer = (byte *)gl_malloc(this->ysize * this->linesize);
 		this->pbuf.set(this->cmode, pixelBuffer);
@@ -80,20 +85,31 @@ FrameBuffer::FrameBuffer(int width, int height, const Graphics::PixelBuffer &fra
 		this->pbuf = frame_buffer;
 	}
 
-	this->current_texture = NULL;
+	setTexture(Graphics::PixelBuffer(), 1, 1);
 	this->shadow_mask_buf = NULL;
 
 	this->buffer.pbuf = this->pbuf.getRawBuffer();
 	this->buffer.zbuf = this->zbuf;
 	_blendingEnabled = false;
+	_sourceBlendingFactor = TGL_ONE;
+	_destinationBlendingFactor = TGL_ZERO;
 	_alphaTestEnabled = false;
+	_alphaTestFunc = TGL_ALWAYS;
+	_alphaTestRefVal = 0;
 	_depthFunc = TGL_LESS;
+	updateFragmentPipeline();
+	_clipYMin = 0;
+	_clipYMax = this->ysize;
 }
 
 FrameBuffer::~FrameBuffer() {
+	enableTiledRasterization(false);
+	enableDirtyRects(false);
 	if (frame_buffer_allocated)
 		pbuf.free();
 	gl_free(zbuf);
+	gl_free(_depthBlockMin);
+	gl_free(_depthBlockMax);
 }
 
 Buffer *FrameBuffer::genOffscreenBuffer() {
@@ -115,10 +131,17 @@ void FrameBuffer::clear(int clear_z, int z, int clear_color, int r, int g, int b
 	uint32 color;
 	byte *pp;
 
+	flushTiles();
 	if (clear_z) {
 		memset_l(this->zbuf, z, this->xsize * this->ysize);
+		memset_l(_depthBlockMin, z, _depthBlocksWidth * _depthBlocksHeight);
+		memset_l(_depthBlockMax, z, _depthBlocksWidth * _depthBlocksHeight);
+		_depthBlocksValid = true;
 	}
 	if (clear_color) {
+		// Clearing to the same color as the previous frame changes nothing,
+		// which getDirtyRects() finds by comparing the cells
+		markDirty(0, 0, xsize - 1, ysize - 1);
 		pp = this->pbuf.getRawBuffer();
 		for (int y = 0; y < this->ysize; y++) {
 			color = this->cmode.RGBToColor(r, g, b);
@@ -129,14 +152,17 @@ void FrameBuffer::clear(int clear_z, int z, int clear_color, int r, int g, int b
 }
 
 void FrameBuffer::blitOffscreenBuffer(Buffer *buf) {
+	flushTiles();
 	// TODO: could be faster, probably.
 	if (buf->used) {
+		_allDirty = true;
+		_depthBlocksValid = false;
 		for (int i = 0; i < this->xsize * this->ysize; ++i) {
 			unsigned int d1 = buf->zbuf[i];
 			unsigned int d2 = this->zbuf[i];
 			if (d1 > d2) {
-				const int offset = i * PSZB;
-				memcpy(this->pbuf.getRawBuffer() + offset, buf->pbuf + offset, PSZB);
+				const int offset = i * this->pixelbytes;
+				memcpy(this->pbuf.getRawBuffer() + offset, buf->pbuf + offset, this->pixelbytes);
 				memcpy(this->zbuf + i, buf->zbuf + i, sizeof(int));
 			}
 		}
@@ -144,6 +170,7 @@ void FrameBuffer::blitOffscreenBuffer(Buffer *buf) {
 }
 
 void FrameBuffer::selectOffscreenBuffer(Buffer *buf) {
+	flushTiles();
 	if (buf) {
 		this->pbuf = buf->pbuf;
 		this->zbuf = buf->zbuf;
@@ -152,38 +179,298 @@ void FrameBuffer::selectOffscreenBuffer(Buffer *buf) {
 		this->pbuf = this->buffer.pbuf;
 		this->zbuf = this->buffer.zbuf;
 	}
+	_depthBlocksValid = false;
 }
 
 void FrameBuffer::clearOffscreenBuffer(Buffer *buf) {
+	flushTiles();
 	memset(buf->pbuf, 0, this->ysize * this->linesize);
 	memset(buf->zbuf, 0, this->ysize * this->xsize * sizeof(unsigned int));
 	buf->used = false;
+	if (buf->zbuf == this->zbuf)
+		_depthBlocksValid = false;
+}
+
+void FrameBuffer::updateDepthBlocks() {
+	for (int i = 0; i < _depthBlocksWidth * _depthBlocksHeight; i++) {
+		_depthBlockMin[i] = 0xFFFFFFFF;
+		_depthBlockMax[i] = 0;
+	}
+
+	for (int y = 0; y < ysize; y++) {
+		const unsigned int *pz = zbuf + y * xsize;
+		unsigned int *blockMin = _depthBlockMin + (y / ZB_DEPTH_BLOCK_SIZE) * _depthBlocksWidth;
+		unsigned int *blockMax = _depthBlockMax + (y / ZB_DEPTH_BLOCK_SIZE) * _depthBlocksWidth;
+		for (int x = 0; x < xsize; x++) {
+			unsigned int z = pz[x];
+			int block = x / ZB_DEPTH_BLOCK_SIZE;
+			if (z < blockMin[block])
+				blockMin[block] = z;
+			if (z > blockMax[block])
+				blockMax[block] = z;
+		}
+	}
+
+	_depthBlocksValid = true;
+}
+
+bool FrameBuffer::isSpanHidden(int y, int x0, int x1, unsigned int zMin, unsigned int zMax) const {
+	x0 = MAX(x0, 0);
+	x1 = MIN(x1, xsize - 1);
+	int first = (y / ZB_DEPTH_BLOCK_SIZE) * _depthBlocksWidth + x0 / ZB_DEPTH_BLOCK_SIZE;
+	int last = (y / ZB_DEPTH_BLOCK_SIZE) * _depthBlocksWidth + x1 / ZB_DEPTH_BLOCK_SIZE;
+
+	// A span fails the test when every pixel of it does, against any of
+	// the depths the blocks may hold. See compareDepth().
+	switch (_depthFunc) {
+	case TGL_NEVER:
+		return true;
+	case TGL_LESS:
+		for (int i = first; i <= last; i++) {
+			if (_depthBlockMin[i] < zMax)
+				return false;
+		}
+		return true;
+	case TGL_LEQUAL:
+		for (int i = first; i <= last; i++) {
+			if (_depthBlockMin[i] <= zMax)
+				return false;
+		}
+		return true;
+	case TGL_EQUAL:
+		for (int i = first; i <= last; i++) {
+			if (_depthBlockMin[i] <= zMax && _depthBlockMax[i] >= zMin)
+				return false;
+		}
+		return true;
+	case TGL_GREATER:
+		for (int i = first; i <= last; i++) {
+			if (_depthBlockMax[i] > zMin)
+				return false;
+		}
+		return true;
+	case TGL_GEQUAL:
+		for (int i = first; i <= last; i++) {
+			if (_depthBlockMax[i] >= zMin)
+				return false;
+		}
+		return true;
+	default:
+		return false;
+	}
+}
+
+void FrameBuffer::updateDepthBlocks(int y, int x0, int x1, unsigned int zMin, unsigned int zMax) {
+	x0 = MAX(x0, 0);
+	x1 = MIN(x1, xsize - 1);
+	int first = (y / ZB_DEPTH_BLOCK_SIZE) * _depthBlocksWidth + x0 / ZB_DEPTH_BLOCK_SIZE;
+	int last = (y / ZB_DEPTH_BLOCK_SIZE) * _depthBlocksWidth + x1 / ZB_DEPTH_BLOCK_SIZE;
+
+	// With TGL_LESS and TGL_LEQUAL the stored depths only ever grow, so the
+	// lower bounds stay valid
+	bool lowerMin = _depthFunc != TGL_LESS && _depthFunc != TGL_LEQUAL;
+	for (int i = first; i <= last; i++) {
+		if (lowerMin && zMin < _depthBlockMin[i])
+			_depthBlockMin[i] = zMin;
+		if (zMax > _depthBlockMax[i])
+			_depthBlockMax[i] = zMax;
+	}
+}
+
+void FrameBuffer::enableDirtyRects(bool enable) {
+	gl_free(_dirtyCells);
+	gl_free(_presentedFrame);
+	_dirtyCells = NULL;
+	_presentedFrame = NULL;
+
+	if (!enable)
+		return;
+
+	_dirtyCellsWidth = (xsize + ZB_DIRTY_CELL_SIZE - 1) / ZB_DIRTY_CELL_SIZE;
+	_dirtyCellsHeight = (ysize + ZB_DIRTY_CELL_SIZE - 1) / ZB_DIRTY_CELL_SIZE;
+	_dirtyCells = (byte *)gl_zalloc(_dirtyCellsWidth * _dirtyCellsHeight);
+	_allDirty = true;
+}
+
+void FrameBuffer::markDirtyCells(int x0, int y0, int x1, int y1) {
+	x0 = MAX(x0, 0);
+	y0 = MAX(y0, 0);
+	x1 = MIN(x1, xsize - 1);
+	y1 = MIN(y1, ysize - 1);
+	if (x0 > x1 || y0 > y1)
+		return;
+
+	for (int cy = y0 / ZB_DIRTY_CELL_SIZE; cy <= y1 / ZB_DIRTY_CELL_SIZE; cy++) {
+		byte *cells = _dirtyCells + cy * _dirtyCellsWidth;
+		for (int cx = x0 / ZB_DIRTY_CELL_SIZE; cx <= x1 / ZB_DIRTY_CELL_SIZE; cx++)
+			cells[cx] = 1;
+	}
+}
+
+void FrameBuffer::getDirtyRects(Common::List<Common::Rect> &rects) {
+	if (!_dirtyCells) {
+		rects.push_back(Common::Rect(xsize, ysize));
+		return;
+	}
+
+	flushTiles();
+
+	// The first call has nothing to compare with
+	bool allChanged = !_presentedFrame;
+	if (!_presentedFrame)
+		_presentedFrame = (byte *)gl_malloc(ysize * linesize);
+
+	// Keep only the cells whose pixels differ from the previous call
+	const byte *screen = this->buffer.pbuf;
+	for (int cy = 0; cy < _dirtyCellsHeight; cy++) {
+		int y0 = cy * ZB_DIRTY_CELL_SIZE;
+		int y1 = MIN(y0 + ZB_DIRTY_CELL_SIZE, ysize);
+		for (int cx = 0; cx < _dirtyCellsWidth; cx++) {
+			byte &cell = _dirtyCells[cy * _dirtyCellsWidth + cx];
+			if (!cell && !_allDirty && !allChanged)
+				continue;
+
+			int x0 = cx * ZB_DIRTY_CELL_SIZE;
+			int offset = x0 * pixelbytes;
+			int size = (MIN(x0 + ZB_DIRTY_CELL_SIZE, xsize) - x0) * pixelbytes;
+			bool changed = allChanged;
+			for (int y = y0; y < y1 && !changed; y++)
+				changed = memcmp(screen + y * linesize + offset, _presentedFrame + y * linesize + offset, size) != 0;
+			if (changed) {
+				for (int y = y0; y < y1; y++)
+					memcpy(_presentedFrame + y * linesize + offset, screen + y * linesize + offset, size);
+			}
+			cell = changed;
+		}
+	}
+	_allDirty = false;
+
+	// Merge the changed cells: take each horizontal run of cells and extend it
+	// down as long as the rows below have the same run
+	for (int cy = 0; cy < _dirtyCellsHeight; cy++) {
+		byte *cells = _dirtyCells + cy * _dirtyCellsWidth;
+		int cx = 0;
+		while (cx < _dirtyCellsWidth) {
+			if (!cells[cx]) {
+				cx++;
+				continue;
+			}
+
+			int endX = cx;
+			while (endX < _dirtyCellsWidth && cells[endX])
+				endX++;
+
+			int endY = cy + 1;
+			while (endY < _dirtyCellsHeight) {
+				const byte *below = _dirtyCells + endY * _dirtyCellsWidth;
+				bool sameRun = true;
+				for (int i = cx; i < endX && sameRun; i++)
+					sameRun = below[i] != 0;
+				if (!sameRun)
+					break;
+				endY++;
+			}
+
+			for (int y = cy; y < endY; y++)
+				memset(_dirtyCells + y * _dirtyCellsWidth + cx, 0, endX - cx);
+
+			rects.push_back(Common::Rect(cx * ZB_DIRTY_CELL_SIZE, cy * ZB_DIRTY_CELL_SIZE,
+			                             MIN(endX * ZB_DIRTY_CELL_SIZE, xsize), MIN(endY * ZB_DIRTY_CELL_SIZE, ysize)));
+			cx = endX;
+		}
+	}
 }
 
-void FrameBuffer::setTexture(const Graphics::PixelBuffer &texture) {
+void FrameBuffer::setTexture(const Graphics::PixelBuffer &texture, int width, int height,
+                             const Graphics::PixelBuffer &palette) {
 	current_texture = texture;
+	current_texture_palette = palette;
+	_textureWidth = MAX(width, 1);
+	_textureHeight = MAX(height, 1);
+	// Non power of two sizes keep every bit, and go through wrapTexelCoord() instead
+	if (_textureWidth & (_textureWidth - 1))
+		_textureSMask = 0xFFFFFFFF;
+	else
+		_textureSMask = (_textureWidth - 1) << ZB_POINT_ST_FRAC_BITS;
+	if (_textureHeight & (_textureHeight - 1))
+		_textureTMask = 0xFFFFFFFF;
+	else
+		_textureTMask = (_textureHeight - 1) << ZB_POINT_ST_FRAC_BITS;
+}
+
+unsigned int FrameBuffer::wrapTexelCoord(unsigned int s, int size) {
+	int texel = ((int)s >> ZB_POINT_ST_FRAC_BITS) % size;
+	return texel < 0 ? texel + size : texel;
 }
 
 void FrameBuffer::setBlendingFactors(int sFactor, int dFactor) {
 	_sourceBlendingFactor = sFactor;
 	_destinationBlendingFactor = dFactor;
+	updateFragmentPipeline();
 }
 
 void FrameBuffer::enableBlending(bool enable) {
 	_blendingEnabled = enable;
+	updateFragmentPipeline();
 }
 
 void FrameBuffer::setAlphaTestFunc(int func, float ref) {
 	_alphaTestFunc = func;
 	_alphaTestRefVal = (int)(ref * 255);
+	updateFragmentPipeline();
 }
 
 void FrameBuffer::enableAlphaTest(bool enable) {
 	_alphaTestEnabled = enable;
+	updateFragmentPipeline();
 }
 
 void FrameBuffer::setDepthFunc(int func) {
 	_depthFunc = func;
+	updateFragmentPipeline();
+}
+
+void FrameBuffer::blendPixelDynamic(int pixel, byte aSrc, byte rSrc, byte gSrc, byte bSrc) {
+	blendPixel<PIPELINE_DYNAMIC, PIPELINE_DYNAMIC, false>(pixel, aSrc, rSrc, gSrc, bSrc);
+}
+
+void FrameBuffer::writeSpan(int pixel, const Graphics::PixelBuffer &src, int srcPixel, int length, const byte *colorMap) {
+	flushTiles();
+
+	const Graphics::PixelFormat &srcFormat = src.getFormat();
+	const uint16 *src16 = srcFormat.bytesPerPixel == 2 ? (const uint16 *)src.getRawBuffer(srcPixel) : NULL;
+	bool direct = is8888();
+	for (int i = 0; i < length; i++) {
+		byte a, r, g, b;
+		if (src16)
+			srcFormat.colorToARGB(src16[i], a, r, g, b);
+		else
+			src.getARGBAt(srcPixel + i, a, r, g, b);
+		if (direct)
+			writePixel8888<PIPELINE_DYNAMIC, PIPELINE_DYNAMIC, PIPELINE_DYNAMIC>(pixel + i, a, colorMap[r], colorMap[g], colorMap[b]);
+		else
+			writePixel<PIPELINE_DYNAMIC, PIPELINE_DYNAMIC, PIPELINE_DYNAMIC>(pixel + i, a, colorMap[r], colorMap[g], colorMap[b]);
+	}
+}
+
+void FrameBuffer::updateFragmentPipeline() {
+	int depth = 2;
+	if (_depthFunc == TGL_LESS)
+		depth = 0;
+	else if (_depthFunc == TGL_LEQUAL)
+		depth = 1;
+
+	int blending = 0;
+	if (_blendingEnabled) {
+		if (_sourceBlendingFactor == TGL_SRC_ALPHA && _destinationBlendingFactor == TGL_ONE_MINUS_SRC_ALPHA)
+			blending = 1;
+		else if (_sourceBlendingFactor == TGL_SRC_ALPHA && _destinationBlendingFactor == TGL_ONE)
+			blending = 2;
+		else
+			blending = 3;
+	}
+
+	_fragmentPipeline = (depth << 4) | ((_depthWrite ? 1 : 0) << 3) | ((_alphaTestEnabled ? 1 : 0) << 2) | blending;
 }
 
 } // end of namespace TinyGL
@@ -1,6 +1,10 @@
 #ifndef GRAPHICS_TINYGL_ZBUFFER_H_
 #define GRAPHICS_TINYGL_ZBUFFER_H_
 
+#include "common/array.h"
+#include "common/list.h"
+#include "common/rect.h"
+
 #include "graphics/pixelbuffer.h"
 #include "graphics/tinygl/gl.h"
 
@@ -15,7 +19,7 @@ namespace TinyGL {
 #define ZB_POINT_ST_FRAC_BITS 14
 #define ZB_POINT_ST_FRAC_SHIFT     (ZB_POINT_ST_FRAC_BITS - 1)
 #define ZB_POINT_ST_MIN            ( (1 << ZB_POINT_ST_FRAC_SHIFT) )
-#define ZB_POINT_ST_MAX            ( (c->_textureSize << ZB_POINT_ST_FRAC_BITS) - (1 << ZB_POINT_ST_FRAC_SHIFT) )
+#define ZB_POINT_ST_MAX(size)      ( ((size) << ZB_POINT_ST_FRAC_BITS) - (1 << ZB_POINT_ST_FRAC_SHIFT) )
 
 #define ZB_POINT_RED_MIN ( (1 << 10) )
 #define ZB_POINT_RED_MAX ( (1 << 16) - (1 << 10) )
@@ -34,7 +38,46 @@ static const int DRAW_SMOOTH = 2;
 static const int DRAW_SHADOW_MASK = 3;
 static const int DRAW_SHADOW = 4;
 
-extern uint8 PSZB;
+// Height in lines of the bands the tiled rasterizer splits the frame buffer into
+static const int ZB_TILE_HEIGHT = 32;
+
+// Size in pixels of the square cells the dirty rectangle tracking works with
+static const int ZB_DIRTY_CELL_SIZE = 32;
+
+// Size in pixels of the square blocks of the depth buffer whose depth range
+// is tracked for early rejection. ZB_TILE_HEIGHT must be a multiple of it, so
+// that the bands of the tiled rasterizer don't share blocks.
+static const int ZB_DEPTH_BLOCK_SIZE = 8;
+
+// Fragment pipeline template arguments: the state is read at run time, or
+// blending is disabled.
+static const int PIPELINE_DYNAMIC = -1;
+static const int PIPELINE_NO_BLENDING = -2;
+
+// Number of specialized fragment pipelines, see FragmentPipeline
+static const int PIPELINE_COUNT = 48;
+
+/**
+ * Decodes a fragment pipeline index into the state it is specialized for.
+ * The index is made of, from the most significant bits:
+ *  - the depth function: TGL_LESS, TGL_LEQUAL or any other (0 to 2)
+ *  - the depth write mask (1 bit)
+ *  - whether alpha testing is enabled (1 bit)
+ *  - the blending factors: none, src alpha / one minus src alpha,
+ *    src alpha / one, or any other (2 bits)
+ */
+template <int kPipeline>
+struct FragmentPipeline {
+	static const int depthFunc = (kPipeline >> 4) == 0 ? TGL_LESS : (kPipeline >> 4) == 1 ? TGL_LEQUAL : PIPELINE_DYNAMIC;
+	static const bool depthWrite = ((kPipeline >> 3) & 1) != 0;
+	static const int alphaTestFunc = ((kPipeline >> 2) & 1) ? PIPELINE_DYNAMIC : TGL_ALWAYS;
+	static const int blendSrc = (kPipeline & 3) == 0 ? PIPELINE_NO_BLENDING :
+	                            (kPipeline & 3) == 1 ? TGL_SRC_ALPHA :
+	                            (kPipeline & 3) == 2 ? TGL_SRC_ALPHA : PIPELINE_DYNAMIC;
+	static const int blendDst = (kPipeline & 3) == 0 ? PIPELINE_NO_BLENDING :
+	                            (kPipeline & 3) == 1 ? TGL_ONE_MINUS_SRC_ALPHA :
+	                            (kPipeline & 3) == 2 ? TGL_ONE : PIPELINE_DYNAMIC;
+};
 
 struct Buffer {
 	byte *pbuf;
@@ -50,7 +93,37 @@ struct ZBufferPoint {
 	float sz, tz;  // temporary coordinates for mapping
 };
 
+// Snapshot of the frame buffer state used by the triangle fill functions
+struct RasterizationState {
+	bool depthWrite;
+	int depthFunc;
+	bool blendingEnabled;
+	int sourceBlendingFactor;
+	int destinationBlendingFactor;
+	bool alphaTestEnabled;
+	int alphaTestFunc;
+	int alphaTestRefVal;
+	Graphics::PixelBuffer texture;
+	Graphics::PixelBuffer texturePalette;
+	int textureWidth;
+	int textureHeight;
+	unsigned char *shadowMaskBuf;
+	int shadowColorR;
+	int shadowColorG;
+	int shadowColorB;
+
+	bool operator==(const RasterizationState &other) const;
+};
+
+struct TileQueue;
+struct ZBufferSpan;
+struct FrameBuffer;
+
+typedef void (*DrawSpanProc)(FrameBuffer *buffer, const ZBufferSpan &span);
+
 struct FrameBuffer {
+	typedef void (FrameBuffer::*FillTriangleProc)(ZBufferPoint *p0, ZBufferPoint *p1, ZBufferPoint *p2);
+
 	FrameBuffer(int xsize, int ysize, const Graphics::PixelBuffer &frame_buffer);
 	~FrameBuffer();
 
@@ -58,16 +131,43 @@ struct FrameBuffer {
 	void delOffscreenBuffer(Buffer *buffer);
 	void clear(int clear_z, int z, int clear_color, int r, int g, int b);
 
+	// Pixels of the screen, after drawing the queued triangles. The caller
+	// reports the area it writes to with addDirtyRect().
 	byte *getPixelBuffer() {
+		flushTiles();
 		return pbuf.getRawBuffer(0);
 	}
 
+	// Pixels being drawn to, for the span routines. Unlike getPixelBuffer()
+	// it neither flushes the tiles nor marks the screen as dirty.
+	FORCEINLINE byte *getRawPixelBuffer() const {
+		return pbuf.getRawBuffer();
+	}
+
+	// Whether the pixel buffer has 32 bit pixels with 8 bit color channels,
+	// which the span routines store directly with writePixel8888()
+	bool is8888() const {
+		return cmode.bytesPerPixel == 4 && cmode.rLoss == 0 && cmode.gLoss == 0 && cmode.bLoss == 0;
+	}
+
+	// The shadow mask has one bit per pixel, least significant bit first, and
+	// each row starts on a byte boundary
+	int getShadowMaskPitch() const {
+		return (xsize + 7) / 8;
+	}
+
 	FORCEINLINE void readPixelRGB(int pixel, byte &r, byte &g, byte &b) {
+		flushTiles();
 		pbuf.getRGBAt(pixel, r, g, b);
 	}
 
 	FORCEINLINE bool compareDepth(unsigned int &zSrc, unsigned int &zDst) {
-		switch (_depthFunc) {
+		return compareDepth<PIPELINE_DYNAMIC>(zSrc, zDst);
+	}
+
+	template <int kDepthFunc>
+	FORCEINLINE bool compareDepth(unsigned int &zSrc, unsigned int &zDst) {
+		switch (kDepthFunc == PIPELINE_DYNAMIC ? _depthFunc : kDepthFunc) {
 		case TGL_NEVER:
 			break;
 		case TGL_LESS:
@@ -101,10 +201,15 @@ struct FrameBuffer {
 	}
 
 	FORCEINLINE bool checkAlphaTest(byte aSrc) {
-		if (!_alphaTestEnabled)
+		return checkAlphaTest<PIPELINE_DYNAMIC>(aSrc);
+	}
+
+	template <int kAlphaTestFunc>
+	FORCEINLINE bool checkAlphaTest(byte aSrc) {
+		if (kAlphaTestFunc == PIPELINE_DYNAMIC && !_alphaTestEnabled)
 			return true;
 
-		switch (_alphaTestFunc) {
+		switch (kAlphaTestFunc == PIPELINE_DYNAMIC ? _alphaTestFunc : kAlphaTestFunc) {
 		case TGL_NEVER:
 			break;
 		case TGL_LESS:
@@ -137,137 +242,278 @@ struct FrameBuffer {
 		return false;
 	}
 
+	// Pixels written from outside of TinyGL are not tracked one by one, they
+	// mark the whole screen as dirty
+	FORCEINLINE void writePixel(int pixel, int value) {
+		markDirty(pixel);
+		writePixel<PIPELINE_DYNAMIC, PIPELINE_DYNAMIC, PIPELINE_DYNAMIC>(pixel, value);
+	}
+
+	FORCEINLINE void writePixel(int pixel, byte rSrc, byte gSrc, byte bSrc) {
+		writePixel(pixel, 255, rSrc, gSrc, bSrc);
+	}
+
+	FORCEINLINE void writePixel(int pixel, byte aSrc, byte rSrc, byte gSrc, byte bSrc) {
+		markDirty(pixel);
+		writePixel<PIPELINE_DYNAMIC, PIPELINE_DYNAMIC, PIPELINE_DYNAMIC>(pixel, aSrc, rSrc, gSrc, bSrc);
+	}
+
+	template <int kAlphaTestFunc, int kBlendSrc, int kBlendDst>
 	FORCEINLINE void writePixel(int pixel, int value) {
 		byte rSrc, gSrc, bSrc, aSrc;
 		this->pbuf.getFormat().colorToARGB(value, aSrc, rSrc, gSrc, bSrc);
-		if (!checkAlphaTest(aSrc))
+		if (!checkAlphaTest<kAlphaTestFunc>(aSrc))
 			return;
 
-		if (_blendingEnabled == false) {
+		if (!isBlendingEnabled<kBlendSrc>()) {
 			this->pbuf.setPixelAt(pixel, value);
+		} else if (kBlendSrc == PIPELINE_DYNAMIC) {
+			blendPixelDynamic(pixel, aSrc, rSrc, gSrc, bSrc);
 		} else {
-			writePixel(pixel, aSrc, rSrc, gSrc, bSrc);
+			blendPixel<kBlendSrc, kBlendDst, false>(pixel, aSrc, rSrc, gSrc, bSrc);
 		}
 	}
 
-	FORCEINLINE void writePixel(int pixel, byte rSrc, byte gSrc, byte bSrc) {
-		writePixel(pixel, 255, rSrc, gSrc, bSrc);
-	}
-
+	template <int kAlphaTestFunc, int kBlendSrc, int kBlendDst>
 	FORCEINLINE void writePixel(int pixel, byte aSrc, byte rSrc, byte gSrc, byte bSrc) {
-		if (!checkAlphaTest(aSrc))
+		if (!checkAlphaTest<kAlphaTestFunc>(aSrc))
 			return;
 
-		if (_blendingEnabled == false) {
+		if (!isBlendingEnabled<kBlendSrc>()) {
 			this->pbuf.setPixelAt(pixel, aSrc, rSrc, gSrc, bSrc);
+		} else if (kBlendSrc == PIPELINE_DYNAMIC) {
+			blendPixelDynamic(pixel, aSrc, rSrc, gSrc, bSrc);
+		} else {
+			blendPixel<kBlendSrc, kBlendDst, false>(pixel, aSrc, rSrc, gSrc, bSrc);
+		}
+	}
+
+	template <int kAlphaTestFunc, int kBlendSrc, int kBlendDst>
+	FORCEINLINE void writePixel8888(int pixel, uint32 value) {
+		if (kAlphaTestFunc == TGL_ALWAYS && !isBlendingEnabled<kBlendSrc>()) {
+			((uint32 *)pbuf.getRawBuffer())[pixel] = value;
+			return;
+		}
+		byte rSrc, gSrc, bSrc, aSrc;
+		cmode.colorToARGB(value, aSrc, rSrc, gSrc, bSrc);
+		writePixel8888<kAlphaTestFunc, kBlendSrc, kBlendDst>(pixel, aSrc, rSrc, gSrc, bSrc);
+	}
+
+	template <int kAlphaTestFunc, int kBlendSrc, int kBlendDst>
+	FORCEINLINE void writePixel8888(int pixel, byte aSrc, byte rSrc, byte gSrc, byte bSrc) {
+		if (!checkAlphaTest<kAlphaTestFunc>(aSrc))
+			return;
+
+		if (!isBlendingEnabled<kBlendSrc>()) {
+			((uint32 *)pbuf.getRawBuffer())[pixel] = ((aSrc >> cmode.aLoss) << cmode.aShift) |
+				(rSrc << cmode.rShift) | (gSrc << cmode.gShift) | (bSrc << cmode.bShift);
+		} else if (kBlendSrc == PIPELINE_DYNAMIC) {
+			blendPixelDynamic(pixel, aSrc, rSrc, gSrc, bSrc);
 		} else {
-			byte rDst, gDst, bDst, aDst;
+			blendPixel<kBlendSrc, kBlendDst, true>(pixel, aSrc, rSrc, gSrc, bSrc);
+		}
+	}
+
+	template <int kBlendSrc>
+	FORCEINLINE bool isBlendingEnabled() const {
+		if (kBlendSrc == PIPELINE_DYNAMIC)
+			return _blendingEnabled;
+		return kBlendSrc != PIPELINE_NO_BLENDING;
+	}
+
+	// Blend with the factors set at run time, kept out of line as it is big
+	void blendPixelDynamic(int pixel, byte aSrc, byte rSrc, byte gSrc, byte bSrc);
+
+	// k8888 reads and writes the pixel directly, see is8888()
+	template <int kBlendSrc, int kBlendDst, bool k8888>
+	FORCEINLINE void blendPixel(int pixel, byte aSrc, byte rSrc, byte gSrc, byte bSrc) {
+		byte rDst, gDst, bDst, aDst;
+		if (k8888)
+			cmode.colorToARGB(((const uint32 *)pbuf.getRawBuffer())[pixel], aDst, rDst, gDst, bDst);
+		else
 			this->pbuf.getARGBAt(pixel, aDst, rDst, gDst, bDst);
-			switch (_sourceBlendingFactor) {
-			case TGL_ZERO:
-				rSrc = gSrc = bSrc = 0;
-				break;
-			case TGL_ONE:
-				break;
-			case TGL_DST_COLOR:
-				rSrc = (rDst * rSrc) >> 8;
-				gSrc = (gDst * gSrc) >> 8;
-				bSrc = (bDst * bSrc) >> 8;
-				break;
-			case TGL_ONE_MINUS_DST_COLOR:
-				rSrc = (rSrc * (255 - rDst)) >> 8;
-				gSrc = (gSrc * (255 - gDst)) >> 8;
-				bSrc = (bSrc * (255 - bDst)) >> 8;
-				break;
-			case TGL_SRC_ALPHA:
-				rSrc = (rSrc * aSrc) >> 8;
-				gSrc = (gSrc * aSrc) >> 8;
-				bSrc = (bSrc * aSrc) >> 8;
-				break;
-			case TGL_ONE_MINUS_SRC_ALPHA:
-				rSrc = (rSrc * (255 - aSrc)) >> 8;
-				gSrc = (gSrc * (255 - aSrc)) >> 8;
-				bSrc = (bSrc * (255 - aSrc)) >> 8;
-				break;
-			case TGL_DST_ALPHA:
-				rSrc = (rSrc * aDst) >> 8;
-				gSrc = (gSrc * aDst) >> 8;
-				bSrc = (bSrc * aDst) >> 8;
-				break;
-			case TGL_ONE_MINUS_DST_ALPHA:
-				rSrc = (rSrc * (255 - aDst)) >> 8;
-				gSrc = (gSrc * (255 - aDst)) >> 8;
-				bSrc = (bSrc * (255 - aDst)) >> 8;
-				break;
-			default:
-				break;
-			}
+		switch (kBlendSrc == PIPELINE_DYNAMIC ? _sourceBlendingFactor : kBlendSrc) {
+		case TGL_ZERO:
+			rSrc = gSrc = bSrc = 0;
+			break;
+		case TGL_ONE:
+			break;
+		case TGL_DST_COLOR:
+			rSrc = (rDst * rSrc) >> 8;
+			gSrc = (gDst * gSrc) >> 8;
+			bSrc = (bDst * bSrc) >> 8;
+			break;
+		case TGL_ONE_MINUS_DST_COLOR:
+			rSrc = (rSrc * (255 - rDst)) >> 8;
+			gSrc = (gSrc * (255 - gDst)) >> 8;
+			bSrc = (bSrc * (255 - bDst)) >> 8;
+			break;
+		case TGL_SRC_ALPHA:
+			rSrc = (rSrc * aSrc) >> 8;
+			gSrc = (gSrc * aSrc) >> 8;
+			bSrc = (bSrc * aSrc) >> 8;
+			break;
+		case TGL_ONE_MINUS_SRC_ALPHA:
+			rSrc = (rSrc * (255 - aSrc)) >> 8;
+			gSrc = (gSrc * (255 - aSrc)) >> 8;
+			bSrc = (bSrc * (255 - aSrc)) >> 8;
+			break;
+		case TGL_DST_ALPHA:
+			rSrc = (rSrc * aDst) >> 8;
+			gSrc = (gSrc * aDst) >> 8;
+			bSrc = (bSrc * aDst) >> 8;
+			break;
+		case TGL_ONE_MINUS_DST_ALPHA:
+			rSrc = (rSrc * (255 - aDst)) >> 8;
+			gSrc = (gSrc * (255 - aDst)) >> 8;
+			bSrc = (bSrc * (255 - aDst)) >> 8;
+			break;
+		default:
+			break;
+		}
 
-			switch (_destinationBlendingFactor) {
-			case TGL_ZERO:
-				rDst = gDst = bDst = 0;
-				break;
-			case TGL_ONE:
-				break;
-			case TGL_DST_COLOR:
-				rDst = (rDst * rSrc) >> 8;
-				gDst = (gDst * gSrc) >> 8;
-				bDst = (bDst * bSrc) >> 8;
-				break;
-			case TGL_ONE_MINUS_DST_COLOR:
-				rDst = (rDst * (255 - rSrc)) >> 8;
-				gDst = (gDst * (255 - gSrc)) >> 8;
-				bDst = (bDst * (255 - bSrc)) >> 8;
-				break;
-			case TGL_SRC_ALPHA:
-				rDst = (rDst * aSrc) >> 8;
-				gDst = (gDst * aSrc) >> 8;
-				bDst = (bDst * aSrc) >> 8;
-				break;
-			case TGL_ONE_MINUS_SRC_ALPHA:
-				rDst = (rDst * (255 - aSrc)) >> 8;
-				gDst = (gDst * (255 - aSrc)) >> 8;
-				bDst = (bDst * (255 - aSrc)) >> 8;
-				break;
-			case TGL_DST_ALPHA:
-				rDst = (rDst * aDst) >> 8;
-				gDst = (gDst * aDst) >> 8;
-				bDst = (bDst * aDst) >> 8;
-				break;
-			case TGL_ONE_MINUS_DST_ALPHA:
-				rDst = (rDst * (255 - aDst)) >> 8;
-				gDst = (gDst * (255 - aDst)) >> 8;
-				bDst = (bDst * (255 - aDst)) >> 8;
-				break;
-			case TGL_SRC_ALPHA_SATURATE: {
-				int factor = aSrc < 1 - aDst ? aSrc : 1 - aDst;
-				rDst = (rDst * factor) >> 8;
-				gDst = (gDst * factor) >> 8;
-				bDst = (bDst * factor) >> 8;
-				}
-				break;
-			default:
-				break;
+		switch (kBlendDst == PIPELINE_DYNAMIC ? _destinationBlendingFactor : kBlendDst) {
+		case TGL_ZERO:
+			rDst = gDst = bDst = 0;
+			break;
+		case TGL_ONE:
+			break;
+		case TGL_DST_COLOR:
+			rDst = (rDst * rSrc) >> 8;
+			gDst = (gDst * gSrc) >> 8;
+			bDst = (bDst * bSrc) >> 8;
+			break;
+		case TGL_ONE_MINUS_DST_COLOR:
+			rDst = (rDst * (255 - rSrc)) >> 8;
+			gDst = (gDst * (255 - gSrc)) >> 8;
+			bDst = (bDst * (255 - bSrc)) >> 8;
+			break;
+		case TGL_SRC_ALPHA:
+			rDst = (rDst * aSrc) >> 8;
+			gDst = (gDst * aSrc) >> 8;
+			bDst = (bDst * aSrc) >> 8;
+			break;
+		case TGL_ONE_MINUS_SRC_ALPHA:
+			rDst = (rDst * (255 - aSrc)) >> 8;
+			gDst = (gDst * (255 - aSrc)) >> 8;
+			bDst = (bDst * (255 - aSrc)) >> 8;
+			break;
+		case TGL_DST_ALPHA:
+			rDst = (rDst * aDst) >> 8;
+			gDst = (gDst * aDst) >> 8;
+			bDst = (bDst * aDst) >> 8;
+			break;
+		case TGL_ONE_MINUS_DST_ALPHA:
+			rDst = (rDst * (255 - aDst)) >> 8;
+			gDst = (gDst * (255 - aDst)) >> 8;
+			bDst = (bDst * (255 - aDst)) >> 8;
+			break;
+		case TGL_SRC_ALPHA_SATURATE: {
+			int factor = aSrc < 1 - aDst ? aSrc : 1 - aDst;
+			rDst = (rDst * factor) >> 8;
+			gDst = (gDst * factor) >> 8;
+			bDst = (bDst * factor) >> 8;
 			}
-			int finalR, finalG, finalB;
-			finalR = rDst + rSrc;
-			finalG = gDst + gSrc;
-			finalB = bDst + bSrc;
-			if (finalR > 255) { finalR = 255; }
-			if (finalG > 255) { finalG = 255; }
-			if (finalB > 255) { finalB = 255; }
-			this->pbuf.setPixelAt(pixel, 255, finalR, finalG, finalB);
+			break;
+		default:
+			break;
 		}
+		int finalR, finalG, finalB;
+		finalR = rDst + rSrc;
+		finalG = gDst + gSrc;
+		finalB = bDst + bSrc;
+		if (finalR > 255) { finalR = 255; }
+		if (finalG > 255) { finalG = 255; }
+		if (finalB > 255) { finalB = 255; }
+		if (k8888)
+			((uint32 *)pbuf.getRawBuffer())[pixel] = cmode.ARGBToColor(255, finalR, finalG, finalB);
+		else
+			this->pbuf.setPixelAt(pixel, 255, finalR, finalG, finalB);
 	}
 
 	void copyToBuffer(Graphics::PixelBuffer &buf) {
+		flushTiles();
 		buf.copyBuffer(0, xsize * ysize, pbuf);
 	}
 
 	void copyFromBuffer(Graphics::PixelBuffer buf) {
+		flushTiles();
+		markDirty(0, 0, xsize - 1, ysize - 1);
 		pbuf.copyBuffer(0, xsize * ysize, buf);
 	}
 
+	/**
+	 * Enable or disable the tiled rasterizer.
+	 * While it is enabled the triangles are not drawn immediately, but binned
+	 * into horizontal bands of ZB_TILE_HEIGHT lines, which are then drawn
+	 * concurrently by numThreads threads (one per processor if negative) when
+	 * flushTiles() is called. Any direct access to the buffers flushes too.
+	 */
+	void enableTiledRasterization(bool enable, int numThreads = -1);
+	bool isTiledRasterizationEnabled() const {
+		return _tiles != NULL;
+	}
+
+	/**
+	 * Draw all the queued triangles, if the tiled rasterizer is enabled.
+	 */
+	void flushTiles() {
+		if (_tiles)
+			flushTileQueue();
+	}
+
+	/**
+	 * Enable or disable the dirty rectangle tracking.
+	 * While it is enabled the frame buffer records which cells of
+	 * ZB_DIRTY_CELL_SIZE pixels of the screen the triangles, lines, clears and
+	 * blits touch. Whoever writes through getPixelBuffer() reports the area
+	 * with addDirtyRect().
+	 */
+	void enableDirtyRects(bool enable);
+	bool isDirtyRectsEnabled() const {
+		return _dirtyCells != NULL;
+	}
+
+	/**
+	 * Write length pixels of src, starting at srcPixel, to the screen starting
+	 * at pixel, through the alpha test and blending state. Each color channel
+	 * is mapped through the 256 entries of colorMap on the way.
+	 * Unlike writePixel() this does not mark the whole screen as dirty: the
+	 * caller reports the area it wrote to with addDirtyRect().
+	 */
+	void writeSpan(int pixel, const Graphics::PixelBuffer &src, int srcPixel, int length, const byte *colorMap);
+
+	/**
+	 * Mark an area of the screen as modified.
+	 */
+	void addDirtyRect(const Common::Rect &rect) {
+		markDirty(rect.left, rect.top, rect.right - 1, rect.bottom - 1);
+	}
+
+	/**
+	 * Append to rects the areas of the screen whose content changed since the
+	 * previous call, and start recording again. Cells that were drawn to but
+	 * ended up with the same pixels as before are left out.
+	 */
+	void getDirtyRects(Common::List<Common::Rect> &rects);
+
+	/**
+	 * The frame buffer keeps the depth range of every block of
+	 * ZB_DEPTH_BLOCK_SIZE pixels of the depth buffer, and skips the spans of
+	 * triangles which fail the depth test in all the blocks they cross.
+	 * This must be called after writing to zbuf directly.
+	 */
+	void invalidateDepthBlocks() {
+		_depthBlocksValid = false;
+	}
+
+	/**
+	 * Number of spans, and of pixels in them, skipped because they were
+	 * hidden since the last call to resetCullingCounters().
+	 */
+	void getCullingCounters(uint32 &spans, uint32 &pixels);
+	void resetCullingCounters();
+
 	void enableBlending(bool enable);
 	void setBlendingFactors(int sfactor, int dfactor);
 	void enableAlphaTest(bool enable);
@@ -275,6 +521,7 @@ struct FrameBuffer {
 	void setDepthFunc(int func);
 	void enableDepthWrite(bool enable) {
 		this->_depthWrite = enable;
+		updateFragmentPipeline();
 	}
 
 	/**
@@ -285,10 +532,24 @@ struct FrameBuffer {
 	void blitOffscreenBuffer(Buffer *buffer);
 	void selectOffscreenBuffer(Buffer *buffer);
 	void clearOffscreenBuffer(Buffer *buffer);
-	void setTexture(const Graphics::PixelBuffer &texture);
+	// 8 bit textures index into palette, 16 bit ones are RGB565
+	void setTexture(const Graphics::PixelBuffer &texture, int width, int height,
+	                const Graphics::PixelBuffer &palette = Graphics::PixelBuffer());
+
+	// Index in the current texture of the texel at the fixed point coordinates s and t.
+	// The texture repeats, power of two sizes wrap with the masks alone.
+	FORCEINLINE int getTexelIndex(unsigned int s, unsigned int t) const {
+		unsigned int sss = (s & _textureSMask) >> ZB_POINT_ST_FRAC_BITS;
+		unsigned int ttt = (t & _textureTMask) >> ZB_POINT_ST_FRAC_BITS;
+		if (sss >= (unsigned int)_textureWidth)
+			sss = wrapTexelCoord(s, _textureWidth);
+		if (ttt >= (unsigned int)_textureHeight)
+			ttt = wrapTexelCoord(t, _textureHeight);
+		return ttt * _textureWidth + sss;
+	}
 
-	template <bool interpRGB, bool interpZ, bool interpST, bool interpSTZ, int drawLogic, bool depthWrite>
-	void fillTriangle(ZBufferPoint *p0, ZBufferPoint *p1, ZBufferPoint *p2);
+	template <bool interpRGB, bool interpZ, bool interpST, bool interpSTZ, int drawLogic>
+	void fillTriangle(ZBufferPoint *p0, ZBufferPoint *p1, ZBufferPoint *p2, DrawSpanProc drawSpan);
 
 	template <bool interpRGB, bool interpZ, bool depthWrite>
 	void fillLineGeneric(ZBufferPoint *p1, ZBufferPoint *p2, int color);
@@ -327,11 +588,75 @@ struct FrameBuffer {
 	unsigned char *dctable;
 	int *ctable;
 	Graphics::PixelBuffer current_texture;
-	int _textureSize;
-	int _textureSizeMask;
+	Graphics::PixelBuffer current_texture_palette;
+	int _textureWidth;
+	int _textureHeight;
+	unsigned int _textureSMask;
+	unsigned int _textureTMask;
 
 private:
 
+	// Worker view sharing the buffers of parent, used by the tiled rasterizer
+	FrameBuffer(FrameBuffer *parent);
+
+	RasterizationState captureState() const;
+	void applyState(const RasterizationState &state);
+	void queueTriangle(FillTriangleProc proc, ZBufferPoint *p0, ZBufferPoint *p1, ZBufferPoint *p2);
+	void flushTileQueue();
+	static void drawTileJob(void *data, int job, int thread);
+
+	static unsigned int wrapTexelCoord(unsigned int s, int size);
+
+	// Mark the cell of a single pixel
+	FORCEINLINE void markDirty(int pixel) {
+		if (_dirtyCells) {
+			int y = pixel / xsize;
+			int x = pixel - y * xsize;
+			_dirtyCells[(y / ZB_DIRTY_CELL_SIZE) * _dirtyCellsWidth + x / ZB_DIRTY_CELL_SIZE] = 1;
+		}
+	}
+	// Mark the cells covering the pixels from (x0, y0) to (x1, y1) included
+	FORCEINLINE void markDirty(int x0, int y0, int x1, int y1) {
+		if (_dirtyCells)
+			markDirtyCells(x0, y0, x1, y1);
+	}
+	FORCEINLINE void markDirty(const ZBufferPoint *p0, const ZBufferPoint *p1, const ZBufferPoint *p2) {
+		if (_dirtyCells)
+			markDirtyCells(MIN(p0->x, MIN(p1->x, p2->x)), MIN(p0->y, MIN(p1->y, p2->y)),
+			               MAX(p0->x, MAX(p1->x, p2->x)), MAX(p0->y, MAX(p1->y, p2->y)));
+	}
+	void markDirtyCells(int x0, int y0, int x1, int y1);
+
+	// Recompute the depth range of all the blocks from zbuf
+	void updateDepthBlocks();
+	// Whether the depth test fails for all the pixels from (x0, y) to (x1, y)
+	// included, whose depths are between zMin and zMax
+	bool isSpanHidden(int y, int x0, int x1, unsigned int zMin, unsigned int zMax) const;
+	// Widen the depth range of the blocks after depths between zMin and zMax
+	// were written from (x0, y) to (x1, y) included
+	void updateDepthBlocks(int y, int x0, int x1, unsigned int zMin, unsigned int zMax);
+
+	// Select the span routines matching the depth, alpha test and blending state
+	void updateFragmentPipeline();
+	int _fragmentPipeline;
+
+	TileQueue *_tiles;
+	int _clipYMin, _clipYMax;
+
+	byte *_dirtyCells;
+	int _dirtyCellsWidth, _dirtyCellsHeight;
+	// Compare all the cells on the next getDirtyRects(), after writes that
+	// are not tracked by cell: enabling the tracking and blitOffscreenBuffer()
+	bool _allDirty;
+	// Content of the screen as of the last getDirtyRects() call
+	byte *_presentedFrame;
+
+	// Lower and upper bounds of the depths stored in each block
+	unsigned int *_depthBlockMin, *_depthBlockMax;
+	int _depthBlocksWidth, _depthBlocksHeight;
+	bool _depthBlocksValid;
+	uint32 _culledSpans, _culledPixels;
+
 	bool _depthWrite;
 	Graphics::PixelBuffer pbuf;
 	bool _blendingEnabled;
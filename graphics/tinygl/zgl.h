@@ -133,6 +133,7 @@ struct GLImage {
 
 struct GLTexture {
 	GLImage images[MAX_TEXTURE_LEVELS];
+	Graphics::PixelBuffer palette; // used by TGL_COLOR_INDEX images
 	int handle;
 	struct GLTexture *next, *prev;
 };
@@ -155,7 +156,7 @@ struct GLContext {
 	// Z buffer
 	FrameBuffer *fb;
 
-	// Internal texture size
+	// Maximum texture size, larger textures are scaled down
 	int _textureSize;
 
 	// lights
@@ -253,6 +254,11 @@ struct GLContext {
 	int texcoord_array_size;
 	int texcoord_array_stride;
 	int client_states;
+	// vertices transformed by glDrawArrays / glDrawElements
+	GLVertex *array_vertex;
+	unsigned int *array_vertex_stamp;
+	unsigned int array_stamp;
+	int array_vertex_max;
 
 	// opengl 1.1 polygon offset
 	float offset_factor;
@@ -283,8 +289,6 @@ struct GLContext {
 	bool enableBlend;
 };
 
-extern GLContext *gl_ctx;
-
 void gl_add_op(GLParam *p);
 
 // clip.c
@@ -306,6 +310,9 @@ void gl_add_select(GLContext *c, unsigned int zmin, unsigned int zmax);
 void gl_enable_disable_light(GLContext *c, int light, int v);
 void gl_shade_vertex(GLContext *c, GLVertex *v);
 
+// vertex.c
+void gl_process_vertex(GLContext *c, GLVertex *v);
+
 void glInitTextures(GLContext *c);
 void glEndTextures(GLContext *c);
 GLTexture *alloc_texture(GLContext *c, int h);
@@ -315,16 +322,19 @@ void free_texture(GLContext *c, int h);
 void gl_resizeImage(unsigned char *dest, int xsize_dest, int ysize_dest,
 					unsigned char *src, int xsize_src, int ysize_src);
 void gl_resizeImageNoInterpolate(unsigned char *dest, int xsize_dest, int ysize_dest,
-								 unsigned char *src, int xsize_src, int ysize_src);
-
-GLContext *gl_get_context();
+								 unsigned char *src, int xsize_src, int ysize_src, int bytesPerPixel = 4);
 
 // specular buffer "api"
 GLSpecBuf *specbuf_get_buffer(GLContext *c, const int shininess_i, const float shininess);
 void specbuf_cleanup(GLContext *c); // free all memory used
 
-void glInit(void *zbuffer, int textureSize);
-void glClose();
+// Create a context drawing into zbuffer. The context is not made current.
+GLContext *createContext(FrameBuffer *zbuffer, int textureSize);
+void destroyContext(GLContext *c);
+
+// The tgl* functions work on the context current in the calling thread
+void setCurrentContext(GLContext *c);
+GLContext *gl_get_context();
 
 #ifdef DEBUG
 #define dprintf fprintf
@@ -10,9 +10,9 @@ FORCEINLINE static void putPixel(FrameBuffer *buffer, int pixelOffset,
 	if (interpZ) {
 		if (buffer->compareDepth(z, *pz)) {
 			if (interpRGB) {
-				buffer->writePixel(pixelOffset, RGB_TO_PIXEL(r, g, b));
+				buffer->writePixel<PIPELINE_DYNAMIC, PIPELINE_DYNAMIC, PIPELINE_DYNAMIC>(pixelOffset, RGB_TO_PIXEL(r, g, b));
 			} else {
-				buffer->writePixel(pixelOffset, color);
+				buffer->writePixel<PIPELINE_DYNAMIC, PIPELINE_DYNAMIC, PIPELINE_DYNAMIC>(pixelOffset, color);
 			}
 			if (depthWrite) {
 				*pz = z;
@@ -20,9 +20,9 @@ FORCEINLINE static void putPixel(FrameBuffer *buffer, int pixelOffset,
 		}
 	} else {
 		if (interpRGB) {
-			buffer->writePixel(pixelOffset, RGB_TO_PIXEL(r, g, b));
+			buffer->writePixel<PIPELINE_DYNAMIC, PIPELINE_DYNAMIC, PIPELINE_DYNAMIC>(pixelOffset, RGB_TO_PIXEL(r, g, b));
 		} else {
-			buffer->writePixel(pixelOffset, color);
+			buffer->writePixel<PIPELINE_DYNAMIC, PIPELINE_DYNAMIC, PIPELINE_DYNAMIC>(pixelOffset, color);
 		}
 	}
 }
@@ -123,13 +123,18 @@ void FrameBuffer::plot(ZBufferPoint *p) {
 	unsigned int *pz;
 	unsigned int r, g, b;
 
+	flushTiles();
+	markDirty(p->x, p->y, p->x, p->y);
+	// Points and lines don't keep the depth blocks up to date
+	invalidateDepthBlocks();
+
 	pz = zbuf + (p->y * xsize + p->x);
 	int col = RGB_TO_PIXEL(p->r, p->g, p->b);
 	unsigned int z = p->z;
 	if (_depthWrite)
-		putPixel<false, true, true>(this, linesize * p->y + p->x * PSZB, cmode, pz, z, col, r, g, b);
+		putPixel<false, true, true>(this, linesize * p->y + p->x * pixelbytes, cmode, pz, z, col, r, g, b);
 	else 
-		putPixel<false, true, false>(this, linesize * p->y + p->x * PSZB, cmode, pz, z, col, r, g, b);
+		putPixel<false, true, false>(this, linesize * p->y + p->x * pixelbytes, cmode, pz, z, col, r, g, b);
 }
 
 void FrameBuffer::fillLineFlatZ(ZBufferPoint *p1, ZBufferPoint *p2, int color) {
@@ -165,6 +170,10 @@ void FrameBuffer::fillLineInterp(ZBufferPoint *p1, ZBufferPoint *p2) {
 void FrameBuffer::fillLineZ(ZBufferPoint *p1, ZBufferPoint *p2) {
 	int color1, color2;
 
+	flushTiles();
+	markDirty(MIN(p1->x, p2->x), MIN(p1->y, p2->y), MAX(p1->x, p2->x), MAX(p1->y, p2->y));
+	invalidateDepthBlocks();
+
 	color1 = RGB_TO_PIXEL(p1->r, p1->g, p1->b);
 	color2 = RGB_TO_PIXEL(p2->r, p2->g, p2->b);
 
@@ -179,6 +188,9 @@ void FrameBuffer::fillLineZ(ZBufferPoint *p1, ZBufferPoint *p2) {
 void FrameBuffer::fillLine(ZBufferPoint *p1, ZBufferPoint *p2) {
 	int color1, color2;
 
+	flushTiles();
+	markDirty(MIN(p1->x, p2->x), MIN(p1->y, p2->y), MAX(p1->x, p2->x), MAX(p1->y, p2->y));
+
 	color1 = RGB_TO_PIXEL(p1->r, p1->g, p1->b);
 	color2 = RGB_TO_PIXEL(p2->r, p2->g, p2->b);
 
@@ -0,0 +1,113 @@
+#ifndef GRAPHICS_TINYGL_ZSIMD_H
+#define GRAPHICS_TINYGL_ZSIMD_H
+
+// Minimal set of 4 x 32 bit vector operations used by the span routines in
+// ztriangle.cpp. The kernels are written once against these helpers and
+// compiled for whichever instruction set the target provides.
+
+#include "common/scummsys.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TINYGL_SIMD_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define TINYGL_SIMD_NEON
+#endif
+
+#if defined(TINYGL_SIMD_SSE2)
+#include <emmintrin.h>
+#elif defined(TINYGL_SIMD_NEON)
+#include <arm_neon.h>
+#endif
+
+#if defined(TINYGL_SIMD_SSE2) || defined(TINYGL_SIMD_NEON)
+#define TINYGL_SIMD
+
+namespace TinyGL {
+namespace SIMD {
+
+#if defined(TINYGL_SIMD_SSE2)
+
+typedef __m128i Vec;
+
+FORCEINLINE Vec load(const uint32 *p) { return _mm_loadu_si128((const __m128i *)p); }
+FORCEINLINE void store(uint32 *p, Vec v) { _mm_storeu_si128((__m128i *)p, v); }
+FORCEINLINE Vec set1(uint32 v) { return _mm_set1_epi32((int)v); }
+FORCEINLINE Vec set(uint32 v0, uint32 v1, uint32 v2, uint32 v3) { return _mm_setr_epi32((int)v0, (int)v1, (int)v2, (int)v3); }
+FORCEINLINE Vec add(Vec a, Vec b) { return _mm_add_epi32(a, b); }
+FORCEINLINE Vec bitAnd(Vec a, Vec b) { return _mm_and_si128(a, b); }
+FORCEINLINE Vec bitOr(Vec a, Vec b) { return _mm_or_si128(a, b); }
+FORCEINLINE Vec shiftLeft(Vec v, int n) { return _mm_sll_epi32(v, _mm_cvtsi32_si128(n)); }
+FORCEINLINE Vec shiftRight(Vec v, int n) { return _mm_srl_epi32(v, _mm_cvtsi32_si128(n)); }
+
+// Lanes of mask must be all ones or all zeros
+FORCEINLINE Vec select(Vec mask, Vec a, Vec b) {
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// SSE2 only has signed comparisons, flipping the sign bits makes them unsigned
+FORCEINLINE Vec lessThan(Vec a, Vec b) {
+	const __m128i bias = _mm_set1_epi32((int)0x80000000);
+	return _mm_cmplt_epi32(_mm_xor_si128(a, bias), _mm_xor_si128(b, bias));
+}
+
+FORCEINLINE Vec lessEqual(Vec a, Vec b) {
+	const __m128i bias = _mm_set1_epi32((int)0x80000000);
+	return _mm_xor_si128(_mm_cmpgt_epi32(_mm_xor_si128(a, bias), _mm_xor_si128(b, bias)), _mm_set1_epi32(-1));
+}
+
+// Both operands and the product of every lane must fit in 16 bits
+FORCEINLINE Vec mul16(Vec a, Vec b) { return _mm_mullo_epi16(a, b); }
+
+FORCEINLINE bool any(Vec mask) { return _mm_movemask_epi8(mask) != 0; }
+
+// Store the low 16 bits of the eight lanes of lo and hi where the masks are set
+FORCEINLINE void storeMasked16(uint16 *p, Vec lo, Vec hi, Vec maskLo, Vec maskHi) {
+	// Sign extend first, so the saturating pack keeps the low 16 bits as they are
+	lo = _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16);
+	hi = _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16);
+	__m128i color = _mm_packs_epi32(lo, hi);
+	__m128i mask = _mm_packs_epi32(maskLo, maskHi);
+	__m128i old = _mm_loadu_si128((const __m128i *)p);
+	_mm_storeu_si128((__m128i *)p, select(mask, color, old));
+}
+
+#elif defined(TINYGL_SIMD_NEON)
+
+typedef uint32x4_t Vec;
+
+FORCEINLINE Vec load(const uint32 *p) { return vld1q_u32(p); }
+FORCEINLINE void store(uint32 *p, Vec v) { vst1q_u32(p, v); }
+FORCEINLINE Vec set1(uint32 v) { return vdupq_n_u32(v); }
+FORCEINLINE Vec set(uint32 v0, uint32 v1, uint32 v2, uint32 v3) {
+	const uint32 v[4] = { v0, v1, v2, v3 };
+	return vld1q_u32(v);
+}
+FORCEINLINE Vec add(Vec a, Vec b) { return vaddq_u32(a, b); }
+FORCEINLINE Vec bitAnd(Vec a, Vec b) { return vandq_u32(a, b); }
+FORCEINLINE Vec bitOr(Vec a, Vec b) { return vorrq_u32(a, b); }
+FORCEINLINE Vec shiftLeft(Vec v, int n) { return vshlq_u32(v, vdupq_n_s32(n)); }
+FORCEINLINE Vec shiftRight(Vec v, int n) { return vshlq_u32(v, vdupq_n_s32(-n)); }
+FORCEINLINE Vec select(Vec mask, Vec a, Vec b) { return vbslq_u32(mask, a, b); }
+FORCEINLINE Vec lessThan(Vec a, Vec b) { return vcltq_u32(a, b); }
+FORCEINLINE Vec lessEqual(Vec a, Vec b) { return vcleq_u32(a, b); }
+FORCEINLINE Vec mul16(Vec a, Vec b) { return vmulq_u32(a, b); }
+
+FORCEINLINE bool any(Vec mask) {
+	uint32x2_t m = vorr_u32(vget_low_u32(mask), vget_high_u32(mask));
+	return (vget_lane_u32(m, 0) | vget_lane_u32(m, 1)) != 0;
+}
+
+FORCEINLINE void storeMasked16(uint16 *p, Vec lo, Vec hi, Vec maskLo, Vec maskHi) {
+	uint16x8_t color = vcombine_u16(vmovn_u32(lo), vmovn_u32(hi));
+	uint16x8_t mask = vcombine_u16(vmovn_u32(maskLo), vmovn_u32(maskHi));
+	vst1q_u16(p, vbslq_u16(mask, color, vld1q_u16(p)));
+}
+
+#endif
+
+} // end of namespace SIMD
+} // end of namespace TinyGL
+
+#endif // TINYGL_SIMD
+
+#endif
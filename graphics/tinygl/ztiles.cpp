@@ -0,0 +1,230 @@
+// Tiled rasterizer: triangles are binned into horizontal bands of the frame
+// buffer, and the bands are drawn concurrently when the queue is flushed.
+
+#include "common/threadpool.h"
+
+#include "graphics/tinygl/zbuffer.h"
+#include "graphics/tinygl/zgl.h"
+
+namespace TinyGL {
+
+struct QueuedTriangle {
+	ZBufferPoint p[3];
+	FrameBuffer::FillTriangleProc proc;
+	int state;
+};
+
+struct TileQueue {
+	TileQueue(int numThreads) : pool(numThreads) { }
+
+	Common::ThreadPool pool;
+	Common::Array<FrameBuffer *> views;
+	Common::Array<RasterizationState> states;
+	Common::Array<QueuedTriangle> triangles;
+	Common::Array<Common::Array<uint32> > bins;
+};
+
+bool RasterizationState::operator==(const RasterizationState &other) const {
+	return depthWrite == other.depthWrite &&
+		depthFunc == other.depthFunc &&
+		blendingEnabled == other.blendingEnabled &&
+		sourceBlendingFactor == other.sourceBlendingFactor &&
+		destinationBlendingFactor == other.destinationBlendingFactor &&
+		alphaTestEnabled == other.alphaTestEnabled &&
+		alphaTestFunc == other.alphaTestFunc &&
+		alphaTestRefVal == other.alphaTestRefVal &&
+		texture.getRawBuffer() == other.texture.getRawBuffer() &&
+		texture.getFormat() == other.texture.getFormat() &&
+		texturePalette.getRawBuffer() == other.texturePalette.getRawBuffer() &&
+		textureWidth == other.textureWidth &&
+		textureHeight == other.textureHeight &&
+		shadowMaskBuf == other.shadowMaskBuf &&
+		shadowColorR == other.shadowColorR &&
+		shadowColorG == other.shadowColorG &&
+		shadowColorB == other.shadowColorB;
+}
+
+FrameBuffer::FrameBuffer(FrameBuffer *parent) : _tiles(NULL),
+	_dirtyCells(NULL), _dirtyCellsWidth(0), _dirtyCellsHeight(0), _allDirty(false), _presentedFrame(NULL),
+	_culledSpans(0), _culledPixels(0) {
+	xsize = parent->xsize;
+	ysize = parent->ysize;
+	linesize = parent->linesize;
+	cmode = parent->cmode;
+	pixelbits = parent->pixelbits;
+	pixelbytes = parent->pixelbytes;
+	frame_buffer_allocated = 0;
+	zbuf = parent->zbuf;
+	pbuf = parent->pbuf;
+	_depthBlockMin = parent->_depthBlockMin;
+	_depthBlockMax = parent->_depthBlockMax;
+	_depthBlocksWidth = parent->_depthBlocksWidth;
+	_depthBlocksHeight = parent->_depthBlocksHeight;
+	_depthBlocksValid = false;
+	_clipYMin = 0;
+	_clipYMax = ysize;
+	applyState(parent->captureState());
+}
+
+RasterizationState FrameBuffer::captureState() const {
+	RasterizationState state;
+	state.depthWrite = _depthWrite;
+	state.depthFunc = _depthFunc;
+	state.blendingEnabled = _blendingEnabled;
+	state.sourceBlendingFactor = _sourceBlendingFactor;
+	state.destinationBlendingFactor = _destinationBlendingFactor;
+	state.alphaTestEnabled = _alphaTestEnabled;
+	state.alphaTestFunc = _alphaTestFunc;
+	state.alphaTestRefVal = _alphaTestRefVal;
+	state.texture = current_texture;
+	state.texturePalette = current_texture_palette;
+	state.textureWidth = _textureWidth;
+	state.textureHeight = _textureHeight;
+	state.shadowMaskBuf = shadow_mask_buf;
+	state.shadowColorR = shadow_color_r;
+	state.shadowColorG = shadow_color_g;
+	state.shadowColorB = shadow_color_b;
+	return state;
+}
+
+void FrameBuffer::applyState(const RasterizationState &state) {
+	_depthWrite = state.depthWrite;
+	_depthFunc = state.depthFunc;
+	_blendingEnabled = state.blendingEnabled;
+	_sourceBlendingFactor = state.sourceBlendingFactor;
+	_destinationBlendingFactor = state.destinationBlendingFactor;
+	_alphaTestEnabled = state.alphaTestEnabled;
+	_alphaTestFunc = state.alphaTestFunc;
+	_alphaTestRefVal = state.alphaTestRefVal;
+	setTexture(state.texture, state.textureWidth, state.textureHeight, state.texturePalette);
+	shadow_mask_buf = state.shadowMaskBuf;
+	shadow_color_r = state.shadowColorR;
+	shadow_color_g = state.shadowColorG;
+	shadow_color_b = state.shadowColorB;
+	updateFragmentPipeline();
+}
+
+void FrameBuffer::enableTiledRasterization(bool enable, int numThreads) {
+	if (_tiles) {
+		flushTileQueue();
+		for (uint i = 0; i < _tiles->views.size(); i++) {
+			// The views share the buffers of this frame buffer
+			_tiles->views[i]->zbuf = NULL;
+			_tiles->views[i]->_depthBlockMin = NULL;
+			_tiles->views[i]->_depthBlockMax = NULL;
+			delete _tiles->views[i];
+		}
+		delete _tiles;
+		_tiles = NULL;
+	}
+
+	if (!enable)
+		return;
+
+	if (numThreads < 0)
+		numThreads = Common::ThreadPool::getNumProcessors();
+
+	_tiles = new TileQueue(numThreads);
+	for (int i = 0; i < _tiles->pool.getNumThreads(); i++)
+		_tiles->views.push_back(new FrameBuffer(this));
+	_tiles->bins.resize((ysize + ZB_TILE_HEIGHT - 1) / ZB_TILE_HEIGHT);
+}
+
+void FrameBuffer::queueTriangle(FillTriangleProc proc, ZBufferPoint *p0, ZBufferPoint *p1, ZBufferPoint *p2) {
+	int minY = MIN(p0->y, MIN(p1->y, p2->y));
+	int maxY = MAX(p0->y, MAX(p1->y, p2->y));
+	if (maxY < 0 || minY >= ysize)
+		return;
+
+	RasterizationState state = captureState();
+	if (_tiles->states.empty() || !(_tiles->states.back() == state))
+		_tiles->states.push_back(state);
+
+	QueuedTriangle triangle;
+	triangle.p[0] = *p0;
+	triangle.p[1] = *p1;
+	triangle.p[2] = *p2;
+	triangle.proc = proc;
+	triangle.state = _tiles->states.size() - 1;
+
+	uint32 index = _tiles->triangles.size();
+	_tiles->triangles.push_back(triangle);
+
+	int firstBin = MAX(minY, 0) / ZB_TILE_HEIGHT;
+	int lastBin = MIN(maxY, ysize - 1) / ZB_TILE_HEIGHT;
+	for (int i = firstBin; i <= lastBin; i++)
+		_tiles->bins[i].push_back(index);
+}
+
+void FrameBuffer::drawTileJob(void *data, int job, int thread) {
+	TileQueue *tiles = (TileQueue *)data;
+	FrameBuffer *view = tiles->views[thread];
+	const Common::Array<uint32> &bin = tiles->bins[job];
+
+	view->_clipYMin = job * ZB_TILE_HEIGHT;
+	view->_clipYMax = MIN(view->_clipYMin + ZB_TILE_HEIGHT, view->ysize);
+
+	int currentState = -1;
+	for (uint i = 0; i < bin.size(); i++) {
+		const QueuedTriangle &triangle = tiles->triangles[bin[i]];
+		if (triangle.state != currentState) {
+			view->applyState(tiles->states[triangle.state]);
+			currentState = triangle.state;
+		}
+		// The fill functions write to the points, so each band works on its own copy
+		ZBufferPoint p0 = triangle.p[0];
+		ZBufferPoint p1 = triangle.p[1];
+		ZBufferPoint p2 = triangle.p[2];
+		(view->*triangle.proc)(&p0, &p1, &p2);
+	}
+}
+
+void FrameBuffer::flushTileQueue() {
+	if (_tiles->triangles.empty())
+		return;
+
+	// The bands update the depth blocks they cover as they draw
+	if (!_depthBlocksValid)
+		updateDepthBlocks();
+
+	for (uint i = 0; i < _tiles->views.size(); i++) {
+		FrameBuffer *view = _tiles->views[i];
+		view->pbuf = pbuf;
+		view->zbuf = zbuf;
+		view->_depthBlocksValid = true;
+	}
+
+	_tiles->pool.run(&FrameBuffer::drawTileJob, _tiles, _tiles->bins.size());
+
+	// resize() keeps the storage around for the next frame
+	_tiles->triangles.resize(0);
+	_tiles->states.resize(0);
+	for (uint i = 0; i < _tiles->bins.size(); i++)
+		_tiles->bins[i].resize(0);
+}
+
+void FrameBuffer::getCullingCounters(uint32 &spans, uint32 &pixels) {
+	flushTiles();
+	spans = _culledSpans;
+	pixels = _culledPixels;
+	if (_tiles) {
+		for (uint i = 0; i < _tiles->views.size(); i++) {
+			spans += _tiles->views[i]->_culledSpans;
+			pixels += _tiles->views[i]->_culledPixels;
+		}
+	}
+}
+
+void FrameBuffer::resetCullingCounters() {
+	flushTiles();
+	_culledSpans = 0;
+	_culledPixels = 0;
+	if (_tiles) {
+		for (uint i = 0; i < _tiles->views.size(); i++) {
+			_tiles->views[i]->_culledSpans = 0;
+			_tiles->views[i]->_culledPixels = 0;
+		}
+	}
+}
+
+} // end of namespace TinyGL
@@ -1,7 +1,7 @@
-
 #include "common/endian.h"
 #include "graphics/tinygl/zbuffer.h"
 #include "graphics/tinygl/zgl.h"
+#include "graphics/tinygl/zsimd.h"
 
 namespace TinyGL {
 
@@ -9,54 +9,167 @@ static const int NB_INTERP = 8;
 
 #define SAR_RND_TO_ZERO(v,n) (v / (1 << n))
 
-template <bool depthWrite>
+// Values that stay constant over a triangle, and where the current span starts
+struct ZBufferSpan {
+	int color;
+	int dzdx;
+	int dadx;
+	unsigned int drgbdx;
+	int drdx, dgdx, dbdx;
+	float fdzdx, fndzdx;
+	float dszdx, dtzdx, ndszdx, ndtzdx;
+	const byte *texels;
+	int texelBytes;
+	const uint32 *texturePalette;
+	Graphics::PixelFormat textureFormat; // of the 32 bit values given by fetchTexel()
+
+	int n; // number of pixels, minus one
+	int buf;
+	unsigned int *pz;
+	int pm; // bit of the first pixel in the shadow mask
+	int z;
+	int r, g, b, a;
+	float sz, tz;
+};
+
+// Texel at index pixel as a 32 bit value in span.textureFormat
+template <int kTexelBytes>
+FORCEINLINE static uint32 fetchTexel(const ZBufferSpan &span, int pixel) {
+	if (kTexelBytes == 1) {
+		return span.texturePalette[span.texels[pixel]];
+	} else if (kTexelBytes == 2) {
+		uint32 col = ((const uint16 *)span.texels)[pixel];
+		return 0xFF000000 | ((col & 0xF800) << 8) | ((col & 0x07E0) << 5) | ((col & 0x001F) << 3);
+	} else {
+		return ((const uint32 *)span.texels)[pixel];
+	}
+}
+
+FORCEINLINE static uint32 fetchTexel(const ZBufferSpan &span, int pixel) {
+	switch (span.texelBytes) {
+	case 1:
+		return fetchTexel<1>(span, pixel);
+	case 2:
+		return fetchTexel<2>(span, pixel);
+	default:
+		return fetchTexel<4>(span, pixel);
+	}
+}
+
+// Color interpolated along a span. The generic spans pack the channels in a
+// single value, from which RGB565 pixels are quickly made.
+template <bool k8888>
+struct SpanColor {
+	unsigned int rgb;
+	unsigned int drgbdx;
+
+	SpanColor(const ZBufferSpan &span) {
+		rgb = (span.r << 16) & 0xFFC00000;
+		rgb |= (span.g >> 5) & 0x000007FF;
+		rgb |= (span.b << 5) & 0x001FF000;
+		drgbdx = span.drgbdx;
+	}
+
+	FORCEINLINE void get(unsigned int &r, unsigned int &g, unsigned int &b) const {
+		unsigned int tmp = rgb & 0xF81F07E0;
+		unsigned int light = tmp | (tmp >> 16);
+		r = (light & 0xF800) >> 8;
+		g = (light & 0x07E0) >> 3;
+		b = (light & 0x001F) << 3;
+	}
+
+	FORCEINLINE void step() {
+		rgb = (rgb + drgbdx) & (~0x00200800);
+	}
+};
+
+// The 8888 spans interpolate each channel with its full precision
+template <>
+struct SpanColor<true> {
+	int r, g, b;
+	int drdx, dgdx, dbdx;
+
+	SpanColor(const ZBufferSpan &span) : r(span.r), g(span.g), b(span.b),
+		drdx(span.drdx), dgdx(span.dgdx), dbdx(span.dbdx) {
+	}
+
+	FORCEINLINE void get(unsigned int &rOut, unsigned int &gOut, unsigned int &bOut) const {
+		rOut = r >> 8;
+		gOut = g >> 8;
+		bOut = b >> 8;
+	}
+
+	FORCEINLINE void step() {
+		r += drdx;
+		g += dgdx;
+		b += dbdx;
+	}
+};
+
+template <int kPipeline>
+FORCEINLINE static void writeSmoothPixel(FrameBuffer *buffer, int pixel, const SpanColor<false> &color) {
+	typedef FragmentPipeline<kPipeline> P;
+	unsigned int tmp = color.rgb & 0xF81F07E0;
+	buffer->writePixel<P::alphaTestFunc, P::blendSrc, P::blendDst>(pixel, tmp | (tmp >> 16));
+}
+
+template <int kPipeline>
+FORCEINLINE static void writeSmoothPixel(FrameBuffer *buffer, int pixel, const SpanColor<true> &color) {
+	typedef FragmentPipeline<kPipeline> P;
+	buffer->writePixel8888<P::alphaTestFunc, P::blendSrc, P::blendDst>(pixel, 255, color.r >> 8, color.g >> 8, color.b >> 8);
+}
+
+template <int kPipeline, bool k8888>
 FORCEINLINE static void putPixelFlat(FrameBuffer *buffer, int buf, unsigned int *pz, int _a,
-                                     unsigned int &z, int color, int &dzdx) {
-	if (buffer->compareDepth(z, pz[_a])) {
-		buffer->writePixel(buf + _a, color);
-		if (depthWrite) {
+                                     unsigned int &z, int color, int dzdx) {
+	typedef FragmentPipeline<kPipeline> P;
+	if (buffer->compareDepth<P::depthFunc>(z, pz[_a])) {
+		if (k8888)
+			buffer->writePixel8888<P::alphaTestFunc, P::blendSrc, P::blendDst>(buf + _a, color);
+		else
+			buffer->writePixel<P::alphaTestFunc, P::blendSrc, P::blendDst>(buf + _a, color);
+		if (P::depthWrite) {
 			pz[_a] = z;
 		}
 	}
 	z += dzdx;
 }
 
-template <bool depthWrite>
+template <int kPipeline, bool k8888>
 FORCEINLINE static void putPixelSmooth(FrameBuffer *buffer, int buf, unsigned int *pz, int _a,
-                                       unsigned int &z, int &tmp, unsigned int &rgb, int &dzdx, unsigned int &drgbdx) {
-	if (buffer->compareDepth(z, pz[_a])) {
-		tmp = rgb & 0xF81F07E0;
-		buffer->writePixel(buf + _a, tmp | (tmp >> 16));
-		if (depthWrite) {
+                                       unsigned int &z, SpanColor<k8888> &color, int dzdx) {
+	typedef FragmentPipeline<kPipeline> P;
+	if (buffer->compareDepth<P::depthFunc>(z, pz[_a])) {
+		writeSmoothPixel<kPipeline>(buffer, buf + _a, color);
+		if (P::depthWrite) {
 			pz[_a] = z;
 		}
 	}
 	z += dzdx;
-	rgb = (rgb + drgbdx) & (~0x00200800);
+	color.step();
 }
 
-template <bool depthWrite>
-FORCEINLINE static void putPixelDepth(FrameBuffer *buffer, unsigned int *pz, int _a, unsigned int &z, int &dzdx) {
-	if (buffer->compareDepth(z, pz[_a])) {
-		if (depthWrite) {
+template <int kPipeline>
+FORCEINLINE static void putPixelDepth(FrameBuffer *buffer, unsigned int *pz, int _a, unsigned int &z, int dzdx) {
+	typedef FragmentPipeline<kPipeline> P;
+	if (buffer->compareDepth<P::depthFunc>(z, pz[_a])) {
+		if (P::depthWrite) {
 			pz[_a] = z;
 		}
 	}
 	z += dzdx;
 }
 
-template <bool depthWrite, bool lightsMode, bool smoothMode>
+template <int kPipeline, bool lightsMode, bool smoothMode, bool k8888>
 FORCEINLINE static void putPixelTextureMappingPerspective(FrameBuffer *buffer, int buf,
-                        Graphics::PixelFormat &textureFormat, Graphics::PixelBuffer &texture, unsigned int *pz, int _a,
-                        unsigned int &z, unsigned int &t, unsigned int &s, int &tmp, unsigned int &rgba, unsigned int &a,
-                        int &dzdx, int &dsdx, int &dtdx, unsigned int &drgbdx, unsigned int dadx) {
-	if (buffer->compareDepth(z, pz[_a])) {
-		unsigned sss = (s & buffer->_textureSizeMask) >> ZB_POINT_ST_FRAC_BITS;
-		unsigned ttt = (t & buffer->_textureSizeMask) >> ZB_POINT_ST_FRAC_BITS;
-		int pixel = ttt * buffer->_textureSize + sss;
+                        const ZBufferSpan &span, unsigned int *pz, int _a,
+                        unsigned int &z, unsigned int &t, unsigned int &s, SpanColor<k8888> &color, unsigned int &a,
+                        int dzdx, int dsdx, int dtdx, unsigned int dadx) {
+	typedef FragmentPipeline<kPipeline> P;
+	if (buffer->compareDepth<P::depthFunc>(z, pz[_a])) {
+		const Graphics::PixelFormat &textureFormat = span.textureFormat;
 		uint8 c_a, c_r, c_g, c_b;
-		uint32 *textureBuffer = (uint32 *)texture.getRawBuffer(pixel);
-		uint32 col = *textureBuffer;
+		uint32 col = fetchTexel(span, buffer->getTexelIndex(s, t));
 		c_a = (col >> textureFormat.aShift) & 0xFF;
 		c_r = (col >> textureFormat.rShift) & 0xFF;
 		c_g = (col >> textureFormat.gShift) & 0xFF;
@@ -64,17 +177,17 @@ FORCEINLINE static void putPixelTextureMappingPerspective(FrameBuffer *buffer, i
 		unsigned int l_a = (a / 256);
 		c_a = (c_a * l_a) / 256;
 		if (lightsMode) {
-			tmp = rgba & 0xF81F07E0;
-			unsigned int light = tmp | (tmp >> 16);
-			unsigned int l_r = (light & 0xF800) >> 8;
-			unsigned int l_g = (light & 0x07E0) >> 3;
-			unsigned int l_b = (light & 0x001F) << 3;
+			unsigned int l_r, l_g, l_b;
+			color.get(l_r, l_g, l_b);
 			c_r = (c_r * l_r) / 256;
 			c_g = (c_g * l_g) / 256;
 			c_b = (c_b * l_b) / 256;
 		}
-		buffer->writePixel(buf + _a, c_a, c_r, c_g, c_b);
-		if (depthWrite) {
+		if (k8888)
+			buffer->writePixel8888<P::alphaTestFunc, P::blendSrc, P::blendDst>(buf + _a, c_a, c_r, c_g, c_b);
+		else
+			buffer->writePixel<P::alphaTestFunc, P::blendSrc, P::blendDst>(buf + _a, c_a, c_r, c_g, c_b);
+		if (P::depthWrite) {
 			pz[_a] = z;
 		}
 	}
@@ -83,21 +196,533 @@ FORCEINLINE static void putPixelTextureMappingPerspective(FrameBuffer *buffer, i
 	t += dtdx;
 	if (smoothMode) {
 		a += dadx;
-		rgba = (rgba + drgbdx) & (~0x00200800);
+		color.step();
+	}
+}
+
+template <int kPipeline>
+static void drawSpanDepthOnly(FrameBuffer *buffer, const ZBufferSpan &span) {
+	unsigned int *pz = span.pz;
+	unsigned int z = span.z;
+	int n = span.n;
+	while (n >= 3) {
+		putPixelDepth<kPipeline>(buffer, pz, 0, z, span.dzdx);
+		putPixelDepth<kPipeline>(buffer, pz, 1, z, span.dzdx);
+		putPixelDepth<kPipeline>(buffer, pz, 2, z, span.dzdx);
+		putPixelDepth<kPipeline>(buffer, pz, 3, z, span.dzdx);
+		pz += 4;
+		n -= 4;
+	}
+	while (n >= 0) {
+		putPixelDepth<kPipeline>(buffer, pz, 0, z, span.dzdx);
+		pz += 1;
+		n -= 1;
+	}
+}
+
+template <int kPipeline, bool k8888>
+static void drawSpanFlat(FrameBuffer *buffer, const ZBufferSpan &span) {
+	unsigned int *pz = span.pz;
+	int buf = span.buf;
+	unsigned int z = span.z;
+	int n = span.n;
+	while (n >= 3) {
+		putPixelFlat<kPipeline, k8888>(buffer, buf, pz, 0, z, span.color, span.dzdx);
+		putPixelFlat<kPipeline, k8888>(buffer, buf, pz, 1, z, span.color, span.dzdx);
+		putPixelFlat<kPipeline, k8888>(buffer, buf, pz, 2, z, span.color, span.dzdx);
+		putPixelFlat<kPipeline, k8888>(buffer, buf, pz, 3, z, span.color, span.dzdx);
+		pz += 4;
+		buf += 4;
+		n -= 4;
+	}
+	while (n >= 0) {
+		putPixelFlat<kPipeline, k8888>(buffer, buf, pz, 0, z, span.color, span.dzdx);
+		pz += 1;
+		buf += 1;
+		n -= 1;
+	}
+}
+
+FORCEINLINE static bool isShadowMaskSet(const unsigned char *mask, int bit) {
+	return (mask[bit >> 3] >> (bit & 7)) & 1;
+}
+
+static void drawSpanShadowMask(FrameBuffer *buffer, const ZBufferSpan &span) {
+	unsigned char *mask = buffer->shadow_mask_buf;
+	int bit = span.pm;
+	int end = span.pm + span.n + 1;
+	while (bit < end && (bit & 7)) {
+		mask[bit >> 3] |= 1 << (bit & 7);
+		bit++;
+	}
+	int bytes = (end - bit) >> 3;
+	if (bytes > 0) {
+		memset(mask + (bit >> 3), 0xff, bytes);
+		bit += bytes << 3;
+	}
+	while (bit < end) {
+		mask[bit >> 3] |= 1 << (bit & 7);
+		bit++;
+	}
+}
+
+template <int kPipeline>
+static void drawSpanShadow(FrameBuffer *buffer, const ZBufferSpan &span) {
+	typedef FragmentPipeline<kPipeline> P;
+	const unsigned char *mask = buffer->shadow_mask_buf;
+	int pm = span.pm;
+	unsigned int *pz = span.pz;
+	int buf = span.buf;
+	unsigned int z = span.z;
+	int n = span.n;
+	while (n >= 3) {
+		for (int a = 0; a < 4; a++) {
+			if (buffer->compareDepth<P::depthFunc>(z, pz[a]) && isShadowMaskSet(mask, pm)) {
+				buffer->writePixel<P::alphaTestFunc, P::blendSrc, P::blendDst>(buf + a, span.color);
+				if (P::depthWrite) {
+					pz[a] = z;
+				}
+			}
+			z += span.dzdx;
+		}
+		pz += 4;
+		pm += 4;
+		buf += 4;
+		n -= 4;
+	}
+	while (n >= 0) {
+		if (buffer->compareDepth<P::depthFunc>(z, pz[0]) && isShadowMaskSet(mask, pm)) {
+			buffer->writePixel<P::alphaTestFunc, P::blendSrc, P::blendDst>(buf, span.color);
+			if (P::depthWrite) {
+				pz[0] = z;
+			}
+		}
+		pz += 1;
+		pm += 1;
+		buf += 1;
+		n -= 1;
+	}
+}
+
+template <int kPipeline, bool k8888>
+static void drawSpanSmooth(FrameBuffer *buffer, const ZBufferSpan &span) {
+	unsigned int *pz = span.pz;
+	int buf = span.buf;
+	unsigned int z = span.z;
+	int n = span.n;
+	SpanColor<k8888> color(span);
+	while (n >= 3) {
+		putPixelSmooth<kPipeline, k8888>(buffer, buf, pz, 0, z, color, span.dzdx);
+		putPixelSmooth<kPipeline, k8888>(buffer, buf, pz, 1, z, color, span.dzdx);
+		putPixelSmooth<kPipeline, k8888>(buffer, buf, pz, 2, z, color, span.dzdx);
+		putPixelSmooth<kPipeline, k8888>(buffer, buf, pz, 3, z, color, span.dzdx);
+		pz += 4;
+		buf += 4;
+		n -= 4;
+	}
+	while (n >= 0) {
+		putPixelSmooth<kPipeline, k8888>(buffer, buf, pz, 0, z, color, span.dzdx);
+		buf += 1;
+		pz += 1;
+		n -= 1;
+	}
+}
+
+template <int kPipeline, bool lightsMode, bool smoothMode, bool k8888>
+static void drawSpanTextureMappingPerspective(FrameBuffer *buffer, const ZBufferSpan &span) {
+	unsigned int *pz;
+	unsigned int s, t, z, a;
+	int n, dsdx, dtdx;
+	float sz, tz, fz, zinv;
+	n = span.n;
+	fz = (float)span.z;
+	zinv = (float)(1.0 / fz);
+
+	int buf = span.buf;
+
+	pz = span.pz;
+	z = span.z;
+	sz = span.sz;
+	tz = span.tz;
+	SpanColor<k8888> color(span);
+	a = span.a;
+	while (n >= (NB_INTERP - 1)) {
+		{
+			float ss, tt;
+			ss = sz * zinv;
+			tt = tz * zinv;
+			s = (int)ss;
+			t = (int)tt;
+			dsdx = (int)((span.dszdx - ss * span.fdzdx) * zinv);
+			dtdx = (int)((span.dtzdx - tt * span.fdzdx) * zinv);
+			fz += span.fndzdx;
+			zinv = (float)(1.0 / fz);
+		}
+		for (int _a = 0; _a < 8; _a++) {
+			putPixelTextureMappingPerspective<kPipeline, lightsMode, smoothMode, k8888>(buffer, buf, span,
+			                           pz, _a, z, t, s, color, a, span.dzdx, dsdx, dtdx, span.dadx);
+		}
+		pz += NB_INTERP;
+		buf += NB_INTERP;
+		n -= NB_INTERP;
+		sz += span.ndszdx;
+		tz += span.ndtzdx;
+	}
+
+	{
+		float ss, tt;
+		ss = sz * zinv;
+		tt = tz * zinv;
+		s = (int)ss;
+		t = (int)tt;
+		dsdx = (int)((span.dszdx - ss * span.fdzdx) * zinv);
+		dtdx = (int)((span.dtzdx - tt * span.fdzdx) * zinv);
+	}
+
+	while (n >= 0) {
+		putPixelTextureMappingPerspective<kPipeline, lightsMode, smoothMode, k8888>(buffer, buf, span,
+		                           pz, 0, z, t, s, color, a, span.dzdx, dsdx, dtdx, span.dadx);
+		pz += 1;
+		buf += 1;
+		n -= 1;
 	}
 }
 
-template <bool interpRGB, bool interpZ, bool interpST, bool interpSTZ, int drawLogic, bool depthWrite>
-void FrameBuffer::fillTriangle(ZBufferPoint *p0, ZBufferPoint *p1, ZBufferPoint *p2) {
-	Graphics::PixelBuffer texture;
-	Graphics::PixelFormat textureFormat;
-	float fdzdx = 0, fndzdx = 0, ndszdx = 0, ndtzdx = 0;
+template <int kPipeline>
+static void drawSpanTextureMappingPerspectiveSmooth(FrameBuffer *buffer, const ZBufferSpan &span) {
+	drawSpanTextureMappingPerspective<kPipeline, true, true, false>(buffer, span);
+}
+
+template <int kPipeline>
+static void drawSpanTextureMappingPerspectiveFlat(FrameBuffer *buffer, const ZBufferSpan &span) {
+	drawSpanTextureMappingPerspective<kPipeline, true, false, false>(buffer, span);
+}
+
+// The 8888 variants are for frame buffers where FrameBuffer::is8888() is true
+template <int kPipeline>
+static void drawSpanTextureMappingPerspectiveSmooth8888(FrameBuffer *buffer, const ZBufferSpan &span) {
+	drawSpanTextureMappingPerspective<kPipeline, true, true, true>(buffer, span);
+}
+
+template <int kPipeline>
+static void drawSpanTextureMappingPerspectiveFlat8888(FrameBuffer *buffer, const ZBufferSpan &span) {
+	drawSpanTextureMappingPerspective<kPipeline, true, false, true>(buffer, span);
+}
+
+template <int kPipeline>
+static void drawSpanFlatGeneric(FrameBuffer *buffer, const ZBufferSpan &span) {
+	drawSpanFlat<kPipeline, false>(buffer, span);
+}
+
+template <int kPipeline>
+static void drawSpanFlat8888(FrameBuffer *buffer, const ZBufferSpan &span) {
+	drawSpanFlat<kPipeline, true>(buffer, span);
+}
+
+template <int kPipeline>
+static void drawSpanSmoothGeneric(FrameBuffer *buffer, const ZBufferSpan &span) {
+	drawSpanSmooth<kPipeline, false>(buffer, span);
+}
+
+template <int kPipeline>
+static void drawSpanSmooth8888(FrameBuffer *buffer, const ZBufferSpan &span) {
+	drawSpanSmooth<kPipeline, true>(buffer, span);
+}
+
+// Tables of the span routines for every fragment pipeline
+#define PIPELINE_SPANS_4(span, base) span<base>, span<base + 1>, span<base + 2>, span<base + 3>
+#define PIPELINE_SPANS_16(span, base) \
+	PIPELINE_SPANS_4(span, base), PIPELINE_SPANS_4(span, base + 4), \
+	PIPELINE_SPANS_4(span, base + 8), PIPELINE_SPANS_4(span, base + 12)
+#define PIPELINE_SPANS(span) { PIPELINE_SPANS_16(span, 0), PIPELINE_SPANS_16(span, 16), PIPELINE_SPANS_16(span, 32) }
+
+static const DrawSpanProc flatSpans[PIPELINE_COUNT] = PIPELINE_SPANS(drawSpanFlatGeneric);
+static const DrawSpanProc smoothSpans[PIPELINE_COUNT] = PIPELINE_SPANS(drawSpanSmoothGeneric);
+static const DrawSpanProc textureSmoothSpans[PIPELINE_COUNT] = PIPELINE_SPANS(drawSpanTextureMappingPerspectiveSmooth);
+static const DrawSpanProc textureFlatSpans[PIPELINE_COUNT] = PIPELINE_SPANS(drawSpanTextureMappingPerspectiveFlat);
+
+// The same spans for 32 bit frame buffers with 8 bits per channel, see FrameBuffer::is8888()
+static const DrawSpanProc flatSpans8888[PIPELINE_COUNT] = PIPELINE_SPANS(drawSpanFlat8888);
+static const DrawSpanProc smoothSpans8888[PIPELINE_COUNT] = PIPELINE_SPANS(drawSpanSmooth8888);
+static const DrawSpanProc textureSmoothSpans8888[PIPELINE_COUNT] = PIPELINE_SPANS(drawSpanTextureMappingPerspectiveSmooth8888);
+static const DrawSpanProc textureFlatSpans8888[PIPELINE_COUNT] = PIPELINE_SPANS(drawSpanTextureMappingPerspectiveFlat8888);
+
+// The depth only spans only depend on the depth function and write mask,
+// which are the bits above the third one in the pipeline index
+static const DrawSpanProc depthOnlySpans[PIPELINE_COUNT >> 3] = {
+	drawSpanDepthOnly<0>, drawSpanDepthOnly<8>, drawSpanDepthOnly<16>,
+	drawSpanDepthOnly<24>, drawSpanDepthOnly<32>, drawSpanDepthOnly<40>
+};
+
+// Shadows are drawn rarely enough that only the depth write mask is specialized,
+// with the dynamic depth function, alpha test and blending
+static const DrawSpanProc shadowSpans[2] = {
+	drawSpanShadow<(2 << 4) | (0 << 3) | (1 << 2) | 3>,
+	drawSpanShadow<(2 << 4) | (1 << 3) | (1 << 2) | 3>
+};
+
+#ifdef TINYGL_SIMD
+
+// Vector versions of the smooth and textured spans, for opaque pixels in a 16 bit
+// frame buffer without alpha. They process NB_INTERP pixels at a time and give
+// the same results as the scalar spans, which still draw the last pixels of a span.
+
+// Value of rgb after count steps of (rgb + drgbdx) & ~0x00200800
+static inline unsigned int stepPackedRGB(unsigned int rgb, unsigned int drgbdx, int count) {
+	return (((rgb & 0x000007FF) + (drgbdx & 0x000007FF) * count) & 0x000007FF) |
+	       (((rgb & 0x001FF000) + (drgbdx & 0x001FF000) * count) & 0x001FF000) |
+	       (((rgb & 0xFFC00000) + (drgbdx & 0xFFC00000) * count) & 0xFFC00000);
+}
+
+template <int kDepthFunc>
+FORCEINLINE static SIMD::Vec compareDepthSIMD(SIMD::Vec z, SIMD::Vec zbuf) {
+	if (kDepthFunc == TGL_LESS)
+		return SIMD::lessThan(zbuf, z);
+	else
+		return SIMD::lessEqual(zbuf, z);
+}
+
+FORCEINLINE static SIMD::Vec shadeTexelsSIMD(SIMD::Vec col, SIMD::Vec rgb,
+                        const Graphics::PixelFormat &textureFormat, const Graphics::PixelFormat &format) {
+	const SIMD::Vec byteMask = SIMD::set1(0xFF);
+	SIMD::Vec tmp = SIMD::bitAnd(rgb, SIMD::set1(0xF81F07E0));
+	SIMD::Vec light = SIMD::bitOr(tmp, SIMD::shiftRight(tmp, 16));
+	SIMD::Vec l_r = SIMD::shiftRight(SIMD::bitAnd(light, SIMD::set1(0xF800)), 8);
+	SIMD::Vec l_g = SIMD::shiftRight(SIMD::bitAnd(light, SIMD::set1(0x07E0)), 3);
+	SIMD::Vec l_b = SIMD::shiftLeft(SIMD::bitAnd(light, SIMD::set1(0x001F)), 3);
+	SIMD::Vec c_r = SIMD::bitAnd(SIMD::shiftRight(col, textureFormat.rShift), byteMask);
+	SIMD::Vec c_g = SIMD::bitAnd(SIMD::shiftRight(col, textureFormat.gShift), byteMask);
+	SIMD::Vec c_b = SIMD::bitAnd(SIMD::shiftRight(col, textureFormat.bShift), byteMask);
+	c_r = SIMD::shiftRight(SIMD::mul16(c_r, l_r), 8);
+	c_g = SIMD::shiftRight(SIMD::mul16(c_g, l_g), 8);
+	c_b = SIMD::shiftRight(SIMD::mul16(c_b, l_b), 8);
+	return SIMD::bitOr(SIMD::shiftLeft(SIMD::shiftRight(c_r, format.rLoss), format.rShift),
+	       SIMD::bitOr(SIMD::shiftLeft(SIMD::shiftRight(c_g, format.gLoss), format.gShift),
+	                   SIMD::shiftLeft(SIMD::shiftRight(c_b, format.bLoss), format.bShift)));
+}
+
+template <int kTexelBytes>
+FORCEINLINE static void fetchTexelsSIMD(FrameBuffer *buffer, const ZBufferSpan &span, uint32 *col,
+                                        unsigned int s, unsigned int t, int dsdx, int dtdx) {
+	for (int _a = 0; _a < NB_INTERP; _a++) {
+		col[_a] = fetchTexel<kTexelBytes>(span, buffer->getTexelIndex(s, t));
+		s += dsdx;
+		t += dtdx;
+	}
+}
+
+template <int kPipeline>
+static void drawSpanSmoothSIMD(FrameBuffer *buffer, const ZBufferSpan &span) {
+	typedef FragmentPipeline<kPipeline> P;
+	uint16 *pp = (uint16 *)buffer->getRawPixelBuffer() + span.buf;
+	unsigned int *pz = span.pz;
+	int buf = span.buf;
+	unsigned int z = span.z;
+	unsigned int rgb;
+	int n = span.n;
+	rgb = (span.r << 16) & 0xFFC00000;
+	rgb |= (span.g >> 5) & 0x000007FF;
+	rgb |= (span.b << 5) & 0x001FF000;
+
+	const SIMD::Vec zStep = SIMD::set(0, span.dzdx, 2 * span.dzdx, 3 * span.dzdx);
+	const SIMD::Vec zStep4 = SIMD::set1(4 * span.dzdx);
+	const SIMD::Vec rgbStep = SIMD::set(0, stepPackedRGB(0, span.drgbdx, 1),
+	                                    stepPackedRGB(0, span.drgbdx, 2), stepPackedRGB(0, span.drgbdx, 3));
+	const SIMD::Vec rgbStep4 = SIMD::set1(stepPackedRGB(0, span.drgbdx, 4));
+	const SIMD::Vec rgbMask = SIMD::set1(~0x00200800);
+	const SIMD::Vec colorMask = SIMD::set1(0xF81F07E0);
+	while (n >= NB_INTERP - 1) {
+		SIMD::Vec z0 = SIMD::add(SIMD::set1(z), zStep);
+		SIMD::Vec z1 = SIMD::add(z0, zStep4);
+		SIMD::Vec zbuf0 = SIMD::load(pz);
+		SIMD::Vec zbuf1 = SIMD::load(pz + 4);
+		SIMD::Vec mask0 = compareDepthSIMD<P::depthFunc>(z0, zbuf0);
+		SIMD::Vec mask1 = compareDepthSIMD<P::depthFunc>(z1, zbuf1);
+		if (SIMD::any(SIMD::bitOr(mask0, mask1))) {
+			SIMD::Vec rgb0 = SIMD::bitAnd(SIMD::add(SIMD::set1(rgb), rgbStep), rgbMask);
+			SIMD::Vec rgb1 = SIMD::bitAnd(SIMD::add(rgb0, rgbStep4), rgbMask);
+			SIMD::Vec tmp0 = SIMD::bitAnd(rgb0, colorMask);
+			SIMD::Vec tmp1 = SIMD::bitAnd(rgb1, colorMask);
+			SIMD::storeMasked16(pp, SIMD::bitOr(tmp0, SIMD::shiftRight(tmp0, 16)),
+			                    SIMD::bitOr(tmp1, SIMD::shiftRight(tmp1, 16)), mask0, mask1);
+			if (P::depthWrite) {
+				SIMD::store(pz, SIMD::select(mask0, z0, zbuf0));
+				SIMD::store(pz + 4, SIMD::select(mask1, z1, zbuf1));
+			}
+		}
+		z += NB_INTERP * span.dzdx;
+		rgb = stepPackedRGB(rgb, span.drgbdx, NB_INTERP);
+		pz += NB_INTERP;
+		pp += NB_INTERP;
+		buf += NB_INTERP;
+		n -= NB_INTERP;
+	}
+	SpanColor<false> color(span);
+	color.rgb = rgb;
+	while (n >= 0) {
+		putPixelSmooth<kPipeline, false>(buffer, buf, pz, 0, z, color, span.dzdx);
+		buf += 1;
+		pz += 1;
+		n -= 1;
+	}
+}
+
+template <int kPipeline, bool smoothMode>
+static void drawSpanTextureMappingPerspectiveSIMD(FrameBuffer *buffer, const ZBufferSpan &span) {
+	typedef FragmentPipeline<kPipeline> P;
+	const Graphics::PixelFormat &textureFormat = span.textureFormat;
+	const Graphics::PixelFormat &format = buffer->cmode;
+	uint16 *pp = (uint16 *)buffer->getRawPixelBuffer() + span.buf;
+	unsigned int *pz;
+	unsigned int s, t, z, rgb, a;
+	int n, dsdx, dtdx;
+	float sz, tz, fz, zinv;
+	n = span.n;
+	fz = (float)span.z;
+	zinv = (float)(1.0 / fz);
+
+	int buf = span.buf;
+
+	pz = span.pz;
+	z = span.z;
+	sz = span.sz;
+	tz = span.tz;
+	rgb = (span.r << 16) & 0xFFC00000;
+	rgb |= (span.g >> 5) & 0x000007FF;
+	rgb |= (span.b << 5) & 0x001FF000;
+	a = span.a;
+
+	const SIMD::Vec zStep = SIMD::set(0, span.dzdx, 2 * span.dzdx, 3 * span.dzdx);
+	const SIMD::Vec zStep4 = SIMD::set1(4 * span.dzdx);
+	const SIMD::Vec rgbStep = SIMD::set(0, stepPackedRGB(0, span.drgbdx, 1),
+	                                    stepPackedRGB(0, span.drgbdx, 2), stepPackedRGB(0, span.drgbdx, 3));
+	const SIMD::Vec rgbStep4 = SIMD::set1(stepPackedRGB(0, span.drgbdx, 4));
+	const SIMD::Vec rgbMask = SIMD::set1(~0x00200800);
+	while (n >= (NB_INTERP - 1)) {
+		{
+			float ss, tt;
+			ss = sz * zinv;
+			tt = tz * zinv;
+			s = (int)ss;
+			t = (int)tt;
+			dsdx = (int)((span.dszdx - ss * span.fdzdx) * zinv);
+			dtdx = (int)((span.dtzdx - tt * span.fdzdx) * zinv);
+			fz += span.fndzdx;
+			zinv = (float)(1.0 / fz);
+		}
+		SIMD::Vec z0 = SIMD::add(SIMD::set1(z), zStep);
+		SIMD::Vec z1 = SIMD::add(z0, zStep4);
+		SIMD::Vec zbuf0 = SIMD::load(pz);
+		SIMD::Vec zbuf1 = SIMD::load(pz + 4);
+		SIMD::Vec mask0 = compareDepthSIMD<P::depthFunc>(z0, zbuf0);
+		SIMD::Vec mask1 = compareDepthSIMD<P::depthFunc>(z1, zbuf1);
+		if (SIMD::any(SIMD::bitOr(mask0, mask1))) {
+			// Texels are fetched for the whole block, masked out ones are simply not written
+			uint32 col[NB_INTERP];
+			switch (span.texelBytes) {
+			case 1:
+				fetchTexelsSIMD<1>(buffer, span, col, s, t, dsdx, dtdx);
+				break;
+			case 2:
+				fetchTexelsSIMD<2>(buffer, span, col, s, t, dsdx, dtdx);
+				break;
+			default:
+				fetchTexelsSIMD<4>(buffer, span, col, s, t, dsdx, dtdx);
+				break;
+			}
+			SIMD::Vec rgb0, rgb1;
+			if (smoothMode) {
+				rgb0 = SIMD::bitAnd(SIMD::add(SIMD::set1(rgb), rgbStep), rgbMask);
+				rgb1 = SIMD::bitAnd(SIMD::add(rgb0, rgbStep4), rgbMask);
+			} else {
+				rgb0 = rgb1 = SIMD::set1(rgb);
+			}
+			SIMD::storeMasked16(pp, shadeTexelsSIMD(SIMD::load(col), rgb0, textureFormat, format),
+			                    shadeTexelsSIMD(SIMD::load(col + 4), rgb1, textureFormat, format), mask0, mask1);
+			if (P::depthWrite) {
+				SIMD::store(pz, SIMD::select(mask0, z0, zbuf0));
+				SIMD::store(pz + 4, SIMD::select(mask1, z1, zbuf1));
+			}
+		}
+		z += NB_INTERP * span.dzdx;
+		if (smoothMode) {
+			a += NB_INTERP * span.dadx;
+			rgb = stepPackedRGB(rgb, span.drgbdx, NB_INTERP);
+		}
+		pz += NB_INTERP;
+		pp += NB_INTERP;
+		buf += NB_INTERP;
+		n -= NB_INTERP;
+		sz += span.ndszdx;
+		tz += span.ndtzdx;
+	}
+
+	{
+		float ss, tt;
+		ss = sz * zinv;
+		tt = tz * zinv;
+		s = (int)ss;
+		t = (int)tt;
+		dsdx = (int)((span.dszdx - ss * span.fdzdx) * zinv);
+		dtdx = (int)((span.dtzdx - tt * span.fdzdx) * zinv);
+	}
+
+	SpanColor<false> color(span);
+	color.rgb = rgb;
+	while (n >= 0) {
+		putPixelTextureMappingPerspective<kPipeline, true, smoothMode, false>(buffer, buf, span,
+		                           pz, 0, z, t, s, color, a, span.dzdx, dsdx, dtdx, span.dadx);
+		pz += 1;
+		buf += 1;
+		n -= 1;
+	}
+}
+
+// Only the opaque pipelines with the LESS and LEQUAL depth functions have vector
+// spans, indexed by the depth function and write mask bits of the pipeline
+static const DrawSpanProc smoothSpansSIMD[4] = {
+	drawSpanSmoothSIMD<0>, drawSpanSmoothSIMD<8>, drawSpanSmoothSIMD<16>, drawSpanSmoothSIMD<24>
+};
+static const DrawSpanProc textureSmoothSpansSIMD[4] = {
+	drawSpanTextureMappingPerspectiveSIMD<0, true>, drawSpanTextureMappingPerspectiveSIMD<8, true>,
+	drawSpanTextureMappingPerspectiveSIMD<16, true>, drawSpanTextureMappingPerspectiveSIMD<24, true>
+};
+static const DrawSpanProc textureFlatSpansSIMD[4] = {
+	drawSpanTextureMappingPerspectiveSIMD<0, false>, drawSpanTextureMappingPerspectiveSIMD<8, false>,
+	drawSpanTextureMappingPerspectiveSIMD<16, false>, drawSpanTextureMappingPerspectiveSIMD<24, false>
+};
+
+#else
+
+static const DrawSpanProc *const smoothSpansSIMD = NULL;
+static const DrawSpanProc *const textureSmoothSpansSIMD = NULL;
+static const DrawSpanProc *const textureFlatSpansSIMD = NULL;
+
+#endif // TINYGL_SIMD
+
+// Pick the vector span for the pipeline when there is one and the frame buffer
+// format allows it, the scalar one for the frame buffer format otherwise
+static DrawSpanProc selectSpan(const FrameBuffer *buffer, int pipeline, const DrawSpanProc *spans,
+                               const DrawSpanProc *spans8888, const DrawSpanProc *simdSpans) {
+	const Graphics::PixelFormat &format = buffer->cmode;
+#ifdef TINYGL_SIMD
+	if (simdSpans && format.bytesPerPixel == 2 && format.aLoss == 8 && (pipeline & 7) == 0 && pipeline < 32)
+		return simdSpans[pipeline >> 3];
+#endif
+	if (buffer->is8888())
+		return spans8888[pipeline];
+	return spans[pipeline];
+}
+
+template <bool interpRGB, bool interpZ, bool interpST, bool interpSTZ, int drawLogic>
+void FrameBuffer::fillTriangle(ZBufferPoint *p0, ZBufferPoint *p1, ZBufferPoint *p2, DrawSpanProc drawSpan) {
+	ZBufferSpan span;
 	int _drgbdx = 0;
 
 	ZBufferPoint *tp, *pr1 = 0, *pr2 = 0, *l1 = 0, *l2 = 0;
 	float fdx1, fdx2, fdy1, fdy2, fz0, d1, d2;
 	unsigned int *pz1 = NULL;
-	unsigned char *pm1 = NULL;
+	int pm1 = 0;
 	int part, update_left, update_right;
 	int color = 0;
 
@@ -138,6 +763,15 @@ void FrameBuffer::fillTriangle(ZBufferPoint *p0, ZBufferPoint *p1, ZBufferPoint
 		p2 = tp;
 	}
 
+	// the tiled rasterizer only draws the lines between _clipYMin and _clipYMax
+	if (p2->y < _clipYMin || p0->y >= _clipYMax)
+		return;
+
+	// the shadow mask is drawn regardless of the depth buffer
+	const bool depthCulling = drawLogic != DRAW_SHADOW_MASK;
+	if (depthCulling && !_depthBlocksValid)
+		updateDepthBlocks();
+
 	// we compute dXdx and dXdy for all interpolated values
 
 	fdx1 = (float)(p1->x - p0->x);
@@ -227,10 +861,10 @@ void FrameBuffer::fillTriangle(ZBufferPoint *p0, ZBufferPoint *p1, ZBufferPoint
 
 	switch (drawLogic) {
 	case DRAW_SHADOW_MASK:
-		pm1 = shadow_mask_buf + p0->y * xsize;
+		pm1 = p0->y * getShadowMaskPitch() * 8;
 		break;
 	case DRAW_SHADOW:
-		pm1 = shadow_mask_buf + p0->y * xsize;
+		pm1 = p0->y * getShadowMaskPitch() * 8;
 		color = RGB_TO_PIXEL(shadow_color_r, shadow_color_g, shadow_color_b);
 		break;
 	case DRAW_DEPTH_ONLY:
@@ -248,18 +882,40 @@ void FrameBuffer::fillTriangle(ZBufferPoint *p0, ZBufferPoint *p1, ZBufferPoint
 	}
 
 	if ((interpST || interpSTZ) && (drawLogic == DRAW_FLAT || drawLogic == DRAW_SMOOTH)) {
-		texture = current_texture;
-		textureFormat = texture.getFormat();
-		assert(textureFormat.bytesPerPixel == 4);
-		fdzdx = (float)dzdx;
-		fndzdx = NB_INTERP * fdzdx;
-		ndszdx = NB_INTERP * dszdx;
-		ndtzdx = NB_INTERP * dtzdx;
+		span.texels = current_texture.getRawBuffer();
+		span.texelBytes = current_texture.getFormat().bytesPerPixel;
+		if (span.texelBytes == 1) {
+			assert(current_texture_palette);
+			span.texturePalette = (const uint32 *)current_texture_palette.getRawBuffer();
+			span.textureFormat = current_texture_palette.getFormat();
+		} else if (span.texelBytes == 2) {
+			// fetchTexel() expands RGB565 to this layout
+			span.textureFormat = Graphics::PixelFormat(4, 8, 8, 8, 8, 16, 8, 0, 24);
+		} else {
+			assert(span.texelBytes == 4);
+			span.textureFormat = current_texture.getFormat();
+		}
+		span.fdzdx = (float)dzdx;
+		span.fndzdx = NB_INTERP * span.fdzdx;
+		span.dszdx = dszdx;
+		span.dtzdx = dtzdx;
+		span.ndszdx = NB_INTERP * dszdx;
+		span.ndtzdx = NB_INTERP * dtzdx;
 		_drgbdx = ((drdx / (1 << 6)) << 22) & 0xFFC00000;
 		_drgbdx |= (dgdx / (1 << 5)) & 0x000007FF;
 		_drgbdx |= ((dbdx / (1 << 7)) << 12) & 0x001FF000;
 	}
 
+	span.color = color;
+	span.dzdx = dzdx;
+	span.dadx = dadx;
+	span.drgbdx = _drgbdx;
+	span.drdx = drdx;
+	span.dgdx = dgdx;
+	span.dbdx = dbdx;
+
+	int y = p0->y;
+
 	for (part = 0; part < 2; part++) {
 		if (part == 0) {
 			if (fz0 > 0) {
@@ -369,196 +1025,47 @@ void FrameBuffer::fillTriangle(ZBufferPoint *p0, ZBufferPoint *p1, ZBufferPoint
 		// we draw all the scan line of the part
 		while (nb_lines > 0) {
 			nb_lines--;
-			{
-				if (drawLogic == DRAW_DEPTH_ONLY ||
-						(drawLogic == DRAW_FLAT && !(interpST || interpSTZ))) {
-					int pp;
-					int n;
-					unsigned int *pz;
-					unsigned int z;
-					n = (x2 >> 16) - x1;
-					pp = pp1 + x1;
-					if (interpZ) {
-						pz = pz1 + x1;
-						z = z1;
-					}
-					while (n >= 3) {
-						if (drawLogic == DRAW_DEPTH_ONLY) {
-							putPixelDepth<depthWrite>(this, pz, 0, z, dzdx);
-							putPixelDepth<depthWrite>(this, pz, 1, z, dzdx);
-							putPixelDepth<depthWrite>(this, pz, 2, z, dzdx);
-							putPixelDepth<depthWrite>(this, pz, 3, z, dzdx);
-						}
-						if (drawLogic == DRAW_FLAT) {
-							putPixelFlat<depthWrite>(this, pp, pz, 0, z, color, dzdx);
-							putPixelFlat<depthWrite>(this, pp, pz, 1, z, color, dzdx);
-							putPixelFlat<depthWrite>(this, pp, pz, 2, z, color, dzdx);
-							putPixelFlat<depthWrite>(this, pp, pz, 3, z, color, dzdx);
-						}
-						if (interpZ) {
-							pz += 4;
-						}
-						pp += 4;
-						n -= 4;
-					}
-					while (n >= 0) {
-						if (drawLogic == DRAW_DEPTH_ONLY) {
-							putPixelDepth<depthWrite>(this, pz, 0, z, dzdx);
-						}
-						if (drawLogic == DRAW_FLAT) {
-							putPixelFlat<depthWrite>(this, pp, pz, 0, z, color, dzdx);
-						}
-						if (interpZ) {
-							pz += 1;
-						}
-						pp += 1;
-						n -= 1;
-					}
-				} else if (drawLogic == DRAW_SHADOW_MASK) {
-					unsigned char *pm;
-					int n;
-
-					n = (x2 >> 16) - x1;
-					pm = pm1 + x1;
-					while (n >= 3) {
-						for (int a = 0; a <= 3; a++) {
-							pm[a] = 0xff;
-						}
-						pm += 4;
-						n -= 4;
-					}
-					while (n >= 0) {
-						pm[0] = 0xff;
-						pm += 1;
-						n -= 1;
-					}
-				} else if (drawLogic == DRAW_SHADOW) {
-					unsigned char *pm;
-					int n;
-					unsigned int *pz;
-					unsigned int z;
-
-					n = (x2 >> 16) - x1;
-
-					int buf = pp1 + x1;
-
-					pm = pm1 + x1;
-					pz = pz1 + x1;
-					z = z1;
-					while (n >= 3) {
-						for (int a = 0; a < 4; a++) {
-							if (compareDepth(z, pz[a]) && pm[0]) {
-								writePixel(buf + a, color);
-								if (depthWrite) {
-									pz[a] = z;
-								}
-							}
-							z += dzdx;
-						}
-						pz += 4;
-						pm += 4;
-						buf += 4;
-						n -= 4;
-					}
-					while (n >= 0) {
-						if (compareDepth(z, pz[0]) && pm[0]) {
-							writePixel(buf, color);
-							if (depthWrite) {
-								pz[0] = z;
-							}
-						}
-						pz += 1;
-						pm += 1;
-						buf += 1;
-						n -= 1;
-					}
-				} else if (drawLogic == DRAW_SMOOTH && !(interpST || interpSTZ)) {
-					unsigned int *pz;
-					int buf = pp1 + x1;
-					unsigned int z, rgb, drgbdx;
-					int n;
-					n = (x2 >> 16) - x1;
-					pz = pz1 + x1;
-					z = z1;
-					rgb = (r1 << 16) & 0xFFC00000;
-					rgb |= (g1 >> 5) & 0x000007FF;
-					rgb |= (b1 << 5) & 0x001FF000;
-					drgbdx = _drgbdx;
-					while (n >= 3) {
-						putPixelSmooth<depthWrite>(this, buf, pz, 0, z, tmp, rgb, dzdx, drgbdx);
-						putPixelSmooth<depthWrite>(this, buf, pz, 1, z, tmp, rgb, dzdx, drgbdx);
-						putPixelSmooth<depthWrite>(this, buf, pz, 2, z, tmp, rgb, dzdx, drgbdx);
-						putPixelSmooth<depthWrite>(this, buf, pz, 3, z, tmp, rgb, dzdx, drgbdx);
-						pz += 4;
-						buf += 4;
-						n -= 4;
-					}
-					while (n >= 0) {
-						putPixelSmooth<depthWrite>(this, buf, pz, 0, z, tmp, rgb, dzdx, drgbdx);
-						buf += 1;
-						pz += 1;
-						n -= 1;
-					}
-				} else if (interpST || interpSTZ) {
-					unsigned int *pz;
-					unsigned int s, t, z, rgb, a, drgbdx;
-					int n;
-					float sz, tz, fz, zinv;
-					n = (x2 >> 16) - x1;
-					fz = (float)z1;
-					zinv = (float)(1.0 / fz);
-
-					int buf = pp1 + x1;
-
-					pz = pz1 + x1;
-					z = z1;
-					sz = sz1;
-					tz = tz1;
-					rgb = (r1 << 16) & 0xFFC00000;
-					rgb |= (g1 >> 5) & 0x000007FF;
-					rgb |= (b1 << 5) & 0x001FF000;
-					a = a1;
-					drgbdx = _drgbdx;
-					while (n >= (NB_INTERP - 1)) {
-						{
-							float ss, tt;
-							ss = sz * zinv;
-							tt = tz * zinv;
-							s = (int)ss;
-							t = (int)tt;
-							dsdx = (int)((dszdx - ss * fdzdx) * zinv);
-							dtdx = (int)((dtzdx - tt * fdzdx) * zinv);
-							fz += fndzdx;
-							zinv = (float)(1.0 / fz);
-						}
-						for (int _a = 0; _a < 8; _a++) {
-							putPixelTextureMappingPerspective<depthWrite, interpRGB, drawLogic == DRAW_SMOOTH>(this, buf, textureFormat, texture,
-							                           pz, _a, z, t, s, tmp, rgb, a, dzdx, dsdx, dtdx, drgbdx, dadx);
+			if (y >= _clipYMax)
+				return;
+			if (y >= _clipYMin) {
+				span.n = (x2 >> 16) - x1;
+				span.buf = pp1 + x1;
+				span.pz = pz1 + x1;
+				if (drawLogic == DRAW_SHADOW || drawLogic == DRAW_SHADOW_MASK)
+					span.pm = pm1 + x1;
+				span.z = z1;
+				if (interpRGB) {
+					span.r = r1;
+					span.g = g1;
+					span.b = b1;
+					span.a = a1;
+				}
+				if (interpSTZ) {
+					span.sz = sz1;
+					span.tz = tz1;
+				}
+				if (depthCulling && span.n >= 0) {
+					// The depths of the span are z1 + i * dzdx, wrapping around
+					// like the unsigned depths of the span routines do
+					int64 zStart = z1;
+					int64 zEnd = z1 + (int64)dzdx * span.n;
+					int64 zMin = MIN(zStart, zEnd);
+					int64 zMax = MAX(zStart, zEnd);
+					bool inRange = zMin >= 0 && zMax <= 0xFFFFFFFFLL;
+					if (inRange && isSpanHidden(y, x1, x1 + span.n, (unsigned int)zMin, (unsigned int)zMax)) {
+						_culledSpans++;
+						_culledPixels += span.n + 1;
+					} else {
+						drawSpan(this, span);
+						if (_depthWrite) {
+							if (inRange)
+								updateDepthBlocks(y, x1, x1 + span.n, (unsigned int)zMin, (unsigned int)zMax);
+							else
+								updateDepthBlocks(y, x1, x1 + span.n, 0, 0xFFFFFFFF);
 						}
-						pz += NB_INTERP;
-						buf += NB_INTERP;
-						n -= NB_INTERP;
-						sz += ndszdx;
-						tz += ndtzdx;
-					}
-
-					{
-						float ss, tt;
-						ss = sz * zinv;
-						tt = tz * zinv;
-						s = (int)ss;
-						t = (int)tt;
-						dsdx = (int)((dszdx - ss * fdzdx) * zinv);
-						dtdx = (int)((dtzdx - tt * fdzdx) * zinv);
-					}
-
-					while (n >= 0) {
-						putPixelTextureMappingPerspective<depthWrite, interpRGB, drawLogic == DRAW_SMOOTH>(this, buf, textureFormat, texture,
-						                           pz, 0, z, t, s, tmp, rgb, a, dzdx, dsdx, dtdx, drgbdx, dadx);
-						pz += 1;
-						buf += 1;
-						n -= 1;
 					}
+				} else {
+					drawSpan(this, span);
 				}
 			}
 
@@ -616,87 +1123,111 @@ void FrameBuffer::fillTriangle(ZBufferPoint *p0, ZBufferPoint *p1, ZBufferPoint
 			pz1 += xsize;
 
 			if (drawLogic == DRAW_SHADOW || drawLogic == DRAW_SHADOW_MASK)
-				pm1 = pm1 + xsize;
+				pm1 += getShadowMaskPitch() * 8;
+			y++;
 		}
 	}
 }
 
 void FrameBuffer::fillTriangleDepthOnly(ZBufferPoint *p0, ZBufferPoint *p1, ZBufferPoint *p2) {
+	if (_tiles) {
+		queueTriangle(&FrameBuffer::fillTriangleDepthOnly, p0, p1, p2);
+		return;
+	}
+
 	const bool interpZ = true;
 	const bool interpRGB = false;
 	const bool interpST = false;
 	const bool interpSTZ = false;
-	if (_depthWrite)
-		fillTriangle<interpRGB, interpZ, interpST, interpSTZ, DRAW_DEPTH_ONLY, true>(p0, p1, p2);
-	else 
-		fillTriangle<interpRGB, interpZ, interpST, interpSTZ, DRAW_DEPTH_ONLY, false>(p0, p1, p2);
+	fillTriangle<interpRGB, interpZ, interpST, interpSTZ, DRAW_DEPTH_ONLY>(p0, p1, p2, depthOnlySpans[_fragmentPipeline >> 3]);
 }
 
 void FrameBuffer::fillTriangleFlat(ZBufferPoint *p0, ZBufferPoint *p1, ZBufferPoint *p2) {
+	markDirty(p0, p1, p2);
+	if (_tiles) {
+		queueTriangle(&FrameBuffer::fillTriangleFlat, p0, p1, p2);
+		return;
+	}
+
 	const bool interpZ = true;
 	const bool interpRGB = false;
 	const bool interpST = false;
 	const bool interpSTZ = false;
-	if (_depthWrite)
-		fillTriangle<interpRGB, interpZ, interpST, interpSTZ, DRAW_FLAT, true>(p0, p1, p2);
-	else
-		fillTriangle<interpRGB, interpZ, interpST, interpSTZ, DRAW_FLAT, false>(p0, p1, p2);
+	fillTriangle<interpRGB, interpZ, interpST, interpSTZ, DRAW_FLAT>(p0, p1, p2,
+	             selectSpan(this, _fragmentPipeline, flatSpans, flatSpans8888, NULL));
 }
 
 // Smooth filled triangle.
 void FrameBuffer::fillTriangleSmooth(ZBufferPoint *p0, ZBufferPoint *p1, ZBufferPoint *p2) {
+	markDirty(p0, p1, p2);
+	if (_tiles) {
+		queueTriangle(&FrameBuffer::fillTriangleSmooth, p0, p1, p2);
+		return;
+	}
+
 	const bool interpZ = true;
 	const bool interpRGB = true;
 	const bool interpST = false;
 	const bool interpSTZ = false;
-	if (_depthWrite)
-		fillTriangle<interpRGB, interpZ, interpST, interpSTZ, DRAW_SMOOTH, true>(p0, p1, p2);
-	else
-		fillTriangle<interpRGB, interpZ, interpST, interpSTZ, DRAW_SMOOTH, false>(p0, p1, p2);
+	fillTriangle<interpRGB, interpZ, interpST, interpSTZ, DRAW_SMOOTH>(p0, p1, p2,
+	             selectSpan(this, _fragmentPipeline, smoothSpans, smoothSpans8888, smoothSpansSIMD));
 }
 
 void FrameBuffer::fillTriangleTextureMappingPerspectiveSmooth(ZBufferPoint *p0, ZBufferPoint *p1, ZBufferPoint *p2) {
+	markDirty(p0, p1, p2);
+	if (_tiles) {
+		queueTriangle(&FrameBuffer::fillTriangleTextureMappingPerspectiveSmooth, p0, p1, p2);
+		return;
+	}
+
 	const bool interpZ = true;
 	const bool interpRGB = true;
 	const bool interpST = false;
 	const bool interpSTZ = true;
-	if (_depthWrite)
-		fillTriangle<interpRGB, interpZ, interpST, interpSTZ, DRAW_SMOOTH, true>(p0, p1, p2);
-	else
-		fillTriangle<interpRGB, interpZ, interpST, interpSTZ, DRAW_SMOOTH, false>(p0, p1, p2);
+	fillTriangle<interpRGB, interpZ, interpST, interpSTZ, DRAW_SMOOTH>(p0, p1, p2,
+	             selectSpan(this, _fragmentPipeline, textureSmoothSpans, textureSmoothSpans8888, textureSmoothSpansSIMD));
 }
 
 void FrameBuffer::fillTriangleTextureMappingPerspectiveFlat(ZBufferPoint *p0, ZBufferPoint *p1, ZBufferPoint *p2) {
+	markDirty(p0, p1, p2);
+	if (_tiles) {
+		queueTriangle(&FrameBuffer::fillTriangleTextureMappingPerspectiveFlat, p0, p1, p2);
+		return;
+	}
+
 	const bool interpZ = true;
 	const bool interpRGB = true;
 	const bool interpST = false;
 	const bool interpSTZ = true;
-	if (_depthWrite)
-		fillTriangle<interpRGB, interpZ, interpST, interpSTZ, DRAW_FLAT, true>(p0, p1, p2);
-	else
-		fillTriangle<interpRGB, interpZ, interpST, interpSTZ, DRAW_FLAT, false>(p0, p1, p2);
+	fillTriangle<interpRGB, interpZ, interpST, interpSTZ, DRAW_FLAT>(p0, p1, p2,
+	             selectSpan(this, _fragmentPipeline, textureFlatSpans, textureFlatSpans8888, textureFlatSpansSIMD));
 }
 
 void FrameBuffer::fillTriangleFlatShadowMask(ZBufferPoint *p0, ZBufferPoint *p1, ZBufferPoint *p2) {
+	if (_tiles) {
+		queueTriangle(&FrameBuffer::fillTriangleFlatShadowMask, p0, p1, p2);
+		return;
+	}
+
 	const bool interpZ = true;
 	const bool interpRGB = false;
 	const bool interpST = false;
 	const bool interpSTZ = false;
-	if (_depthWrite)
-		fillTriangle<interpRGB, interpZ, interpST, interpSTZ, DRAW_SHADOW_MASK, true>(p0, p1, p2);
-	else
-		fillTriangle<interpRGB, interpZ, interpST, interpSTZ, DRAW_SHADOW_MASK, false>(p0, p1, p2);
+	fillTriangle<interpRGB, interpZ, interpST, interpSTZ, DRAW_SHADOW_MASK>(p0, p1, p2, drawSpanShadowMask);
 }
 
 void FrameBuffer::fillTriangleFlatShadow(ZBufferPoint *p0, ZBufferPoint *p1, ZBufferPoint *p2) {
+	markDirty(p0, p1, p2);
+	if (_tiles) {
+		queueTriangle(&FrameBuffer::fillTriangleFlatShadow, p0, p1, p2);
+		return;
+	}
+
 	const bool interpZ = true;
 	const bool interpRGB = false;
 	const bool interpST = false;
 	const bool interpSTZ = false;
-	if (_depthWrite)
-		fillTriangle<interpRGB, interpZ, interpST, interpSTZ, DRAW_SHADOW, true>(p0, p1, p2);
-	else
-		fillTriangle<interpRGB, interpZ, interpST, interpSTZ, DRAW_SHADOW, false>(p0, p1, p2);
+	fillTriangle<interpRGB, interpZ, interpST, interpSTZ, DRAW_SHADOW>(p0, p1, p2, shadowSpans[_depthWrite ? 1 : 0]);
 }
 
 } // end of namespace TinyGL
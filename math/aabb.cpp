@@ -57,25 +57,26 @@ void AABB::expand(const Math::Vector3d &v) {
 }
 
 void AABB::transform(const Math::Matrix4 &matrix) {
-	Math::Vector3d min = _min;
-	Math::Vector3d max = _max;
+	Math::Vector3d verts[8];
+	getCorners(verts);
 
 	reset();
 
-	Math::Vector3d verts[8];
-	verts[0].set(min.x(), min.y(), min.z());
-	verts[1].set(max.x(), min.y(), min.z());
-	verts[2].set(min.x(), max.y(), min.z());
-	verts[3].set(min.x(), min.y(), max.z());
-	verts[4].set(max.x(), max.y(), min.z());
-	verts[5].set(max.x(), min.y(), max.z());
-	verts[6].set(min.x(), max.y(), max.z());
-	verts[7].set(max.x(), max.y(), max.z());
-
 	for (int i = 0; i < 8; ++i) {
 		matrix.transform(&verts[i], true);
 		expand(verts[i]);
 	}
 }
 
+void AABB::getCorners(Math::Vector3d corners[8]) const {
+	corners[0].set(_min.x(), _min.y(), _min.z());
+	corners[1].set(_max.x(), _min.y(), _min.z());
+	corners[2].set(_min.x(), _max.y(), _min.z());
+	corners[3].set(_min.x(), _min.y(), _max.z());
+	corners[4].set(_max.x(), _max.y(), _min.z());
+	corners[5].set(_max.x(), _min.y(), _max.z());
+	corners[6].set(_min.x(), _max.y(), _max.z());
+	corners[7].set(_max.x(), _max.y(), _max.z());
+}
+
 }
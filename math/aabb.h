@@ -37,6 +37,7 @@ public:
 	void reset();
 	void expand(const Math::Vector3d &v);
 	void transform(const Math::Matrix4 &matrix);
+	void getCorners(Math::Vector3d corners[8]) const;
 	Math::Vector3d getMin() const { return _min; }
 	Math::Vector3d getMax() const { return _max; }
 	bool isValid() const { return _valid; }
@@ -0,0 +1,64 @@
+#include <cxxtest/TestSuite.h>
+
+#include "graphics/tinygl/zbuffer.h"
+
+class TinyGLDirtyRectsTestSuite : public CxxTest::TestSuite {
+	static const int kWidth = 640;
+	static const int kHeight = 480;
+
+	static int area(const Common::List<Common::Rect> &rects) {
+		int a = 0;
+		for (Common::List<Common::Rect>::const_iterator it = rects.begin(); it != rects.end(); ++it)
+			a += it->width() * it->height();
+		return a;
+	}
+
+	static void drawTriangle(TinyGL::FrameBuffer &fb, int x, int y) {
+		TinyGL::ZBufferPoint p[3];
+		memset(p, 0, sizeof(p));
+		p[0].x = x;      p[0].y = y;
+		p[1].x = x + 10; p[1].y = y + 3;
+		p[2].x = x + 4;  p[2].y = y + 12;
+		for (int i = 0; i < 3; i++) {
+			p[i].z = 0x7fff;
+			p[i].r = p[i].g = p[i].b = p[i].a = 0xffff;
+		}
+		fb.fillTriangleFlat(&p[0], &p[1], &p[2]);
+	}
+
+public:
+	void test_small_change_on_cleared_background() {
+		Graphics::PixelFormat format(2, 5, 6, 5, 0, 11, 5, 0, 0);
+		Graphics::PixelBuffer buf(format, kWidth * kHeight, DisposeAfterUse::YES);
+		TinyGL::FrameBuffer fb(kWidth, kHeight, buf);
+		fb.enableDirtyRects(true);
+
+		// The first frame has nothing to compare with
+		Common::List<Common::Rect> rects;
+		fb.clear(true, 0, true, 0, 0, 0);
+		fb.getDirtyRects(rects);
+		TS_ASSERT_EQUALS(area(rects), kWidth * kHeight);
+
+		// Clearing to the same color again changes nothing
+		rects.clear();
+		fb.clear(true, 0, true, 0, 0, 0);
+		fb.getDirtyRects(rects);
+		TS_ASSERT(rects.empty());
+
+		// Only the cells around a small triangle are presented
+		rects.clear();
+		fb.clear(true, 0, true, 0, 0, 0);
+		drawTriangle(fb, 100, 100);
+		fb.getDirtyRects(rects);
+		TS_ASSERT(!rects.empty());
+		TS_ASSERT_LESS_THAN(area(rects), kWidth * kHeight);
+		for (Common::List<Common::Rect>::const_iterator it = rects.begin(); it != rects.end(); ++it)
+			TS_ASSERT(it->intersects(Common::Rect(100, 100, 111, 113)));
+
+		// And removing it again presents the same cells
+		Common::List<Common::Rect> removed;
+		fb.clear(true, 0, true, 0, 0, 0);
+		fb.getDirtyRects(removed);
+		TS_ASSERT_EQUALS(area(removed), area(rects));
+	}
+};